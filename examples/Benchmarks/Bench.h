@@ -0,0 +1,80 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  Minimal benchmark harness. Each benchmark is timed in CPU cycles over a fixed number of iterations, after a short
+ *  warm up, and reported as one JSON object per line on Serial:
+ *
+ *    {"suite":"parse","bench":"lsc_search/st","iters":2000,"cycles":1234,"ns":15425,"bytes":143}
+ *
+ *  cycles and ns are per operation, with the cost of an empty benchmark subtracted. bytes is the size of the input
+ *  or output of one operation where that is meaningful, and 0 otherwise. Output from two runs can be compared with
+ *  extras/bench_compare.py.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <Arduino.h>
+
+#define BENCH_WARMUP  16
+
+class Bench {
+  public:
+
+/**
+ *  Values written to sink cannot be optimized away
+ */
+    static volatile uint32_t sink;
+
+    static void header(const char* board) {
+      Serial.printf("{\"run\":\"UPnPLib\",\"board\":\"%s\",\"cpu_mhz\":%u,\"sdk\":\"%s\"}\n",board,(unsigned)ESP.getCpuFreqMHz(),ESP.getSdkVersion());
+      _overhead = 0;
+      _overhead = measure(1000,[]{sink++;});
+    }
+
+    template<typename F>
+    static void run(const char* suite, const char* bench, uint32_t iters, F f, int bytes=0) {
+      uint32_t cycles = measure(iters,f);
+      cycles = ((cycles > _overhead)?(cycles - _overhead):(0));
+      uint32_t ns = (uint32_t)((uint64_t)cycles * 1000 / ESP.getCpuFreqMHz());
+      Serial.printf("{\"suite\":\"%s\",\"bench\":\"%s\",\"iters\":%u,\"cycles\":%u,\"ns\":%u,\"bytes\":%d}\n",suite,bench,iters,cycles,ns,bytes);
+      yield();
+    }
+
+  private:
+    static uint32_t _overhead;
+
+    template<typename F>
+    static uint32_t measure(uint32_t iters, F f) {
+      for( int i=0; i<BENCH_WARMUP; i++ ) {f();}
+      uint32_t start = ESP.getCycleCount();
+      for( uint32_t i=0; i<iters; i++ ) {f();}
+      uint32_t elapsed = ESP.getCycleCount() - start;
+      return elapsed/iters;
+    }
+};
+
+volatile uint32_t Bench::sink      = 0;
+uint32_t          Bench::_overhead = 0;
+
+#endif
@@ -0,0 +1,233 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include "Bench.h"
+#include "Packets.h"
+
+/**
+ *   Microbenchmarks for the per-packet hot paths of the library: parsing incoming packets, rendering responses,
+ *   device lookup by uuid and type, and path and location building. No network connection is needed. Results are
+ *   written to Serial as JSON lines (see Bench.h); capture the output of two builds and compare them with
+ *
+ *     python3 extras/bench_compare.py before.jsonl after.jsonl
+ */
+
+#ifdef ESP8266
+#define BOARD "ESP8266"
+#else
+#define BOARD "ESP32"
+#endif
+
+#define ITERS        2000
+#define PACKET_SIZE  1536
+#define NUM_SERVICES (MAX_DEVICES*MAX_SERVICES + MAX_SERVICES)
+
+/**
+ *   Three hierarchies: a RootDevice with a single service, a RootDevice with 4 embedded devices of 2 services each,
+ *   and a RootDevice with the maximum of 8 embedded devices of 8 services each plus 8 services of its own.
+ */
+RootDevice       small("small");
+RootDevice       medium("medium");
+RootDevice       large("large");
+UPnPDevice       devices[4 + MAX_DEVICES];
+UPnPService      services[1 + 8 + NUM_SERVICES];
+
+const IPAddress  IFC(192,168,1,17);
+const char       ROOT_ST[] = "upnp:rootdevice";
+const char       MISS_ST[] = "urn:LeelanauSoftware-com:device:Thermometer:1";
+const char       MISS_UUID[] = "00000000-0000-4000-8000-000000000000";
+
+char             packet[PACKET_SIZE];
+char             output[PACKET_SIZE];
+char             scratch[256];
+
+void buildHierarchies() {
+  int d = 0;
+  int s = 0;
+  char target[16];
+
+  services[s].setTarget("service0");
+  small.addService(&services[s++]);
+
+  for( int i=0; i<4; i++ ) {
+    snprintf(target,16,"device%d",i);
+    devices[d].setTarget(target);
+    for( int j=0; j<2; j++ ) {
+      snprintf(target,16,"service%d",j);
+      services[s].setTarget(target);
+      devices[d].addService(&services[s++]);
+    }
+    medium.addDevice(&devices[d++]);
+  }
+
+  for( int j=0; j<MAX_SERVICES; j++ ) {
+    snprintf(target,16,"service%d",j);
+    services[s].setTarget(target);
+    large.addService(&services[s++]);
+  }
+  for( int i=0; i<MAX_DEVICES; i++ ) {
+    snprintf(target,16,"device%d",i);
+    devices[d].setTarget(target);
+    for( int j=0; j<MAX_SERVICES; j++ ) {
+      snprintf(target,16,"service%d",j);
+      services[s].setTarget(target);
+      devices[d].addService(&services[s++]);
+    }
+    large.addDevice(&devices[d++]);
+  }
+}
+
+/**
+ *   Walk a hierarchy the way the responder does for a search by type, counting matches instead of sending responses
+ */
+int countMatching(UPnPDevice* d, const char* st) {
+  int result = (d->isType(st)?(1):(0));
+  for( int i=0; i<d->numServices(); i++ ) {if( d->service(i)->isType(st) ) result++;}
+  RootDevice* r = d->asRootDevice();
+  if( r != NULL ) {
+    for( int i=0; i<r->numDevices(); i++ ) {result += countMatching(r->device(i),st);}
+  }
+  return result;
+}
+
+/**
+ *   Per-packet parse cost: the header lookups an incoming packet is put through before a response is decided.
+ */
+void parseSuite() {
+  char name[48];
+  for( unsigned p=0; p<NUM_PACKETS; p++ ) {
+    strncpy_P(packet,PACKETS[p].packet,PACKET_SIZE);
+    int len = strlen(packet);
+
+    snprintf(name,48,"%s/construct",PACKETS[p].name);
+    Bench::run("parse",name,ITERS,[]{UPnPBuffer b(packet); Bench::sink += b.isSearchRequest();},len);
+    snprintf(name,48,"%s/st",PACKETS[p].name);
+    Bench::run("parse",name,ITERS,[]{UPnPBuffer b(packet); Bench::sink += b.headerValue("ST",scratch,100);},len);
+    snprintf(name,48,"%s/lsc",PACKETS[p].name);
+    Bench::run("parse",name,ITERS,[]{UPnPBuffer b(packet); Bench::sink += b.headerValue("ST.LEELANAUSOFTWARE.COM",scratch,20);},len);
+  }
+
+/**
+ *  Responses generated by the library for each kind of object, parsed as a requester would
+ */
+  struct {const char* name; UPnPObject* obj;} responses[] = {{"root",&large},{"device",large.device(0)},{"service",large.device(0)->service(0)}};
+  for( int r=0; r<3; r++ ) {
+    UPnPDevice* d = responses[r].obj->asDevice();
+    int len = ((d != NULL)?(SSDP::formatResponse(packet,PACKET_SIZE,d,ROOT_ST,IFC)):(SSDP::formatResponse(packet,PACKET_SIZE,responses[r].obj->asService(),ROOT_ST,IFC)));
+
+    snprintf(name,48,"lsc_%s_resp/display_name",responses[r].name);
+    Bench::run("parse",name,ITERS,[]{UPnPBuffer b(packet); Bench::sink += b.displayName(scratch,32);},len);
+    snprintf(name,48,"lsc_%s_resp/record",responses[r].name);
+    Bench::run("parse",name,ITERS,[]{UPnPBuffer b(packet); SSDPRecord rec; Bench::sink += rec.parse(b);},len);
+
+    SSDPRecord rec;
+    if( d != NULL ) rec.set(d,IFC);
+    else rec.set(responses[r].obj->asService(),IFC);
+    int binLen = rec.encode((uint8_t*)packet,PACKET_SIZE);
+    snprintf(name,48,"lsc_%s_bin/record",responses[r].name);
+    Bench::run("parse",name,ITERS,[binLen]{SSDPRecord rec; Bench::sink += rec.decode((const uint8_t*)packet,binLen);},binLen);
+  }
+}
+
+/**
+ *   Response rendering for root, device and service, text and binary
+ */
+void renderSuite() {
+  UPnPDevice*  d = large.device(0);
+  UPnPService* s = d->service(0);
+  Bench::run("render","root_text",ITERS,[]{Bench::sink += SSDP::formatResponse(output,PACKET_SIZE,&large,ROOT_ST,IFC);},SSDP::formatResponse(output,PACKET_SIZE,&large,ROOT_ST,IFC));
+  Bench::run("render","device_text",ITERS,[d]{Bench::sink += SSDP::formatResponse(output,PACKET_SIZE,d,ROOT_ST,IFC);},SSDP::formatResponse(output,PACKET_SIZE,d,ROOT_ST,IFC));
+  Bench::run("render","service_text",ITERS,[s]{Bench::sink += SSDP::formatResponse(output,PACKET_SIZE,s,ROOT_ST,IFC);},SSDP::formatResponse(output,PACKET_SIZE,s,ROOT_ST,IFC));
+
+  SSDPRecord rec;
+  rec.set(&large,IFC);
+  Bench::run("render","root_bin",ITERS,[]{SSDPRecord r; r.set(&large,IFC); Bench::sink += r.encode((uint8_t*)output,PACKET_SIZE);},rec.encode((uint8_t*)output,PACKET_SIZE));
+  rec.set(d,IFC);
+  Bench::run("render","device_bin",ITERS,[d]{SSDPRecord r; r.set(d,IFC); Bench::sink += r.encode((uint8_t*)output,PACKET_SIZE);},rec.encode((uint8_t*)output,PACKET_SIZE));
+  rec.set(s,IFC);
+  Bench::run("render","service_bin",ITERS,[s]{SSDPRecord r; r.set(s,IFC); Bench::sink += r.encode((uint8_t*)output,PACKET_SIZE);},rec.encode((uint8_t*)output,PACKET_SIZE));
+}
+
+/**
+ *   Lookup by uuid (hit on the last device and miss) and by type (the responder walk for an ssdp type search) over
+ *   hierarchies of increasing size
+ */
+void lookupSuite() {
+  struct {const char* name; RootDevice* root;} roots[] = {{"small",&small},{"medium",&medium},{"large",&large}};
+  char name[48];
+  for( int r=0; r<3; r++ ) {
+    RootDevice* root = roots[r].root;
+    UPnPDevice* last = ((root->numDevices()>0)?(root->device(root->numDevices()-1)):(root));
+    const char* uuid = last->uuid();
+    const char* svcType = UPnPService::upnpType();
+
+    snprintf(name,48,"%s/uuid_hit",roots[r].name);
+    Bench::run("lookup",name,ITERS,[root,uuid]{Bench::sink += (uint32_t)(root->getDevice(uuid) != NULL);});
+    snprintf(name,48,"%s/uuid_miss",roots[r].name);
+    Bench::run("lookup",name,ITERS,[root]{Bench::sink += (uint32_t)(root->getDevice(MISS_UUID) != NULL);});
+    snprintf(name,48,"%s/type_match",roots[r].name);
+    Bench::run("lookup",name,ITERS,[root,svcType]{Bench::sink += countMatching(root,svcType);});
+    snprintf(name,48,"%s/type_miss",roots[r].name);
+    Bench::run("lookup",name,ITERS,[root]{Bench::sink += countMatching(root,MISS_ST);});
+    snprintf(name,48,"%s/type_id",roots[r].name);
+    Bench::run("lookup",name,ITERS,[svcType]{Bench::sink += SSDPRecord::typeID(svcType);});
+  }
+}
+
+/**
+ *   Path and location building for each level of the hierarchy
+ */
+void pathSuite() {
+  UPnPDevice*  d = large.device(MAX_DEVICES-1);
+  UPnPService* s = d->service(MAX_SERVICES-1);
+  Bench::run("path","root_location",ITERS,[]{large.rootLocation(scratch,128,IFC); Bench::sink += scratch[0];});
+  Bench::run("path","device_location",ITERS,[d]{d->location(scratch,128,IFC); Bench::sink += scratch[0];});
+  Bench::run("path","service_location",ITERS,[s]{s->location(scratch,128,IFC); Bench::sink += scratch[0];});
+  Bench::run("path","device_path",ITERS,[d]{d->getPath(scratch,128); Bench::sink += scratch[0];});
+  Bench::run("path","service_path",ITERS,[s]{s->getPath(scratch,128); Bench::sink += scratch[0];});
+  Bench::run("path","service_handler_path",ITERS,[s]{s->handlerPath(scratch,128,"getData"); Bench::sink += scratch[0];});
+
+  SSDPRecord rec;
+  rec.set(s,IFC);
+  Bench::run("path","record_location",ITERS,[&rec]{rec.location(scratch,128); Bench::sink += scratch[0];});
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+  delay(1000);
+  Serial.println();
+
+  buildHierarchies();
+  Bench::header(BOARD);
+  parseSuite();
+  renderSuite();
+  lookupSuite();
+  pathSuite();
+  Serial.printf("{\"done\":true,\"free_heap\":%u}\n",(unsigned)ESP.getFreeHeap());
+}
+
+void loop() {
+}
@@ -0,0 +1,106 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  Packets for the parse benchmarks. Third party packets have the form of traffic commonly seen on a home network,
+ *  which an LSC device must reject as cheaply as possible. LSC packets are what the library itself sends. Responses
+ *  generated by the library under test are added at run time by the Benchmarks sketch.
+ */
+
+#ifndef PACKETS_H
+#define PACKETS_H
+
+#include <Arduino.h>
+
+typedef struct {
+  const char* name;
+  PGM_P       packet;
+} BenchPacket;
+
+const char PKT_DIAL_SEARCH[]  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: \"ssdp:discover\"\r\n"
+                                        "MX: 1\r\n"
+                                        "ST: urn:dial-multiscreen-org:service:dial:1\r\n"
+                                        "USER-AGENT: Google Chrome/120.0.6099.130 Windows\r\n\r\n";
+
+const char PKT_ALL_SEARCH[]   PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: \"ssdp:discover\"\r\n"
+                                        "MX: 3\r\n"
+                                        "ST: ssdp:all\r\n\r\n";
+
+const char PKT_IGD_NOTIFY[]   PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "CACHE-CONTROL: max-age=1800\r\n"
+                                        "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+                                        "NT: urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n"
+                                        "NTS: ssdp:alive\r\n"
+                                        "SERVER: Linux/4.1.52, UPnP/1.0, Portable SDK for UPnP devices/1.6.22\r\n"
+                                        "X-User-Agent: redsonic\r\n"
+                                        "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n\r\n";
+
+const char PKT_BRIDGE_RESP[]  PROGMEM = "HTTP/1.1 200 OK\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "EXT:\r\n"
+                                        "CACHE-CONTROL: max-age=100\r\n"
+                                        "LOCATION: http://192.168.1.20:80/description.xml\r\n"
+                                        "SERVER: Linux/3.14.0 UPnP/1.0 IpBridge/1.60.0\r\n"
+                                        "hue-bridgeid: 001788FFFE2A5B11\r\n"
+                                        "ST: upnp:rootdevice\r\n"
+                                        "USN: uuid:2f402f80-da50-11e1-9b23-0017882a5b11::upnp:rootdevice\r\n\r\n";
+
+const char PKT_LSC_ROOT[]     PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: ssdp:discover\r\n"
+                                        "ST: upnp:rootdevice\r\n"
+                                        "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+const char PKT_LSC_ALL[]      PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: ssdp:discover\r\n"
+                                        "ST: upnp:rootdevice\r\n"
+                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all bin\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n"
+                                        "TXN.LEELANAUSOFTWARE.COM: 5a3c0e17\r\n\r\n";
+
+const char PKT_LSC_TYPE[]     PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: ssdp:discover\r\n"
+                                        "ST: urn:LeelanauSoftware-com:device:Thermometer:1\r\n"
+                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+const BenchPacket PACKETS[] = {
+  {"dial_search",   PKT_DIAL_SEARCH},
+  {"all_search",    PKT_ALL_SEARCH},
+  {"igd_notify",    PKT_IGD_NOTIFY},
+  {"bridge_resp",   PKT_BRIDGE_RESP},
+  {"lsc_root",      PKT_LSC_ROOT},
+  {"lsc_all_bin",   PKT_LSC_ALL},
+  {"lsc_type",      PKT_LSC_TYPE}
+};
+
+#define NUM_PACKETS (sizeof(PACKETS)/sizeof(BenchPacket))
+
+#endif
@@ -47,4 +47,10 @@ CustomDevice::CustomDevice(const char* target) : UPnPDevice(target) {
 
 int  CustomDevice::formatContent(char buffer[], int size, int pos) {return formatBuffer_P(buffer,size,pos,html_template,getDisplayName());}
 int  CustomDevice::formatRootContent(char buffer[], int size, int pos) {return formatBuffer_P(buffer,size,pos,root_html_template,getDisplayName());}
-void CustomDevice::handleGetMsg(WebContext* svr) {svr->send_P(200,"text/xml",Msg_template);}
+void CustomDevice::handleGetMsg(WebContext* svr) {
+  _msgRequests++;
+  svr->send_P(200,"text/xml",Msg_template);
+  RouteMetrics::responseBytes(strlen_P(Msg_template));
+}
+
+void CustomDevice::formatMetrics(MetricsWriter& w) {w.counter("custom_device_msg_requests_total","Requests for getMsg",_msgRequests);}
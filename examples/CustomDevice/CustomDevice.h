@@ -36,12 +36,14 @@ class CustomDevice : public UPnPDevice {
     int formatRootContent(char buffer[], int size, int pos);   // Format content as displayed at the root device target, return updated write position
 
     void    handleGetMsg(WebContext* svr);
+    void    formatMetrics(MetricsWriter& w);                   // Write device metrics to the RootDevice /metrics page, labeled by device
 
     DEFINE_RTTI;
     DERIVED_TYPE_CHECK(UPnPDevice);
     DEFINE_EXCLUSIONS(CustomDevice);
 
     CustomService    _customService;
+    uint32_t         _msgRequests = 0;
     
 };
 
@@ -71,18 +71,39 @@ void setup() {
  */
   root.setDisplayName("Root Device");
   root.setTarget("root");  
+
+/**
+ *  Serve Prometheus metrics at /metrics, with SSDP metrics along with memory and device metrics, and profile the loop
+ */
+  root.enableMetrics();
+  LoopProfiler::enable();
+  root.addMetrics([](MetricsWriter& w){ssdp.formatMetrics(w);});
   root.setup(&ctx);
   root.addDevice(&d);
+
+/**
+ *  Trace SSDP events in a ring of 256 events (3 KB), dumped at /trace for extras/trace_decode.py
+ */
+  TraceRing::begin(256);
+  ctx.on("/trace",[](WebContext* svr){TraceRing::send(svr);});
   
 /**
  *  Print UPnPDevice info to Serial
  */
   UPnPDevice::printInfo(&root);  
 
+/**
+ *  Print the memory footprint of the device hierarchy and SSDP
+ */
+  Footprint::print([](FootprintVisitor v){root.footprint(v); ssdp.footprint(v);});
+
 }
 
 void loop() {
+  int      probe = LoopProfiler::begin("http");
+  uint32_t start = micros();
   ctx.handleClient();
+  LoopProfiler::end(probe,start);
   ssdp.doSSDP();
   root.doDevice();
 }
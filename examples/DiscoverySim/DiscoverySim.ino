@@ -0,0 +1,216 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SimNetwork.h"
+
+/**
+ *   Discovery latency and completeness on a simulated network. For each network size, SIM_DEVICES embedded devices
+ *   per RootDevice are run as SSDP responders on a SimNetwork, and a single client searches with each strategy in turn.
+ *   For every run the sketch reports time to first response, time until every expected response has arrived, and the
+ *   fraction of expected responses received at fixed checkpoints, as JSON lines on Serial:
+ *
+ *     {"devices":60,"strategy":"all","pacing_ms":500,"expected":300,"received":297,"first_ms":4,"complete_ms":-1,
+ *      "curve":[[100,0.20],[250,0.20],...],"sent":362,"delivered":357,"lost":5,"dropped":0}
+ *
+ *   complete_ms is -1 if some expected responses never arrived. No WiFi connection is needed. Each responder needs about
+ *   2.5KB, so the larger networks need an ESP32 with PSRAM; sizes that do not fit are reported as skipped.
+ */
+
+#define SIM_DEVICES      2                   // Embedded devices per RootDevice, each with one service
+#define SIM_HORIZON      20000               // Milliseconds of virtual time per run
+#define SIM_QUIET        30000               // Milliseconds run after each search so responders finish before the next
+#define SIM_SEED         12345
+
+const int           SIZES[]       = {10, 60, 500};
+const unsigned long CHECKPOINTS[] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 20000};
+
+const SimLink RESPONDER_LINK = {1500, 4000, 0.02, 2500000, 8, 400};     // latency, jitter, loss, bandwidth, queue, process
+const SimLink CLIENT_LINK    = {1500, 4000, 0.02, 2500000, 8, 200};
+
+/**
+ *   Search strategies. A strategy with repeats > 1 sends the search again every interval milliseconds, and pacing is
+ *   the responder SSDP::setResponseDelay() for the run.
+ */
+typedef struct {
+  const char*    name;
+  const char*    st;                 // NULL to search for the UPnPService type
+  boolean        ssdpAll;
+  int            repeats;
+  unsigned long  interval;
+  unsigned long  pacing;
+} Strategy;
+
+const Strategy STRATEGIES[] = {
+  {"root",         "upnp:rootdevice", false, 1, 0,    500},
+  {"root_retry",   "upnp:rootdevice", false, 3, 1000, 500},
+  {"all",          "upnp:rootdevice", true,  1, 0,    500},
+  {"all_paced_50", "upnp:rootdevice", true,  1, 0,    50},
+  {"type",         NULL,              false, 1, 0,    500}
+};
+
+typedef struct {
+  SimNode*     node;
+  RootDevice   root;
+  UPnPDevice   devices[SIM_DEVICES];
+  UPnPService  services[SIM_DEVICES];
+  SSDP         ssdp;
+} Responder;
+
+typedef struct {
+  SimNode*     node;
+  RootDevice   root;
+  SSDP         ssdp;
+} Client;
+
+void setUUID(UPnPDevice* d, int node, int device) {
+  char uuid[UUID_SIZE];
+  snprintf(uuid,UUID_SIZE,"%08x-0000-4000-8000-%012x",node,device);
+  d->setUUID(uuid);
+}
+
+Responder* addResponder(SimNetwork& net, int n) {
+  Responder* r = new Responder();
+  r->node = net.addNode(IPAddress(10,0,1 + n/250,1 + n%250),RESPONDER_LINK);
+  setUUID(&r->root,n,0);
+  for( int i=0; i<SIM_DEVICES; i++ ) {
+    char target[16];
+    snprintf(target,16,"device%d",i);
+    r->devices[i].setTarget(target);
+    setUUID(&r->devices[i],n,i+1);
+    r->devices[i].addService(&r->services[i]);
+    r->root.addDevice(&r->devices[i]);
+  }
+  r->node->unicast()->begin(0);
+  r->ssdp.setClock(r->node->clock());
+  r->ssdp.begin(&r->root,r->node->multicast(),r->node->unicast(),r->node->addr(),IPAddress(255,0,0,0));
+  SSDP* ssdp = &r->ssdp;
+  r->node->setLoop([ssdp]{ssdp->doSSDP();});
+  return r;
+}
+
+uint32_t expected(const Strategy& s, int n) {
+  if( s.st == NULL ) return n*SIM_DEVICES;
+  return ((s.ssdpAll)?(n*(1 + 2*SIM_DEVICES)):(n));
+}
+
+void runStrategy(SimNetwork& net, Client& client, std::vector<Responder*>& responders, const Strategy& s) {
+  for( size_t i=0; i<responders.size(); i++ ) {responders[i]->ssdp.setResponseDelay(s.pacing);}
+  net.resetStatistics();
+  SSDP::resetSearchMetrics();
+
+  uint32_t              total = expected(s,responders.size());
+  std::vector<uint32_t> seen;
+  std::vector<uint32_t> times;
+  uint64_t              start = net.now();
+  const char*           st = ((s.st != NULL)?(s.st):(UPnPService::upnpType()));
+  SimNode*              node = client.node;
+
+  SSDPHandler handler = [&seen,&times,start,node](UPnPBuffer* b) {
+    char usn[128];
+    if( !b->headerValue("USN",usn,128) ) return;
+    uint32_t h = SSDPRecord::hash(usn);
+    std::vector<uint32_t>::iterator it = std::lower_bound(seen.begin(),seen.end(),h);
+    if( (it != seen.end()) && (*it == h) ) return;
+    seen.insert(it,h);
+    times.push_back((uint32_t)((node->now() - start)/1000));
+  };
+
+  int ids[SSDP_MAX_SEARCHES];
+  int numIds = 0;
+  for( int r=0; (r<s.repeats) && (r<SSDP_MAX_SEARCHES); r++ ) {
+    net.run(start + (uint64_t)r*s.interval*1000);
+    net.at(node);
+    if( client.ssdp.startSearch(st,handler,SIM_HORIZON+SIM_QUIET,s.ssdpAll,&ids[numIds]) == SSDP_OK ) numIds++;
+  }
+  net.run(start + (uint64_t)SIM_HORIZON*1000);
+  for( int i=0; i<numIds; i++ ) {client.ssdp.cancelSearch(ids[i]);}
+  SimStatistics stats = net.statistics();
+  const SSDPSearchMetrics& m = SSDP::searchMetrics();
+
+  int32_t first    = ((times.size() > 0)?((int32_t)times[0]):(-1));
+  int32_t complete = ((times.size() >= total)?((int32_t)times[total-1]):(-1));
+  Serial.printf("{\"devices\":%u,\"strategy\":\"%s\",\"pacing_ms\":%lu,\"expected\":%u,\"received\":%u,\"first_ms\":%d,\"complete_ms\":%d,\"curve\":[",
+                (unsigned)responders.size(),s.name,s.pacing,total,(unsigned)times.size(),first,complete);
+  size_t pos = 0;
+  for( size_t c=0; c<sizeof(CHECKPOINTS)/sizeof(unsigned long); c++ ) {
+    while( (pos < times.size()) && (times[pos] <= CHECKPOINTS[c]) ) pos++;
+    Serial.printf("%s[%lu,%.3f]",((c>0)?(","):("")),CHECKPOINTS[c],((total>0)?((float)pos/total):(0.0)));
+  }
+  Serial.printf("],\"sent\":%u,\"delivered\":%u,\"lost\":%u,\"dropped\":%u,\"duplicates\":%u,\"missing_est\":%u}\n",
+                stats.sent,stats.delivered,stats.lost,stats.dropped,m.duplicates,m.missing);
+
+/**
+ *   Let responders finish pacing out responses so they do not spill into the next run
+ */
+  net.run(net.now() + (uint64_t)SIM_QUIET*1000);
+}
+
+size_t availableMemory() {
+#ifdef ESP32
+  return ESP.getFreeHeap() + ESP.getFreePsram();
+#else
+  return ESP.getFreeHeap();
+#endif
+}
+
+void runSize(int n) {
+  size_t need = n * (sizeof(Responder) + sizeof(SimNode) + 1024);
+  if( need > availableMemory() * 8 / 10 ) {
+    Serial.printf("{\"devices\":%d,\"skipped\":true,\"need\":%u,\"free\":%u}\n",n,(unsigned)need,(unsigned)availableMemory());
+    return;
+  }
+
+  SimNetwork net(SIM_SEED);
+  std::vector<Responder*> responders;
+  for( int i=0; i<n; i++ ) {responders.push_back(addResponder(net,i));}
+
+  Client* client = new Client();
+  client->node = net.addNode(IPAddress(10,0,0,1),CLIENT_LINK);
+  client->node->unicast()->begin(0);
+  client->ssdp.setClock(client->node->clock());
+  client->ssdp.begin(&client->root,client->node->multicast(),client->node->unicast(),client->node->addr(),IPAddress(255,0,0,0));
+  SSDP* ssdp = &client->ssdp;
+  client->node->setLoop([ssdp]{ssdp->doSSDP();});
+
+  for( size_t i=0; i<sizeof(STRATEGIES)/sizeof(Strategy); i++ ) {
+    runStrategy(net,*client,responders,STRATEGIES[i]);
+    yield();
+  }
+
+  for( size_t i=0; i<responders.size(); i++ ) {delete responders[i];}
+  delete client;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+  delay(1000);
+  Serial.println();
+
+  for( size_t i=0; i<sizeof(SIZES)/sizeof(int); i++ ) {runSize(SIZES[i]);}
+  Serial.printf("{\"done\":true}\n");
+}
+
+void loop() {
+}
@@ -0,0 +1,249 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SimNetwork.h"
+
+const IPAddress SIM_MULTICAST(239,255,255,250);
+
+/**
+ *  SimChannel
+ */
+uint8_t SimChannel::begin(uint16_t port) {
+  _port = ((port != 0)?(port):(_node->_net->ephemeralPort()));
+  _open = true;
+  return 1;
+}
+
+void SimChannel::stop() {
+  _open = false;
+  _rx.clear();
+  _current.reset();
+}
+
+int SimChannel::beginPacket(IPAddress ip, uint16_t port) {
+  _txAddr   = ip;
+  _txPort   = port;
+  _txActive = true;
+  _tx.clear();
+  return 1;
+}
+
+int SimChannel::beginPacket(const char* host, uint16_t port) {
+  IPAddress ip;
+  return ((ip.fromString(host))?(beginPacket(ip,port)):(0));
+}
+
+size_t SimChannel::write(uint8_t b) {return write(&b,1);}
+
+size_t SimChannel::write(const uint8_t* buffer, size_t size) {
+  if( !_txActive ) return 0;
+  _tx.insert(_tx.end(),buffer,buffer+size);
+  return size;
+}
+
+int SimChannel::endPacket() {
+  if( !_txActive ) return 0;
+  _txActive = false;
+  std::shared_ptr<SimPayload> payload = std::make_shared<SimPayload>();
+  payload->src     = _node->_addr;
+  payload->srcPort = _port;
+  payload->data.swap(_tx);
+  _node->_net->send(_node,_txAddr,_txPort,payload);
+  return 1;
+}
+
+/**
+ *  Reading a packet makes the node busy for its link process time
+ */
+int SimChannel::parsePacket() {
+  _current.reset();
+  _pos = 0;
+  if( _rx.empty() ) return 0;
+  _current = _rx.front();
+  _rx.pop_front();
+  _node->_local += _node->_link.process;
+  return _current->data.size();
+}
+
+int SimChannel::available() {return ((_current)?(_current->data.size() - _pos):(0));}
+int SimChannel::read()      {return ((available() > 0)?(_current->data[_pos++]):(-1));}
+int SimChannel::peek()      {return ((available() > 0)?(_current->data[_pos]):(-1));}
+void SimChannel::flush()    {_current.reset(); _pos = 0;}
+
+int SimChannel::read(unsigned char* buffer, size_t len) {
+  size_t n = available();
+  if( n > len ) n = len;
+  if( n > 0 ) memcpy(buffer,_current->data.data() + _pos,n);
+  _pos += n;
+  return n;
+}
+
+IPAddress SimChannel::remoteIP()  {return ((_current)?(_current->src):(IPAddress()));}
+uint16_t  SimChannel::remotePort() {return ((_current)?(_current->srcPort):(0));}
+
+/**
+ *  SimNode
+ */
+SimNode::SimNode(SimNetwork* net, IPAddress addr, SimLink link) : _net(net), _addr(addr), _link(link), _multicast(this,true), _unicast(this,false) {
+  _multicast.begin(UDP_PORT);
+}
+
+SSDPClock SimNode::clock() {
+  SSDPClock c;
+  c.now  = [this]{return (unsigned long)(_local/1000);};
+  c.wait = [this](unsigned long ms){_local += (uint64_t)ms*1000;};
+  return c;
+}
+
+/**
+ *  SimNetwork
+ */
+SimNetwork::~SimNetwork() {
+  for( size_t i=0; i<_nodes.size(); i++ ) {delete _nodes[i];}
+}
+
+SimNode* SimNetwork::addNode(IPAddress addr, SimLink link) {
+  SimNode* node = new SimNode(this,addr,link);
+  node->_local = _now;
+  _nodes.push_back(node);
+  _byAddr[(uint32_t)addr] = node;
+  return node;
+}
+
+/**
+ *  xorshift32, so runs with the same seed are repeatable
+ */
+uint32_t SimNetwork::random() {
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  return _seed;
+}
+
+boolean SimNetwork::lost(SimLink& link) {
+  return ((link.loss > 0) && ((random() % 1000000) < (uint32_t)(link.loss * 1000000)));
+}
+
+/**
+ *  Returns the time a packet of len bytes, ready at start, has crossed link; free is when the link is next idle
+ */
+uint64_t SimNetwork::serialize(SimLink& link, uint64_t& free, uint64_t start, size_t len) {
+  if( link.bandwidth == 0 ) return start;
+  if( free > start ) start = free;
+  free = start + ((uint64_t)len * 1000000) / link.bandwidth;
+  return free;
+}
+
+void SimNetwork::send(SimNode* from, IPAddress addr, uint16_t port, std::shared_ptr<SimPayload> payload) {
+  _stats.sent++;
+  uint64_t departed = serialize(from->_link,from->_txFree,from->_local,payload->data.size());
+  if( lost(from->_link) ) {
+    _stats.lost++;
+    return;
+  }
+  if( addr == SIM_MULTICAST ) {
+    for( size_t i=0; i<_nodes.size(); i++ ) {
+      SimNode* to = _nodes[i];
+      if( (to != from) && to->_multicast.isOpen() && (to->_multicast.port() == port) ) schedule(from,&to->_multicast,departed,payload);
+    }
+  }
+  else {
+    std::map<uint32_t,SimNode*>::iterator it = _byAddr.find((uint32_t)addr);
+    if( it != _byAddr.end() ) {
+      SimNode* to = it->second;
+      if( to->_unicast.isOpen() && (to->_unicast.port() == port) ) schedule(from,&to->_unicast,departed,payload);
+      else if( to->_multicast.isOpen() && (to->_multicast.port() == port) ) schedule(from,&to->_multicast,departed,payload);
+    }
+  }
+}
+
+void SimNetwork::schedule(SimNode* from, SimChannel* dst, uint64_t departed, std::shared_ptr<SimPayload> payload) {
+  SimLink& out = from->_link;
+  SimLink& in  = dst->_node->_link;
+  uint64_t arrival = departed + out.latency + in.latency;
+  if( out.jitter > 0 ) arrival += random() % out.jitter;
+  if( in.jitter > 0 )  arrival += random() % in.jitter;
+  Event e = {arrival,_seq++,false,dst,payload};
+  _events.push(e);
+}
+
+/**
+ *  A packet reaching the receiver link is serialized onto it, then queued on the channel
+ */
+void SimNetwork::deliver(Event& e) {
+  SimNode* to = e.dst->_node;
+  if( !e.arrived ) {
+    if( lost(to->_link) ) {
+      _stats.lost++;
+      return;
+    }
+    e.arrived = true;
+    e.time    = serialize(to->_link,to->_rxFree,e.time,e.payload->data.size());
+    e.seq     = _seq++;
+    if( e.time > _now ) {
+      _events.push(e);
+      return;
+    }
+  }
+  if( !e.dst->isOpen() ) return;
+  if( (int)e.dst->_rx.size() >= to->_link.queue ) {
+    _stats.dropped++;
+    return;
+  }
+  e.dst->_rx.push_back(e.payload);
+  _stats.delivered++;
+}
+
+/**
+ *  Alternate between delivering every event due at the current time and polling nodes that have input and are no
+ *  longer busy, then advance to the earlier of the next event and the next time a busy node with input frees up.
+ */
+void SimNetwork::run(uint64_t until) {
+  while( true ) {
+    while( !_events.empty() && (_events.top().time <= _now) ) {
+      Event e = _events.top();
+      _events.pop();
+      deliver(e);
+    }
+
+    uint64_t next = UINT64_MAX;
+    boolean  polled = false;
+    for( size_t i=0; i<_nodes.size(); i++ ) {
+      SimNode* node = _nodes[i];
+      if( node->hasInput() ) {
+        if( node->_local <= _now ) {
+          node->_local = _now;
+          node->_loop();
+          if( node->_local == _now ) node->_local++;     // A poll always costs time, so a node that does not read cannot stall the network
+          polled = true;
+        }
+        if( node->hasInput() && (node->_local < next) ) next = node->_local;
+      }
+    }
+    if( polled ) continue;
+
+    if( !_events.empty() && (_events.top().time < next) ) next = _events.top().time;
+    if( (next == UINT64_MAX) || (next > until) ) break;
+    _now = ((next > _now)?(next):(_now));
+  }
+  _now = until;
+}
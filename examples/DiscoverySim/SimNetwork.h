@@ -0,0 +1,224 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  In-memory multicast network for running many SSDP instances in one process on a virtual clock.
+ *
+ *  Each SimNode is a host with one address, a link to the network, and a multicast and a unicast SimChannel. SimChannel
+ *  implements the Arduino UDP interface, so SSDP runs on it unchanged through SSDP::begin(root,multicast,unicast,...).
+ *  Packets to 239.255.255.250 are delivered to every other node with an open multicast channel, all other packets to
+ *  the channel with the destination address and port.
+ *
+ *  A packet leaving a node is serialized onto the sender link at the link bandwidth, then arrives after the sum of
+ *  sender and receiver latency plus jitter, is serialized again on the receiver link, and joins the receive queue of
+ *  the channel. Either link may lose it, and it is dropped if the receive queue is full. Reading a packet costs the
+ *  receiving node SimLink.process microseconds, during which it is busy.
+ *
+ *  Time is virtual and advances only from event to event, so hundreds of nodes run as fast as the host allows. A node
+ *  is polled when it has input and is not busy; SSDPClock::wait() advances the node time without blocking anything
+ *  else, so response pacing delays only that node.
+ */
+
+#ifndef SIM_NETWORK_H
+#define SIM_NETWORK_H
+
+#include <UPnPLib.h>
+#include <Udp.h>
+#include <deque>
+#include <map>
+#include <memory>
+#include <queue>
+#include <vector>
+
+#define SIM_EPHEMERAL_PORT   49152
+
+/** SimLink
+ *  Characteristics of the link between a node and the network
+ */
+typedef struct {
+  uint32_t latency;         // One way latency in microseconds
+  uint32_t jitter;          // Uniform random delay of up to jitter microseconds added to latency
+  float    loss;            // Probability that the link drops a packet
+  uint32_t bandwidth;       // Bytes per second, 0 for unlimited
+  int      queue;           // Receive queue limit per channel, in packets
+  uint32_t process;         // Microseconds the node is busy reading each packet
+} SimLink;
+
+/** SimStatistics
+ *  Network wide packet counters. A multicast packet counts once as sent and once per receiver as delivered.
+ */
+typedef struct {
+  uint32_t sent;
+  uint32_t delivered;
+  uint32_t lost;
+  uint32_t dropped;         // Receive queue full
+} SimStatistics;
+
+typedef struct {
+  IPAddress             src;
+  uint16_t              srcPort;
+  std::vector<uint8_t>  data;
+} SimPayload;
+
+class SimNetwork;
+class SimNode;
+
+/** SimChannel class definition
+ *  UDP channel of a SimNode
+ */
+class SimChannel : public UDP {
+  public:
+    SimChannel(SimNode* node, boolean multicast) : _node(node), _multicast(multicast) {}
+
+    uint8_t   begin(uint16_t port);
+    void      stop();
+    int       beginPacket(IPAddress ip, uint16_t port);
+    int       beginPacket(const char* host, uint16_t port);
+    int       endPacket();
+    size_t    write(uint8_t b);
+    size_t    write(const uint8_t* buffer, size_t size);
+    int       parsePacket();
+    int       available();
+    int       read();
+    int       read(unsigned char* buffer, size_t len);
+    int       read(char* buffer, size_t len)            {return read((unsigned char*)buffer,len);}
+    int       peek();
+    void      flush();
+    IPAddress remoteIP();
+    uint16_t  remotePort();
+
+    using     Print::write;
+
+    boolean   isOpen()                                  {return _open;}
+    boolean   isMulticast()                             {return _multicast;}
+    uint16_t  port()                                    {return _port;}
+    boolean   hasInput()                                {return !_rx.empty();}
+
+  private:
+    SimNode*                                 _node;
+    boolean                                  _multicast;
+    boolean                                  _open = false;
+    uint16_t                                 _port = 0;
+    boolean                                  _txActive = false;
+    IPAddress                                _txAddr;
+    uint16_t                                 _txPort = 0;
+    std::vector<uint8_t>                     _tx;
+    std::deque<std::shared_ptr<SimPayload>>  _rx;
+    std::shared_ptr<SimPayload>              _current;
+    size_t                                   _pos = 0;
+
+    friend class SimNetwork;
+};
+
+/** SimNode class definition
+ *  A host on the simulated network. Class members are as follows:
+ *    addr()/link()      := Node address and link characteristics
+ *    multicast()        := Channel for the SSDP multicast group, open on UDP_PORT
+ *    unicast()          := Unicast channel, opened by begin(0) on an ephemeral port
+ *    clock()            := SSDPClock running on node time, for SSDP::setClock()
+ *    setLoop(f)         := Function called to poll the node, typically calling SSDP::doSSDP()
+ *    now()              := Node time in microseconds
+ */
+class SimNode {
+  public:
+    SimNode(SimNetwork* net, IPAddress addr, SimLink link);
+
+    IPAddress     addr()                          {return _addr;}
+    SimLink&      link()                          {return _link;}
+    SimChannel*   multicast()                     {return &_multicast;}
+    SimChannel*   unicast()                       {return &_unicast;}
+    SimNetwork*   network()                       {return _net;}
+    SSDPClock     clock();
+    void          setLoop(std::function<void(void)> f)  {_loop = f;}
+    uint64_t      now()                           {return _local;}
+    boolean       hasInput()                      {return (_multicast.hasInput() || _unicast.hasInput());}
+
+  private:
+    SimNetwork*                  _net;
+    IPAddress                    _addr;
+    SimLink                      _link;
+    SimChannel                   _multicast;
+    SimChannel                   _unicast;
+    std::function<void(void)>    _loop = []{};
+    uint64_t                     _local  = 0;          // Node time while polled, busy until this time afterwards
+    uint64_t                     _txFree = 0;          // Sender link idle from this time
+    uint64_t                     _rxFree = 0;          // Receiver link idle from this time
+
+    friend class SimNetwork;
+    friend class SimChannel;
+};
+
+/** SimNetwork class definition
+ *  Class members are as follows:
+ *    addNode(addr,link)     := Add a node, the network owns it
+ *    now()                  := Network time in microseconds
+ *    run(until)             := Deliver packets and poll nodes until network time until
+ *    at(node)               := Bring node time up to network time, call before acting on a node from outside run()
+ *    statistics()           := Packet counters
+ *    random()               := Deterministic random number from the network seed
+ */
+class SimNetwork {
+  public:
+    SimNetwork(uint32_t seed=1) : _seed((seed!=0)?(seed):(1)) {}
+    virtual ~SimNetwork();
+
+    SimNode*              addNode(IPAddress addr, SimLink link);
+    uint64_t              now()                  {return _now;}
+    void                  run(uint64_t until);
+    void                  at(SimNode* node)      {if( node->_local < _now ) node->_local = _now;}
+    const SimStatistics&  statistics()           {return _stats;}
+    void                  resetStatistics()      {memset(&_stats,0,sizeof(_stats));}
+    uint32_t              random();
+
+  private:
+    typedef struct {
+      uint64_t                     time;
+      uint32_t                     seq;
+      boolean                      arrived;         // False while crossing the network, true once through the receiver link
+      SimChannel*                  dst;
+      std::shared_ptr<SimPayload>  payload;
+    } Event;
+
+    struct Later {
+      bool operator()(const Event& a, const Event& b) const {return ((a.time != b.time)?(a.time > b.time):(a.seq > b.seq));}
+    };
+
+    std::vector<SimNode*>                             _nodes;
+    std::map<uint32_t,SimNode*>                       _byAddr;
+    std::priority_queue<Event,std::vector<Event>,Later> _events;
+    uint64_t                                          _now = 0;
+    uint32_t                                          _seq = 0;
+    uint32_t                                          _seed;
+    uint16_t                                          _nextPort = SIM_EPHEMERAL_PORT;
+    SimStatistics                                     _stats = {0,0,0,0};
+
+    void                  send(SimNode* from, IPAddress addr, uint16_t port, std::shared_ptr<SimPayload> payload);
+    void                  schedule(SimNode* from, SimChannel* dst, uint64_t departed, std::shared_ptr<SimPayload> payload);
+    void                  deliver(Event& e);
+    boolean               lost(SimLink& link);
+    uint64_t              serialize(SimLink& link, uint64_t& free, uint64_t start, size_t len);
+    uint16_t              ephemeralPort()        {return _nextPort++;}
+
+    friend class SimChannel;
+};
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include <LoopbackUDP.h>
+
+/**
+ *   Federation hubs run in one process, exchanging FED-SYNC and FED-DELTA over LoopbackUDP channels, so the exchange
+ *   can be checked without a network. Hub i listens on port HUB_PORT+i, and each packet sent is delivered to the hub
+ *   listening on its destination port. A hub sweep is made from the responses its own RootDevice, embedded device and 
+ *   service would send, fed through Federation::beginSweep(), sweepResponse() and endSweep(). The sketch checks that
+ *
+ *     1. after an exchange every hub holds the records of every hub
+ *     2. a failed sweep keeps the hub records and version
+ *     3. a hub that restarts continues from the version its peers hold, and its new records replace the old ones
+ *
+ *   and writes one PASS or FAIL line per check to Serial.
+ */
+
+#define HUBS          3
+#define HUB_PORT      1901
+#define QUEUE_DEPTH   16
+#define MAX_ROUNDS    200
+
+const IPAddress LOOPBACK(127,0,0,1);
+
+RootDevice     roots[HUBS];
+UPnPDevice     devices[HUBS];
+UPnPService    services[HUBS];
+LoopbackUDP*   channels[HUBS];
+Federation*    hubs[HUBS];
+int            dropped = 0;
+int            failed  = 0;
+
+void buildHierarchy() {
+  for( int i=0; i<HUBS; i++ ) {
+    char buff[UUID_SIZE];
+    snprintf(buff,UUID_SIZE,"38323636-4558-4dda-9188-cda0e6aa%02x00",i);
+    roots[i].setUUID(buff);
+    snprintf(buff,UUID_SIZE,"38323636-4558-4dda-9188-cda0e6aa%02x01",i);
+    devices[i].setUUID(buff);
+    snprintf(buff,NAME_SIZE,"hub%d",i);
+    roots[i].setTarget(buff);
+    snprintf(buff,NAME_SIZE,"Device %d",i);
+    devices[i].setDisplayName(buff);
+    devices[i].setTarget("device");
+    devices[i].addService(&services[i]);
+    roots[i].addDevice(&devices[i]);
+  }
+}
+
+/**
+ *   Start hub i on its channel with every other hub as a peer. Syncs are only sent by exchange().
+ */
+void startHub(int i) {
+  channels[i]->clear();
+  hubs[i] = new Federation();
+  hubs[i]->begin(&roots[i],channels[i],HUB_PORT+i);
+  hubs[i]->setSyncInterval(0xFFFFFFFF);
+  for( int j=0; j<HUBS; j++ ) {if( j != i ) hubs[i]->addPeer(LOOPBACK,HUB_PORT+j);}
+}
+
+void sweepResponse(int hub, char packet[]) {
+  UPnPBuffer b(packet);
+  hubs[hub]->sweepResponse(&b);
+}
+
+void sweep(int i, SSDPResult result) {
+  char packet[SSDP_RESPONSE_SIZE];
+  hubs[i]->beginSweep();
+  SSDP::formatResponse(packet,SSDP_RESPONSE_SIZE,&roots[i],"upnp:rootdevice",LOOPBACK);
+  sweepResponse(i,packet);
+  SSDP::formatResponse(packet,SSDP_RESPONSE_SIZE,&devices[i],"upnp:rootdevice",LOOPBACK);
+  sweepResponse(i,packet);
+  SSDP::formatResponse(packet,SSDP_RESPONSE_SIZE,&services[i],"upnp:rootdevice",LOOPBACK);
+  sweepResponse(i,packet);
+  hubs[i]->endSweep(result);
+}
+
+/**
+ *   Every hub sends FED-SYNC to its peers, and hubs read their channels until no packets are left
+ */
+void exchange() {
+  for( int i=0; i<HUBS; i++ ) {hubs[i]->sync();}
+  boolean busy = true;
+  for( int round=0; busy && (round<MAX_ROUNDS); round++ ) {
+    busy = false;
+    for( int i=0; i<HUBS; i++ ) {
+      if( channels[i]->queued() > 0 ) {
+        hubs[i]->doFederation();
+        busy = true;
+      }
+    }
+  }
+}
+
+/**
+ *   True if hub holds a record with uuid whose description has name
+ */
+boolean holds(int hub, const char* uuid, const char* name) {
+  boolean found = false;
+  char st[UUID_SIZE+5];
+  snprintf(st,sizeof(st),"uuid:%s",uuid);
+  hubs[hub]->query(st,[&found,name](FederationRecord* r){if( strstr(r->desc(),name) != NULL ) found = true;});
+  return found;
+}
+
+/**
+ *   Version hub holds for the hub with uuid, 0 if unknown
+ */
+uint32_t versionOf(int hub, const char* uuid) {
+  uint32_t result = 0;
+  for( int i=0; i<hubs[hub]->numHubs(); i++ ) {if( strcmp(hubs[hub]->hubUUID(i),uuid) == 0 ) result = hubs[hub]->hubVersion(i);}
+  return result;
+}
+
+void check(boolean ok, const char* name) {
+  if( !ok ) failed++;
+  Serial.printf("%s %s\n",((ok)?("PASS"):("FAIL")),name);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  buildHierarchy();
+  for( int i=0; i<HUBS; i++ ) {
+    channels[i] = new LoopbackUDP(QUEUE_DEPTH);
+    channels[i]->onSend([i](const char* packet, int len) {
+      int to = channels[i]->sendPort() - HUB_PORT;
+      if( (to < 0) || (to >= HUBS) || !channels[to]->inject(packet,len,LOOPBACK,HUB_PORT+i,millis()) ) dropped++;
+    });
+  }
+  for( int i=0; i<HUBS; i++ ) {
+    startHub(i);
+    sweep(i,SSDP_OK);
+  }
+
+  exchange();
+  boolean all = true;
+  for( int i=0; i<HUBS; i++ ) {
+    all = all && (hubs[i]->numRecords() == 3*HUBS) && (hubs[i]->numHubs() == HUBS);
+    for( int j=0; j<HUBS; j++ ) {all = all && holds(i,devices[j].uuid(),devices[j].getDisplayName());}
+  }
+  check(all,"every hub holds the records of every hub");
+
+  uint32_t version = hubs[0]->hubVersion(0);
+  devices[0].setDisplayName("Renamed 0");
+  sweep(0,SSDP_ERR_UDP);
+  check((hubs[0]->hubVersion(0) == version) && (hubs[0]->numRecords() == 3*HUBS) && holds(0,devices[0].uuid(),"Device 0"),"failed sweep keeps records and version");
+
+  sweep(0,SSDP_OK);
+  exchange();
+  uint32_t before = versionOf(1,roots[0].uuid());
+  check((before > 1) && holds(1,devices[0].uuid(),"Renamed 0"),"sweep with changed records reaches peers");
+
+  delete hubs[0];
+  startHub(0);
+  devices[0].setDisplayName("Restarted 0");
+  sweep(0,SSDP_OK);
+  exchange();
+  boolean restarted = (hubs[0]->hubVersion(0) > before) && (hubs[0]->numRecords() == 3*HUBS);
+  for( int i=1; i<HUBS; i++ ) {restarted = restarted && (versionOf(i,roots[0].uuid()) > before) && holds(i,devices[0].uuid(),"Restarted 0") && !holds(i,devices[0].uuid(),"Renamed 0");}
+  check(restarted,"restarted hub continues from the peer version");
+
+  Serial.printf("%d checks failed, %d packets dropped\n",failed,dropped);
+}
+
+void loop() {}
@@ -0,0 +1,172 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include <LoopbackUDP.h>
+
+/**
+ *   Two relays are both attached to the same two segments, so each search one relay forwards is heard by the other
+ *   and would be forwarded back, a relay loop. Relays run in one process on LoopbackUDP channels: relay r has address
+ *   10.0.s.r on segment s, and each multicast sent on a segment is delivered to the multicast channel of every relay,
+ *   including the sender, from the address of the sending interface. The sketch checks that
+ *
+ *     1. a search from one segment is forwarded to the other by both relays
+ *     2. searches returning to a relay are dropped as looped, and the forwarding stops
+ *     3. relay ids differ
+ *     4. a search already carrying RELAY_MAX_HOPS relay ids is dropped, and one carrying fewer is forwarded
+ *     5. a search for binary records is forwarded without the bin token, so responders answer in text
+ *
+ *   and writes one PASS or FAIL line per check to Serial.
+ */
+
+#define RELAYS        2
+#define SEGMENTS      2
+#define QUEUE_DEPTH   16
+#define MAX_ROUNDS    100
+#define REQUEST_PORT  50000
+
+const IPAddress SSDP_GROUP(239,255,255,250);
+const IPAddress MASK(255,255,255,0);
+
+const char SEARCH_TEMPLATE[] = "M-SEARCH * HTTP/1.1\r\n"
+                               "HOST: 239.255.255.250:1900\r\n"
+                               "MAN: \"ssdp:discover\"\r\n"
+                               "MX: 1\r\n"
+                               "ST: %s\r\n"
+                               "ST.LEELANAUSOFTWARE.COM: %s\r\n"
+                               "%s\r\n";
+
+SSDPRelay*     relays[RELAYS];
+LoopbackUDP*   multicast[RELAYS];
+LoopbackUDP*   interfaces[RELAYS][SEGMENTS];
+int            delivered = 0;
+int            binary    = 0;                          // Forwarded searches still asking for binary records
+int            dropped   = 0;
+int            failed    = 0;
+
+IPAddress address(int relay, int segment) {return IPAddress(10,0,segment+1,relay+1);}
+
+/**
+ *   Multicast from relay on segment, delivered to every relay multicast channel
+ */
+void deliver(int relay, int segment, const char* packet, int len) {
+  if( memmem(packet,len,"ssdp:all bin",12) != NULL ) binary++;
+  for( int k=0; k<RELAYS; k++ ) {
+    if( multicast[k]->inject(packet,len,address(relay,segment),REQUEST_PORT+relay,millis()) ) delivered++;
+    else dropped++;
+  }
+}
+
+/**
+ *   Search from a requester on segment with ST st and RELAY.LEELANAUSOFTWARE.COM header line relayLine (or empty)
+ */
+void search(int segment, const char* st, const char* relayLine, const char* lsc="ssdp:all") {
+  char packet[512];
+  int len = snprintf(packet,sizeof(packet),SEARCH_TEMPLATE,st,lsc,relayLine);
+  for( int k=0; k<RELAYS; k++ ) {multicast[k]->inject(packet,len,IPAddress(10,0,segment+1,100),REQUEST_PORT,millis());}
+}
+
+/**
+ *   Run every relay until no packets are left, returns false if packets were still queued after MAX_ROUNDS
+ */
+boolean run() {
+  boolean busy = true;
+  for( int round=0; busy && (round<MAX_ROUNDS); round++ ) {
+    busy = false;
+    for( int r=0; r<RELAYS; r++ ) {
+      if( multicast[r]->queued() > 0 ) {
+        relays[r]->doRelay();
+        busy = true;
+      }
+    }
+  }
+  return !busy;
+}
+
+uint32_t forwarded() {
+  uint32_t result = 0;
+  for( int r=0; r<RELAYS; r++ ) {result += relays[r]->statistics().searchesForwarded;}
+  return result;
+}
+
+uint32_t looped() {
+  uint32_t result = 0;
+  for( int r=0; r<RELAYS; r++ ) {result += relays[r]->statistics().searchesLooped;}
+  return result;
+}
+
+void check(boolean ok, const char* name) {
+  if( !ok ) failed++;
+  Serial.printf("%s %s\n",((ok)?("PASS"):("FAIL")),name);
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  for( int r=0; r<RELAYS; r++ ) {
+    relays[r]    = new SSDPRelay();
+    multicast[r] = new LoopbackUDP(QUEUE_DEPTH);
+    for( int s=0; s<SEGMENTS; s++ ) {
+      interfaces[r][s] = new LoopbackUDP(QUEUE_DEPTH);
+      interfaces[r][s]->onSend([r,s](const char* packet, int len) {
+        if( interfaces[r][s]->sendIP() == SSDP_GROUP ) deliver(r,s,packet,len);
+      });
+      relays[r]->addInterface(address(r,s),MASK,interfaces[r][s]);
+    }
+    relays[r]->begin(multicast[r]);
+  }
+
+  search(0,"upnp:rootdevice","");
+  boolean stopped = run();
+  boolean all = true;
+  for( int r=0; r<RELAYS; r++ ) {all = all && (relays[r]->statistics().searchesForwarded >= 1);}
+  check(all,"search is forwarded by every relay");
+  check(stopped && (looped() > 0) && (forwarded() <= RELAYS*RELAYS),"looped searches are dropped and forwarding stops");
+  check(relays[0]->relayID() != relays[1]->relayID(),"relay ids differ");
+
+  char ids[RELAY_MAX_HOPS*9+1];
+  char relayLine[sizeof(ids)+40];
+  ids[0] = '\0';
+  for( int i=0; i<RELAY_MAX_HOPS-1; i++ ) {snprintf(ids+strlen(ids),sizeof(ids)-strlen(ids),"%s%08x",((i>0)?(","):("")),i+1);}
+  snprintf(relayLine,sizeof(relayLine),"RELAY.LEELANAUSOFTWARE.COM: %s\r\n",ids);
+  uint32_t before = forwarded();
+  search(1,"urn:LeelanauSoftware-com:device:Below:1",relayLine);
+  run();
+  boolean below = (forwarded() > before);
+
+  snprintf(ids+strlen(ids),sizeof(ids)-strlen(ids),",%08x",RELAY_MAX_HOPS);
+  snprintf(relayLine,sizeof(relayLine),"RELAY.LEELANAUSOFTWARE.COM: %s\r\n",ids);
+  before = forwarded();
+  uint32_t loops = looped();
+  search(1,"urn:LeelanauSoftware-com:device:Limit:1",relayLine);
+  run();
+  check(below && (forwarded() == before) && (looped() == loops + RELAYS),"hop limit is enforced");
+
+  before = forwarded();
+  search(0,"urn:LeelanauSoftware-com:device:Binary:1","","ssdp:all bin");
+  run();
+  check((forwarded() > before) && (binary == 0),"binary search is forwarded for text responses");
+
+  Serial.printf("%d checks failed, %d searches delivered, %d dropped\n",failed,delivered,dropped);
+}
+
+void loop() {}
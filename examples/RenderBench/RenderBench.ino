@@ -0,0 +1,192 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include "StackProbe.h"
+
+/**
+ *   Rendering benchmark for device HTML pages. Synthetic hierarchies of increasing size are rendered the way the web
+ *   server renders them: the root page by RootDevice::formatRootPage(), as sent by displayRoot(), and device pages by
+ *   UPnPDevice::formatPage(), as sent by display(), each into a DISPLAY_SIZE buffer on the stack. For every page the
+ *   sketch writes one JSON line in the format of the Benchmarks example, with
+ *
+ *     cycles, ns := Render time per page
+ *     bytes      := Bytes written into the DISPLAY_SIZE buffer
+ *     needed     := Bytes the page needs, from rendering it again into a RENDER_REFERENCE_SIZE buffer
+ *     truncated  := 1 if the page did not fit in DISPLAY_SIZE, that is, the browser would get a cut off page
+ *     stack      := Peak stack used by one render, the DISPLAY_SIZE buffer included (see StackProbe.h)
+ *
+ *   followed by a summary line. WebContext sends through the platform web server, so pages are not sent; formatPage() and
+ *   formatRootPage() produce exactly the buffer display() and displayRoot() send. Pages the web server sent truncated
+ *   at run time are counted by UPnPDevice::displayTruncations(). Compare two builds with
+ *
+ *     python3 extras/bench_compare.py before.jsonl after.jsonl
+ */
+
+#ifdef ESP8266
+#define BOARD "ESP8266"
+#else
+#define BOARD "ESP32"
+#endif
+
+#define RENDER_ITERS          200
+#define RENDER_REFERENCE_SIZE 6144
+
+const char table_start[] PROGMEM = "<table>";
+const char table_row[]   PROGMEM = "<tr><td>%s %d</td><td align=\"right\">%d.%d</td></tr>";
+const char table_end[]   PROGMEM = "</table>";
+
+/**
+ *   A device whose page is a table of readings, in the manner of sensor devices with a page of history. Row count
+ *   sets the page size.
+ */
+class TableDevice : public UPnPDevice {
+  public:
+    TableDevice() : UPnPDevice("table") {}
+
+    void setRows(int rows) {_rows = rows;}
+
+    int formatContent(char buffer[], int size, int pos) {
+      pos = formatBuffer_P(buffer,size,pos,table_start);
+      for( int i=0; (i<_rows) && (pos<size); i++ ) pos = formatBuffer_P(buffer,size,pos,table_row,getDisplayName(),i,20+i%10,i%10);
+      return formatBuffer_P(buffer,size,pos,table_end);
+    }
+
+  private:
+    int _rows = 0;
+};
+
+/**
+ *   Root pages for 1, 4 and MAX_DEVICES embedded devices with short and with the longest display names, and a root
+ *   of table devices with 8 to 96 rows
+ */
+#define NUM_ROOTS  6
+#define NUM_TABLES 4
+
+RootDevice       roots[NUM_ROOTS];
+UPnPDevice       devices[2*(1 + 4 + MAX_DEVICES)];
+RootDevice       tableRoot("tables");
+TableDevice      tables[NUM_TABLES];
+
+const int        ROOT_DEVICES[NUM_ROOTS] = {1,4,MAX_DEVICES,1,4,MAX_DEVICES};
+const int        TABLE_ROWS[NUM_TABLES]  = {8,24,48,96};
+
+char             reference[RENDER_REFERENCE_SIZE];
+volatile int     sink    = 0;
+uint32_t         overhead = 0;
+
+int              pages     = 0;
+int              truncated = 0;
+int              maxStack  = 0;
+
+void buildHierarchies() {
+  char buff[NAME_SIZE];
+  int d = 0;
+  for( int r=0; r<NUM_ROOTS; r++ ) {
+    boolean longNames = (r >= NUM_ROOTS/2);
+    snprintf(buff,NAME_SIZE,"root%d",r);
+    roots[r].setTarget(buff);
+    if( longNames ) roots[r].setDisplayName("Leelanau Software Root Device 0");
+    for( int i=0; i<ROOT_DEVICES[r]; i++ ) {
+      snprintf(buff,NAME_SIZE,"device%d",i);
+      devices[d].setTarget(buff);
+      if( longNames ) snprintf(buff,NAME_SIZE,"Leelanau Software Device %06d",i);
+      else snprintf(buff,NAME_SIZE,"Device %d",i);
+      devices[d].setDisplayName(buff);
+      roots[r].addDevice(&devices[d++]);
+    }
+  }
+  for( int i=0; i<NUM_TABLES; i++ ) {
+    snprintf(buff,NAME_SIZE,"table%d",i);
+    tables[i].setTarget(buff);
+    snprintf(buff,NAME_SIZE,"Sensor %d",i);
+    tables[i].setDisplayName(buff);
+    tables[i].setRows(TABLE_ROWS[i]);
+    tableRoot.addDevice(&tables[i]);
+  }
+}
+
+template<typename F>
+uint32_t measure(F f) {
+  for( int i=0; i<4; i++ ) {f();}
+  uint32_t start = ESP.getCycleCount();
+  for( int i=0; i<RENDER_ITERS; i++ ) {f();}
+  return (ESP.getCycleCount() - start)/RENDER_ITERS;
+}
+
+/**
+ *   Time, size and stack of one page. render(buffer,size) formats the page into buffer and returns the write position.
+ */
+template<typename R>
+void runPage(const char* bench, R render) {
+  uint32_t cycles = measure([render]{char buffer[DISPLAY_SIZE]; sink += render(buffer,DISPLAY_SIZE);});
+  cycles = ((cycles > overhead)?(cycles - overhead):(0));
+  uint32_t ns = (uint32_t)((uint64_t)cycles * 1000 / ESP.getCpuFreqMHz());
+
+  int bytes = 0;
+  boolean cut = false;
+  int stack = StackProbe::measure([render,&bytes,&cut]{
+    char buffer[DISPLAY_SIZE];
+    cut = UPnPDevice::isTruncated(DISPLAY_SIZE,render(buffer,DISPLAY_SIZE));
+    bytes = strlen(buffer);
+  });
+  render(reference,RENDER_REFERENCE_SIZE);
+  int needed = strlen(reference);
+  cut = cut || (needed > bytes);
+
+  pages++;
+  if( cut ) truncated++;
+  if( stack > maxStack ) maxStack = stack;
+  Serial.printf("{\"suite\":\"html\",\"bench\":\"%s\",\"iters\":%u,\"cycles\":%u,\"ns\":%u,\"bytes\":%d,\"needed\":%d,\"truncated\":%d,\"stack\":%d}\n",
+                bench,RENDER_ITERS,cycles,ns,bytes,needed,(cut?1:0),stack);
+  yield();
+}
+
+void setup() {
+  Serial.begin(115200);
+  delay(500);
+  Serial.printf("\n{\"run\":\"RenderBench\",\"board\":\"%s\",\"cpu_mhz\":%u,\"display_size\":%d}\n",BOARD,(unsigned)ESP.getCpuFreqMHz(),DISPLAY_SIZE);
+  buildHierarchies();
+  overhead = measure([]{sink++;});
+
+  char name[48];
+  for( int r=0; r<NUM_ROOTS; r++ ) {
+    RootDevice* root = &roots[r];
+    const char* names = ((r >= NUM_ROOTS/2)?("long"):("short"));
+    snprintf(name,48,"root_page/%ddev_%s",root->numDevices(),names);
+    runPage(name,[root](char buffer[], int size){return root->formatRootPage(buffer,size);});
+    snprintf(name,48,"root_device_page/%ddev_%s",root->numDevices(),names);
+    runPage(name,[root](char buffer[], int size){return root->formatPage(buffer,size);});
+  }
+  UPnPDevice* d = roots[0].device(0);
+  runPage("device_page/default",[d](char buffer[], int size){return d->formatPage(buffer,size);});
+  runPage("root_page/tables",[](char buffer[], int size){return tableRoot.formatRootPage(buffer,size);});
+  for( int i=0; i<NUM_TABLES; i++ ) {
+    TableDevice* t = &tables[i];
+    snprintf(name,48,"table_page/%drows",TABLE_ROWS[i]);
+    runPage(name,[t](char buffer[], int size){return t->formatPage(buffer,size);});
+  }
+
+  Serial.printf("{\"summary\":\"html\",\"pages\":%d,\"truncated\":%d,\"max_stack\":%d,\"stack_probe\":%d}\n",pages,truncated,maxStack,STACK_PROBE_SIZE);
+}
+
+void loop() {}
@@ -0,0 +1,75 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  Peak stack use of a function, by stack painting. A region of STACK_PROBE_SIZE bytes below the caller's stack
+ *  pointer is filled with a pattern, the function is called, and the region is scanned from its deep end for the
+ *  first byte that was overwritten:
+ *
+ *    int used = StackProbe::measure([]{char buffer[DISPLAY_SIZE]; root.formatRootPage(buffer,DISPLAY_SIZE);});
+ *
+ *  The result includes the frames of every function called, so it is what a request handler would need on top of
+ *  the stack already in use when it is called. It is accurate to a few words, since the paint and scan frames are not
+ *  exactly the caller's. A result of STACK_PROBE_SIZE means the function used at least that much. The probe must fit
+ *  on the stack itself; the loop task has 4KB on ESP8266 and 8KB on ESP32.
+ */
+
+#ifndef STACK_PROBE_H
+#define STACK_PROBE_H
+
+#include <Arduino.h>
+
+#ifndef STACK_PROBE_SIZE
+#ifdef ESP8266
+#define STACK_PROBE_SIZE  2560
+#else
+#define STACK_PROBE_SIZE  5120
+#endif
+#endif
+
+#define STACK_PATTERN     0xA5
+
+class StackProbe {
+  public:
+
+    template<typename F>
+    static int measure(F f) {
+      paint();
+      f();
+      return scan();
+    }
+
+  private:
+    static void __attribute__((noinline)) paint() {
+      volatile uint8_t area[STACK_PROBE_SIZE];
+      for( int i=0; i<STACK_PROBE_SIZE; i++ ) area[i] = STACK_PATTERN;
+    }
+
+    static int __attribute__((noinline)) scan() {
+      volatile uint8_t area[STACK_PROBE_SIZE];
+      int untouched = 0;
+      while( (untouched < STACK_PROBE_SIZE) && (area[untouched] == STACK_PATTERN) ) untouched++;
+      return STACK_PROBE_SIZE - untouched;
+    }
+};
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  Built in replay corpus: a short capture of the kind of traffic that has caused trouble in the field, a NOTIFY
+ *  storm from a gateway, third party searches and responses, malformed and oversized packets, and LSC searches the
+ *  responder answers. Replace this file with one generated from a real capture by
+ *
+ *    python3 extras/pcap_replay.py capture.pcapng --header examples/SSDPReplay/Corpus.h
+ *
+ *  Each packet has the time since the previous packet in microseconds, the source address and port, and the payload
+ *  with its length, since payloads may contain null bytes.
+ */
+
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <Arduino.h>
+
+typedef struct {
+  uint32_t    delta;
+  uint8_t     src[4];
+  uint16_t    port;
+  uint16_t    len;
+  PGM_P       data;
+} ReplayPacket;
+
+#define CORPUS_NAME "builtin"
+
+#define PAD_100 "XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX"
+
+const char CORPUS_0[]  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "MAN: ssdp:discover\r\n"
+                                 "ST: upnp:rootdevice\r\n"
+                                 "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                 "TXN.LEELANAUSOFTWARE.COM: 00000001\r\n"
+                                 "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+const char CORPUS_1[]  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "MAN: \"ssdp:discover\"\r\n"
+                                 "MX: 1\r\n"
+                                 "ST: urn:dial-multiscreen-org:service:dial:1\r\n"
+                                 "USER-AGENT: Google Chrome/120.0.6099.130 Windows\r\n\r\n";
+
+const char CORPUS_2[]  PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "CACHE-CONTROL: max-age=1800\r\n"
+                                 "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+                                 "NT: upnp:rootdevice\r\n"
+                                 "NTS: ssdp:alive\r\n"
+                                 "SERVER: Linux/4.1.52, UPnP/1.0, Portable SDK for UPnP devices/1.6.22\r\n"
+                                 "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::upnp:rootdevice\r\n\r\n";
+
+const char CORPUS_3[]  PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "CACHE-CONTROL: max-age=1800\r\n"
+                                 "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+                                 "NT: urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n"
+                                 "NTS: ssdp:alive\r\n"
+                                 "SERVER: Linux/4.1.52, UPnP/1.0, Portable SDK for UPnP devices/1.6.22\r\n"
+                                 "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n\r\n";
+
+const char CORPUS_4[]  PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "CACHE-CONTROL: max-age=1800\r\n"
+                                 "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+                                 "NT: urn:schemas-upnp-org:service:WANIPConnection:1\r\n"
+                                 "NTS: ssdp:alive\r\n"
+                                 "SERVER: Linux/4.1.52, UPnP/1.0, Portable SDK for UPnP devices/1.6.22\r\n"
+                                 "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::urn:schemas-upnp-org:service:WANIPConnection:1\r\n\r\n";
+
+const char CORPUS_5[]  PROGMEM = "HTTP/1.1 200 OK\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "EXT:\r\n"
+                                 "CACHE-CONTROL: max-age=100\r\n"
+                                 "LOCATION: http://192.168.1.20:80/description.xml\r\n"
+                                 "SERVER: Linux/3.14.0 UPnP/1.0 IpBridge/1.60.0\r\n"
+                                 "hue-bridgeid: 001788FFFE2A5B11\r\n"
+                                 "ST: upnp:rootdevice\r\n"
+                                 "USN: uuid:2f402f80-da50-11e1-9b23-0017882a5b11::upnp:rootdevice\r\n\r\n";
+
+/**
+ *  Bare line feeds and headers without a colon
+ */
+const char CORPUS_6[]  PROGMEM = "M-SEARCH * HTTP/1.1\n"
+                                 "HOST 239.255.255.250:1900\n"
+                                 "MAN ssdp:discover\n"
+                                 "ST upnp:rootdevice\n"
+                                 "ST.LEELANAUSOFTWARE.COM\n\n";
+
+const char CORPUS_7[]  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "MAN: ssdp:discover\r\n"
+                                 "ST: uuid:38323636-4558-4dda-9188-cda0e6aa0000\r\n"
+                                 "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                 "TXN.LEELANAUSOFTWARE.COM: 00000002\r\n"
+                                 "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+const char CORPUS_8[]  PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "MAN: ssdp:discover\r\n"
+                                 "ST: urn:LeelanauSoftware-com:service:Basic:1.0.0\r\n"
+                                 "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                 "TXN.LEELANAUSOFTWARE.COM: 00000003\r\n"
+                                 "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+/**
+ *  A single header line longer than the responder read buffer
+ */
+const char CORPUS_9[]  PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "NT: upnp:rootdevice\r\n"
+                                 "NTS: ssdp:alive\r\n"
+                                 "X-PADDING: " PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100
+                                               PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 PAD_100 "\r\n\r\n";
+
+/**
+ *  Binary payload on port 1900
+ */
+const char CORPUS_10[] PROGMEM = "\x00\x01\x02\x03\x10\x20\x30\x40\xff\xfe\xfd\xfcM-SEARCH";
+
+const char CORPUS_11[] PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "MAN: \"ssdp:discover\"\r\n"
+                                 "MX: 3\r\n"
+                                 "ST: ssdp:all\r\n\r\n";
+
+const char CORPUS_12[] PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                 "HOST: 239.255.255.250:1900\r\n"
+                                 "NT: upnp:rootdevice\r\n"
+                                 "NTS: ssdp:byebye\r\n"
+                                 "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::upnp:rootdevice\r\n\r\n";
+
+const ReplayPacket CORPUS[] = {
+  {0,      {192,168,1,50},  50000, sizeof(CORPUS_0)-1,  CORPUS_0},
+  {12000,  {192,168,1,31},  61234, sizeof(CORPUS_1)-1,  CORPUS_1},
+  {300000, {192,168,1,1},   1900,  sizeof(CORPUS_2)-1,  CORPUS_2},
+  {2000,   {192,168,1,1},   1900,  sizeof(CORPUS_3)-1,  CORPUS_3},
+  {2000,   {192,168,1,1},   1900,  sizeof(CORPUS_4)-1,  CORPUS_4},
+  {2000,   {192,168,1,1},   1900,  sizeof(CORPUS_2)-1,  CORPUS_2},
+  {2000,   {192,168,1,1},   1900,  sizeof(CORPUS_3)-1,  CORPUS_3},
+  {2000,   {192,168,1,1},   1900,  sizeof(CORPUS_4)-1,  CORPUS_4},
+  {45000,  {192,168,1,20},  1900,  sizeof(CORPUS_5)-1,  CORPUS_5},
+  {90000,  {192,168,1,77},  1900,  sizeof(CORPUS_6)-1,  CORPUS_6},
+  {150000, {192,168,1,50},  50000, sizeof(CORPUS_7)-1,  CORPUS_7},
+  {1000,   {192,168,1,50},  50000, sizeof(CORPUS_8)-1,  CORPUS_8},
+  {200000, {192,168,1,1},   1900,  sizeof(CORPUS_9)-1,  CORPUS_9},
+  {5000,   {192,168,1,99},  1900,  sizeof(CORPUS_10)-1, CORPUS_10},
+  {80000,  {192,168,1,31},  61234, sizeof(CORPUS_11)-1, CORPUS_11},
+  {500000, {192,168,1,1},   1900,  sizeof(CORPUS_12)-1, CORPUS_12}
+};
+
+#define CORPUS_SIZE (sizeof(CORPUS)/sizeof(ReplayPacket))
+
+#endif
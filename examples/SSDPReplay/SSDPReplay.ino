@@ -0,0 +1,310 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include <deque>
+#include "Corpus.h"
+#include <LoopbackUDP.h>
+
+/**
+ *   Replay captured UDP/1900 traffic through the responder. Packets come from Corpus.h, or from a corpus file on
+ *   LittleFS if REPLAY_FILE is defined; both are produced from pcap or pcapng captures by extras/pcap_replay.py.
+ *   Each packet is injected into the responder multicast channel (LoopbackUDP) and read by SSDP::doSSDP(), either as
+ *   fast as possible or with the original inter-packet timing.
+ *
+ *   With REPLAY_VERBOSE each packet is reported as a JSON line with its classification, what the responder did with it,
+ *   the cycles spent reading and deciding (readChannel) and answering, and the responses generated:
+ *
+ *     {"pkt":3,"t_us":304000,"len":301,"class":"notify","outcome":"ignored","cycles":5120,"post_cycles":0,"responses":0,"response_bytes":0}
+ *
+ *   The run ends with one line per class, averaged over REPLAY_PASSES passes, in the format of the Benchmarks example,
+ *   so two builds can be compared on the same corpus with extras/bench_compare.py, and a summary line.
+ */
+
+#define REPLAY_FAST     0
+#define REPLAY_TIMED    1
+#define REPLAY_MODE     REPLAY_FAST
+#define REPLAY_VERBOSE  1                  // Report each packet of the first pass
+#define REPLAY_PASSES   1                  // Passes over the corpus, class averages are over all passes
+//#define REPLAY_FILE     "/replay.bin"     // Replay a corpus file from LittleFS in place of Corpus.h
+
+#define REPLAY_READ_SIZE   1536              // Responder read buffer, longer packets are truncated
+#define REPLAY_MAX_GAP     1000000           // Longest gap between packets in timed mode, microseconds
+#define REPLAY_QUEUE_DEPTH 8
+
+#ifdef ESP8266
+#define BOARD "ESP8266"
+#else
+#define BOARD "ESP32"
+#endif
+
+#ifdef REPLAY_FILE
+#include <LittleFS.h>
+#endif
+
+typedef enum {
+  LSC_ROOT = 0,
+  LSC_UUID,
+  LSC_URN,
+  LSC_OTHER,
+  SEARCH_FOREIGN,
+  RESPONSE,
+  NOTIFY,
+  MALFORMED,
+  OVERSIZED,
+  NUM_CLASSES
+} ReplayClass;
+
+const char* const CLASS_NAMES[NUM_CLASSES] = {"lsc_root","lsc_uuid","lsc_urn","lsc_other","search_foreign","response","notify","malformed","oversized"};
+
+typedef struct {
+  uint32_t  packets;
+  uint32_t  answered;
+  uint32_t  dropped;
+  uint32_t  bytes;
+  uint64_t  cycles;
+  uint64_t  postCycles;
+} ClassStats;
+
+typedef struct {
+  int          index;
+  uint32_t     t;
+  int          len;
+  ReplayClass  cls;
+} Pending;
+
+RootDevice          root;
+UPnPDevice          devices[2];
+UPnPService         services[2];
+SSDP                ssdp;
+LoopbackUDP         multicast(REPLAY_QUEUE_DEPTH);
+LoopbackUDP         unicast(1);
+
+ClassStats          stats[NUM_CLASSES];
+std::deque<Pending> pending;
+uint32_t            responses     = 0;
+uint32_t            responseBytes = 0;
+uint32_t            totalResponses = 0;
+uint32_t            totalResponseBytes = 0;
+int                 pass = 0;
+char                payload[LOOPBACK_PACKET_SIZE];
+
+void buildHierarchy() {
+  root.setUUID("38323636-4558-4dda-9188-cda0e6aa0000");
+  for( int i=0; i<2; i++ ) {
+    char target[16];
+    char uuid[UUID_SIZE];
+    snprintf(target,16,"device%d",i);
+    snprintf(uuid,UUID_SIZE,"38323636-4558-4dda-9188-cda0e6aa%04x",i+1);
+    devices[i].setTarget(target);
+    devices[i].setUUID(uuid);
+    devices[i].addService(&services[i]);
+    root.addDevice(&devices[i]);
+  }
+}
+
+/**
+ *   Classify a packet the way the responder sees it: the first REPLAY_READ_SIZE bytes as a null terminated string
+ */
+ReplayClass classify(const char* data, int len) {
+  static char buffer[REPLAY_READ_SIZE + 1];
+  if( len > REPLAY_READ_SIZE ) return OVERSIZED;
+  if( memchr(data,0,len) != NULL ) return MALFORMED;
+  memcpy(buffer,data,len);
+  buffer[len] = '\0';
+  UPnPBuffer b(buffer);
+  if( b.isSearchRequest() ) {
+    char lsc[64];
+    char st[100];
+    if( !b.headerValue("ST.LEELANAUSOFTWARE.COM",lsc,64) ) return SEARCH_FOREIGN;
+    if( !b.headerValue("ST",st,100) ) return MALFORMED;
+    if( strncmp(st,"upnp:rootdevice",15) == 0 ) return LSC_ROOT;
+    if( strncmp(st,"uuid:",5) == 0 ) return LSC_UUID;
+    if( strncmp(st,"urn:",4) == 0 ) return LSC_URN;
+    return LSC_OTHER;
+  }
+  if( b.isSearchResponse() ) return RESPONSE;
+  if( strncmp(buffer,"NOTIFY * ",9) == 0 ) return NOTIFY;
+  return MALFORMED;
+}
+
+void report(const Pending& p, const char* outcome, uint32_t cycles, uint32_t postCycles) {
+#if REPLAY_VERBOSE
+  if( pass == 0 ) Serial.printf("{\"pkt\":%d,\"t_us\":%u,\"len\":%d,\"class\":\"%s\",\"outcome\":\"%s\",\"cycles\":%u,\"post_cycles\":%u,\"responses\":%u,\"response_bytes\":%u}\n",
+                p.index,p.t,p.len,CLASS_NAMES[p.cls],outcome,cycles,postCycles,responses,responseBytes);
+#endif
+}
+
+/**
+ *   Run the responder once. doSSDP() reads at most one packet from the multicast channel, so a change in the packet
+ *   count belongs to the oldest pending packet.
+ */
+void service() {
+  SSDPTimings before = ssdp.timings();
+  responses     = 0;
+  responseBytes = 0;
+  ssdp.doSSDP();
+  const SSDPTimings& after = ssdp.timings();
+  if( (after.packets > before.packets) && !pending.empty() ) {
+    Pending p = pending.front();
+    pending.pop_front();
+    uint32_t cycles     = (uint32_t)(after.readCycles - before.readCycles);
+    uint32_t postCycles = (uint32_t)(after.postCycles - before.postCycles);
+    ClassStats& s = stats[p.cls];
+    s.packets++;
+    s.bytes      += p.len;
+    s.cycles     += cycles;
+    s.postCycles += postCycles;
+    if( responses > 0 ) s.answered++;
+    totalResponses     += responses;
+    totalResponseBytes += responseBytes;
+    report(p,((responses > 0)?("answered"):("ignored")),cycles,postCycles);
+  }
+}
+
+/**
+ *   Offer packet index at time t (microseconds from the start of the capture)
+ */
+void offer(int index, uint32_t t, const char* data, int len, IPAddress src, uint16_t port) {
+  Pending p = {index,t,len,classify(data,len)};
+  if( multicast.inject(data,len,src,port,t) ) pending.push_back(p);
+  else {
+    stats[p.cls].dropped++;
+    responses = responseBytes = 0;
+    report(p,"dropped",0,0);
+  }
+#if REPLAY_MODE == REPLAY_FAST
+  while( multicast.queued() > 0 ) {service();}
+#endif
+}
+
+/**
+ *   In timed mode, keep the responder running until time t of the capture
+ */
+uint32_t replayStart = 0;
+uint32_t replayClock = 0;
+
+void waitUntil(uint32_t delta) {
+#if REPLAY_MODE == REPLAY_TIMED
+  replayClock += ((delta < REPLAY_MAX_GAP)?(delta):(REPLAY_MAX_GAP));
+  while( (int32_t)(micros() - (replayStart + replayClock)) < 0 ) {
+    service();
+    yield();
+  }
+#endif
+}
+
+/**
+ *   Replay the corpus. Returns the number of packets offered.
+ */
+int replay() {
+  int      count = 0;
+  uint32_t t     = 0;
+#ifdef REPLAY_FILE
+  File f = LittleFS.open(REPLAY_FILE,"r");
+  uint8_t header[8];
+  if( !f || (f.read(header,8) != 8) || (memcmp(header,"LSCR",4) != 0) || (header[4] != 1) ) {
+    Serial.printf("{\"error\":\"%s is not a replay corpus\"}\n",REPLAY_FILE);
+    return 0;
+  }
+  uint8_t rec[12];
+  while( f.read(rec,12) == 12 ) {
+    uint32_t delta = rec[0] | (rec[1] << 8) | (rec[2] << 16) | ((uint32_t)rec[3] << 24);
+    uint16_t port  = rec[8] | (rec[9] << 8);
+    uint16_t len   = rec[10] | (rec[11] << 8);
+    int n = ((len < LOOPBACK_PACKET_SIZE)?(len):(LOOPBACK_PACKET_SIZE));
+    if( (int)f.read((uint8_t*)payload,n) != n ) break;
+    if( len > n ) f.seek(f.position() + (len - n));
+    t += delta;
+    waitUntil(delta);
+    offer(count++,t,payload,len,IPAddress(rec[4],rec[5],rec[6],rec[7]),port);
+    yield();
+  }
+  f.close();
+#else
+  for( unsigned i=0; i<CORPUS_SIZE; i++ ) {
+    const ReplayPacket& p = CORPUS[i];
+    memcpy_P(payload,p.data,((p.len < LOOPBACK_PACKET_SIZE)?(p.len):(LOOPBACK_PACKET_SIZE)));
+    t += p.delta;
+    waitUntil(p.delta);
+    offer(count++,t,payload,p.len,IPAddress(p.src[0],p.src[1],p.src[2],p.src[3]),p.port);
+    yield();
+  }
+#endif
+  while( multicast.queued() > 0 ) {service();}
+  return count;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+  delay(1000);
+  Serial.println();
+
+  buildHierarchy();
+  unicast.onSend([](const char* packet, int len) {responses++; responseBytes += len;});
+#if REPLAY_MODE == REPLAY_FAST
+  ssdp.setResponseDelay(0);
+#endif
+  ssdp.begin(&root,&multicast,&unicast,IPAddress(192,168,1,17),IPAddress(255,255,255,0));
+
+#ifdef REPLAY_FILE
+  const char* corpus = REPLAY_FILE;
+  if( !LittleFS.begin() ) {
+    Serial.printf("{\"error\":\"LittleFS mount failed\"}\n");
+    return;
+  }
+#else
+  const char* corpus = CORPUS_NAME;
+#endif
+
+  Serial.printf("{\"run\":\"UPnPLib\",\"board\":\"%s\",\"cpu_mhz\":%u,\"sdk\":\"%s\",\"corpus\":\"%s\"}\n",BOARD,(unsigned)ESP.getCpuFreqMHz(),ESP.getSdkVersion(),corpus);
+  uint32_t start = micros();
+  int count = 0;
+  for( pass=0; pass<REPLAY_PASSES; pass++ ) {
+    replayStart = micros();
+    replayClock = 0;
+    count += replay();
+  }
+  uint32_t elapsed = micros() - start;
+
+  uint32_t mhz      = ESP.getCpuFreqMHz();
+  uint32_t answered = 0;
+  uint32_t dropped  = 0;
+  for( int c=0; c<NUM_CLASSES; c++ ) {
+    ClassStats& s = stats[c];
+    answered += s.answered;
+    dropped  += s.dropped;
+    if( s.packets == 0 ) continue;
+    uint32_t cycles = (uint32_t)(s.cycles/s.packets);
+    Serial.printf("{\"suite\":\"replay\",\"bench\":\"%s/%s\",\"iters\":%u,\"cycles\":%u,\"ns\":%u,\"bytes\":%u,\"answered\":%u,\"dropped\":%u,\"post_cycles\":%u}\n",
+                  corpus,CLASS_NAMES[c],s.packets,cycles,(unsigned)((uint64_t)cycles*1000/mhz),s.bytes/s.packets,s.answered,s.dropped,
+                  (unsigned)(s.postCycles/s.packets));
+  }
+  Serial.printf("{\"replay\":\"%s\",\"mode\":\"%s\",\"packets\":%d,\"dropped\":%u,\"answered\":%u,\"responses\":%u,\"response_bytes\":%u,\"elapsed_ms\":%u}\n",
+                corpus,((REPLAY_MODE == REPLAY_FAST)?("fast"):("timed")),count,dropped,answered,totalResponses,totalResponseBytes,elapsed/1000);
+}
+
+void loop() {
+}
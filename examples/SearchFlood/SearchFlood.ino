@@ -0,0 +1,286 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include <UPnPLib.h>
+#include "Traffic.h"
+#include <LoopbackUDP.h>
+#include <algorithm>
+
+/**
+ *   Responder throughput under a flood of search traffic. Two modes:
+ *
+ *   FLOOD_LOOPBACK (default) runs the responder on in-memory channels with no network. An open loop generator offers
+ *   each traffic mix (see Traffic.h) at increasing rates, and for each step the sketch writes one JSON line:
+ *
+ *     {"mode":"loopback","mix":"lsc","pacing_ms":0,"offered_pps":200,"injected":400,"dropped":0,"handled":400,
+ *      "throughput_pps":199.6,"responses":480,"p50_us":310,"p90_us":420,"p99_us":880,"max_us":1020,
+ *      "read_us":95,"send_us":160,"paced_ms":0,"max_stall_us":1150}
+ *
+ *   Latency is from the scheduled arrival of a request to its first response, so time spent queued behind a busy
+ *   responder is counted. read_us is CPU time per packet in readChannel, send_us CPU time per response excluding
+ *   pacing, paced_ms total time spent in response pacing and max_stall_us the longest doSSDP() call, which is the
+ *   longest time an HTTP request would have waited. Each mix is run with the library default pacing and without.
+ *
+ *   FLOOD_WIFI runs a normal responder and web server on WiFi and writes responder statistics once a second, for
+ *   load offered over real UDP by extras/ssdp_flood.py.
+ */
+
+#define FLOOD_LOOPBACK  0
+#define FLOOD_WIFI      1
+#define FLOOD_MODE      FLOOD_LOOPBACK
+
+#define AP_SSID "MySSID"
+#define AP_PSK  "MyPSK"
+#define SERVER_PORT 80
+
+#ifdef ESP8266
+#include <ESP8266WiFi.h>
+#elif defined(ESP32)
+#include <WiFi.h>
+#endif
+
+#define FLOOD_STEP_MS      2000              // Duration of each rate step
+#define FLOOD_DRAIN_MS     10000             // Longest time to wait for the queue to empty after a step
+#define FLOOD_QUEUE_DEPTH  8                 // Receive queue depth, as the default lwIP UDP receive mailbox
+#define FLOOD_SAMPLES      2048              // Latency samples kept per step
+#define FLOOD_PACKET_SIZE  512
+
+const int           RATES[]  = {20, 50, 100, 200, 500, 1000, 2000, 5000};
+const unsigned long PACING[] = {500, 0};
+const char          MISS_UUID[] = "00000000-0000-4000-8000-000000000000";
+const IPAddress     REQUESTER(192,168,1,50);
+const uint16_t      REQUESTER_PORT = 50000;
+
+RootDevice         root;
+UPnPDevice         devices[2];
+UPnPService        services[2];
+SSDP               ssdp;
+WebContext         ctx;
+
+LoopbackUDP        multicast(FLOOD_QUEUE_DEPTH);
+LoopbackUDP        unicast(1);
+
+uint32_t           latencies[FLOOD_SAMPLES];
+int                numLatencies = 0;
+uint32_t           responses    = 0;
+uint32_t           lastAnswered = 0;
+uint64_t           waitCycles   = 0;
+uint32_t           seed         = 1;
+
+void buildHierarchy() {
+  root.setUUID("38323636-4558-4dda-9188-cda0e6aa0000");
+  for( int i=0; i<2; i++ ) {
+    char target[16];
+    char uuid[UUID_SIZE];
+    snprintf(target,16,"device%d",i);
+    snprintf(uuid,UUID_SIZE,"38323636-4558-4dda-9188-cda0e6aa%04x",i+1);
+    devices[i].setTarget(target);
+    devices[i].setUUID(uuid);
+    devices[i].addService(&services[i]);
+    root.addDevice(&devices[i]);
+  }
+}
+
+/**
+ *   xorshift32, so each run offers the same sequence of packets
+ */
+uint32_t nextRandom() {
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  return seed;
+}
+
+TrafficKind pick(const TrafficMix& mix) {
+  int total = 0;
+  for( int i=0; i<NUM_TRAFFIC; i++ ) {total += mix.weights[i];}
+  int r = nextRandom() % total;
+  for( int i=0; i<NUM_TRAFFIC; i++ ) {
+    if( r < mix.weights[i] ) return (TrafficKind)i;
+    r -= mix.weights[i];
+  }
+  return LSC_ROOT;
+}
+
+int render(char buffer[], int size, TrafficKind kind, uint32_t txn) {
+  char st[64];
+  switch( kind ) {
+    case LSC_ROOT:       strlcpy(st,"upnp:rootdevice",64); break;
+    case LSC_UUID_HIT:   snprintf(st,64,"uuid:%s",root.uuid()); break;
+    case LSC_UUID_MISS:  snprintf(st,64,"uuid:%s",MISS_UUID); break;
+    case LSC_URN:        strlcpy(st,UPnPService::upnpType(),64); break;
+    case FOREIGN_DIAL:   strncpy_P(buffer,DIAL_SEARCH,size); buffer[size-1] = '\0'; return strlen(buffer);
+    case FOREIGN_ALL:    strncpy_P(buffer,ALL_SEARCH,size);  buffer[size-1] = '\0'; return strlen(buffer);
+    default:             strncpy_P(buffer,IGD_NOTIFY,size);  buffer[size-1] = '\0'; return strlen(buffer);
+  }
+  return snprintf_P(buffer,size,LSC_SEARCH,st,txn);
+}
+
+void runStep(const TrafficMix& mix, int rate, unsigned long pacing) {
+  char     packet[FLOOD_PACKET_SIZE];
+  uint32_t injected   = 0;
+  uint32_t dropped    = 0;
+  uint32_t maxStall   = 0;
+  uint32_t interval   = 1000000/rate;
+
+  ssdp.setResponseDelay(pacing);
+  ssdp.resetTimings();
+  multicast.clear();
+  numLatencies = 0;
+  responses    = 0;
+  waitCycles   = 0;
+
+  uint32_t start = micros();
+  uint32_t end   = start + FLOOD_STEP_MS*1000UL;
+  uint32_t next  = start;
+  while( ((int32_t)(micros() - end) < 0) || ((multicast.queued() > 0) && ((int32_t)(micros() - end) < FLOOD_DRAIN_MS*1000L)) ) {
+
+/**
+ *  Offer every packet due by now, stamped with its scheduled time so that time queued behind a busy responder counts
+ */
+    uint32_t now = micros();
+    while( ((int32_t)(now - next) >= 0) && ((int32_t)(next - end) < 0) ) {
+      int len = render(packet,FLOOD_PACKET_SIZE,pick(mix),injected);
+      if( !multicast.inject(packet,len,REQUESTER,REQUESTER_PORT,next) ) dropped++;
+      injected++;
+      next += interval;
+    }
+
+    uint32_t t = micros();
+    ssdp.doSSDP();
+    t = micros() - t;
+    if( t > maxStall ) maxStall = t;
+    yield();
+  }
+  uint32_t elapsed = micros() - start;
+
+  const SSDPTimings& timings = ssdp.timings();
+  uint32_t mhz      = ESP.getCpuFreqMHz();
+  uint64_t send     = ((timings.postCycles > waitCycles)?(timings.postCycles - waitCycles):(0));
+  std::sort(latencies,latencies+numLatencies);
+  uint32_t p50 = ((numLatencies>0)?(latencies[numLatencies*50/100]):(0));
+  uint32_t p90 = ((numLatencies>0)?(latencies[numLatencies*90/100]):(0));
+  uint32_t p99 = ((numLatencies>0)?(latencies[numLatencies*99/100]):(0));
+  uint32_t max = ((numLatencies>0)?(latencies[numLatencies-1]):(0));
+
+  Serial.printf("{\"mode\":\"loopback\",\"mix\":\"%s\",\"pacing_ms\":%lu,\"offered_pps\":%d,\"injected\":%u,\"dropped\":%u,\"handled\":%u,"
+                "\"throughput_pps\":%.1f,\"responses\":%u,\"p50_us\":%u,\"p90_us\":%u,\"p99_us\":%u,\"max_us\":%u,"
+                "\"read_us\":%u,\"send_us\":%u,\"paced_ms\":%u,\"max_stall_us\":%u}\n",
+                mix.name,pacing,rate,injected,dropped,timings.packets,
+                (float)timings.packets*1000000.0/elapsed,responses,p50,p90,p99,max,
+                (unsigned)((timings.packets>0)?(timings.readCycles/timings.packets/mhz):(0)),
+                (unsigned)((responses>0)?(send/responses/mhz):(0)),
+                (unsigned)(waitCycles/mhz/1000),maxStall);
+}
+
+void runLoopback() {
+  unicast.onSend([](const char* packet, int len) {
+    responses++;
+    uint32_t stamp = multicast.stamp();
+    if( (stamp != lastAnswered) && (numLatencies < FLOOD_SAMPLES) ) latencies[numLatencies++] = micros() - stamp;
+    lastAnswered = stamp;
+  });
+
+/**
+ *  Time spent pacing responses is measured so it can be separated from the CPU cost of sending
+ */
+  SSDPClock clock;
+  clock.now  = []{return millis();};
+  clock.wait = [](unsigned long ms){uint32_t t = ESP.getCycleCount(); delay(ms); waitCycles += ESP.getCycleCount() - t;};
+  ssdp.setClock(clock);
+  ssdp.begin(&root,&multicast,&unicast,IPAddress(192,168,1,17),IPAddress(255,255,255,0));
+
+  for( size_t p=0; p<sizeof(PACING)/sizeof(unsigned long); p++ ) {
+    for( size_t m=0; m<NUM_MIXES; m++ ) {
+      for( size_t r=0; r<sizeof(RATES)/sizeof(int); r++ ) {runStep(MIXES[m],RATES[r],PACING[p]);}
+    }
+  }
+  Serial.printf("{\"done\":true}\n");
+}
+
+/**
+ *   WiFi mode statistics, written once a second
+ */
+unsigned long lastReport = 0;
+uint32_t      maxStall   = 0;
+uint32_t      maxHttp    = 0;
+
+void report() {
+  const SSDPTimings& timings = ssdp.timings();
+  uint32_t mhz = ESP.getCpuFreqMHz();
+  Serial.printf("{\"mode\":\"wifi\",\"t_ms\":%lu,\"packets\":%u,\"replies\":%u,\"read_us\":%u,\"post_us\":%u,\"max_stall_us\":%u,\"max_http_us\":%u,\"free_heap\":%u}\n",
+                millis(),timings.packets,timings.replies,
+                (unsigned)((timings.packets>0)?(timings.readCycles/timings.packets/mhz):(0)),
+                (unsigned)((timings.replies>0)?(timings.postCycles/timings.replies/mhz):(0)),
+                maxStall,maxHttp,(unsigned)ESP.getFreeHeap());
+  const SSDPMetrics& m = ssdp.metrics();
+  Serial.printf("{\"mode\":\"wifi\",\"t_ms\":%lu,\"received\":%u,\"lsc\":%u,\"foreign\":%u,\"matched\":%u,\"sent\":%u,\"failed\":%u,"
+                "\"parse_p99_us\":%u,\"match_p99_us\":%u,\"render_p99_us\":%u,\"send_p99_us\":%u}\n",
+                millis(),m.received,m.lscSearches,m.otherSearches + m.other,m.matched,m.sent,m.failed,
+                m.parse.percentile(99),m.match.percentile(99),m.render.percentile(99),m.send.percentile(99));
+  ssdp.resetTimings();
+  ssdp.resetMetrics();
+  maxStall = 0;
+  maxHttp  = 0;
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial) {
+    ; // wait for serial port to connect. Needed for native USB port only
+  }
+  delay(1000);
+  Serial.println();
+
+  buildHierarchy();
+#if FLOOD_MODE == FLOOD_LOOPBACK
+  runLoopback();
+#else
+  WiFi.begin(AP_SSID,AP_PSK);
+  Serial.printf("Connecting to Access Point %s\n",AP_SSID);
+  while(WiFi.status() != WL_CONNECTED) {Serial.print(".");delay(500);}
+  Serial.printf("\nWiFi Connected to %s with IP address: %s\n",WiFi.SSID().c_str(),WiFi.localIP().toString().c_str());
+
+  ctx.begin(SERVER_PORT);
+  root.setDisplayName("Flood Target");
+  root.setTarget("root");
+  root.setup(&ctx);
+  ssdp.begin(&root);
+#endif
+}
+
+void loop() {
+#if FLOOD_MODE == FLOOD_WIFI
+  uint32_t t = micros();
+  ctx.handleClient();
+  uint32_t http = micros() - t;
+  ssdp.doSSDP();
+  uint32_t stall = micros() - t - http;
+  if( http > maxHttp ) maxHttp = http;
+  if( stall > maxStall ) maxStall = stall;
+  root.doDevice();
+  if( millis() - lastReport >= 1000 ) {
+    lastReport = millis();
+    report();
+  }
+#endif
+}
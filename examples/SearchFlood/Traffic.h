@@ -0,0 +1,92 @@
+/**
+ *
+ *  UPnPLib Library
+ *  Copyright (C) 2024  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ *  Traffic for the flood generator. LSC searches are rendered from a single template with the search target and a
+ *  transaction; third party packets are sent as is. A mix gives the relative weight of each kind of packet.
+ */
+
+#ifndef TRAFFIC_H
+#define TRAFFIC_H
+
+#include <Arduino.h>
+
+typedef enum {
+  LSC_ROOT = 0,           // upnp:rootdevice, one response
+  LSC_UUID_HIT,           // uuid: of the responder RootDevice, one response
+  LSC_UUID_MISS,          // uuid: not in the hierarchy, no response
+  LSC_URN,                // urn: service type, one response per service
+  FOREIGN_DIAL,           // Third party M-SEARCH, ignored
+  FOREIGN_ALL,            // Third party ssdp:all M-SEARCH, ignored
+  FOREIGN_NOTIFY,         // Third party NOTIFY, ignored
+  NUM_TRAFFIC
+} TrafficKind;
+
+const char* const TRAFFIC_NAMES[NUM_TRAFFIC] = {"lsc_root","lsc_uuid_hit","lsc_uuid_miss","lsc_urn","dial","ssdp_all","notify"};
+
+const char LSC_SEARCH[]       PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: ssdp:discover\r\n"
+                                        "ST: %s\r\n"
+                                        "ST.LEELANAUSOFTWARE.COM: \r\n"
+                                        "TXN.LEELANAUSOFTWARE.COM: %08x\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+
+const char DIAL_SEARCH[]      PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: \"ssdp:discover\"\r\n"
+                                        "MX: 1\r\n"
+                                        "ST: urn:dial-multiscreen-org:service:dial:1\r\n"
+                                        "USER-AGENT: Google Chrome/120.0.6099.130 Windows\r\n\r\n";
+
+const char ALL_SEARCH[]       PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "MAN: \"ssdp:discover\"\r\n"
+                                        "MX: 3\r\n"
+                                        "ST: ssdp:all\r\n\r\n";
+
+const char IGD_NOTIFY[]       PROGMEM = "NOTIFY * HTTP/1.1\r\n"
+                                        "HOST: 239.255.255.250:1900\r\n"
+                                        "CACHE-CONTROL: max-age=1800\r\n"
+                                        "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+                                        "NT: urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n"
+                                        "NTS: ssdp:alive\r\n"
+                                        "SERVER: Linux/4.1.52, UPnP/1.0, Portable SDK for UPnP devices/1.6.22\r\n"
+                                        "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n\r\n";
+
+/**
+ *  Relative weights of each TrafficKind, in TrafficKind order
+ */
+typedef struct {
+  const char* name;
+  int         weights[NUM_TRAFFIC];
+} TrafficMix;
+
+const TrafficMix MIXES[] = {
+  {"lsc",     {50, 20, 10, 20,  0,  0,  0}},
+  {"mixed",   {20, 10,  5,  5, 20, 10, 30}},
+  {"foreign", { 0,  0,  0,  0, 40, 20, 40}}
+};
+
+#define NUM_MIXES (sizeof(MIXES)/sizeof(TrafficMix))
+
+#endif
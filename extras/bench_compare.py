@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+#
+#  UPnPLib Library
+#  Copyright (C) 2024  Daniel L Toth
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published
+#  by the Free Software Foundation, either version 3 of the License, or any
+#  later version.
+#
+#  The author can be contacted at dan@leelanausoftware.com
+#
+
+"""Compare two runs of the Benchmarks example.
+
+Each run is the Serial output of examples/Benchmarks captured to a file. Lines
+that are not JSON objects (boot messages and the like) are ignored. Benchmarks
+are matched by suite and name, and any whose cycles per operation changed by
+more than the threshold are flagged. The exit status is 1 if any benchmark
+regressed, so the script can gate a change.
+
+    python3 bench_compare.py before.jsonl after.jsonl [--threshold 5]
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    run = {}
+    results = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                obj = json.loads(line)
+            except ValueError:
+                continue
+            if "run" in obj:
+                run = obj
+            elif "bench" in obj:
+                results[(obj["suite"], obj["bench"])] = obj
+    return run, results
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("before")
+    parser.add_argument("after")
+    parser.add_argument("--threshold", type=float, default=5.0, help="percent change in cycles to flag (default 5)")
+    args = parser.parse_args()
+
+    run0, before = load(args.before)
+    run1, after = load(args.after)
+    if run0.get("board") != run1.get("board") or run0.get("cpu_mhz") != run1.get("cpu_mhz"):
+        print("warning: runs are from different boards or clock rates: %s vs %s" % (run0, run1), file=sys.stderr)
+
+    regressed = 0
+    print("%-8s %-36s %10s %10s %8s" % ("suite", "bench", "before", "after", "change"))
+    for key in sorted(set(before) | set(after)):
+        b = before.get(key)
+        a = after.get(key)
+        if b is None or a is None:
+            print("%-8s %-36s %10s %10s %8s" % (key[0], key[1], b and b["cycles"] or "-", a and a["cycles"] or "-", "n/a"))
+            continue
+        change = 100.0 * (a["cycles"] - b["cycles"]) / max(b["cycles"], 1)
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressed += 1
+        elif change < -args.threshold:
+            flag = "  improved"
+        print("%-8s %-36s %10d %10d %7.1f%%%s" % (key[0], key[1], b["cycles"], a["cycles"], change, flag))
+
+    if regressed:
+        print("%d benchmark(s) regressed by more than %.1f%%" % (regressed, args.threshold))
+    return 1 if regressed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,345 @@
+#!/usr/bin/env python3
+#
+#  UPnPLib Library
+#  Copyright (C) 2024  Daniel L Toth
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published
+#  by the Free Software Foundation, either version 3 of the License, or any
+#  later version.
+#
+#  The author can be contacted at dan@leelanausoftware.com
+#
+
+"""Extract SSDP traffic from a pcap or pcapng capture for the SSDPReplay example.
+
+Every UDP payload to or from port 1900 (IPv4 and IPv6, Ethernet, 802.1Q,
+Linux cooked, raw IP and BSD loopback link types) is kept with its timing and
+source address. The result can be written as a corpus file to load onto the
+device file system, as a Corpus.h header to build into the sketch, or both, and
+a summary of the traffic by class is printed:
+
+    python3 pcap_replay.py capture.pcapng --out replay.bin
+    python3 pcap_replay.py capture.pcap --header examples/SSDPReplay/Corpus.h --limit 200
+
+Corpus file format (little endian):
+
+    Offset  Size  File header
+      0       4   Magic "LSCR"
+      4       1   Version (1)
+      5       3   Reserved
+    Offset  Size  Record, repeated to end of file
+      0       4   Microseconds since the previous packet
+      4       4   Source IPv4 address, network order (0 for IPv6)
+      8       2   Source port
+     10       2   Payload length
+     12       n   Payload
+"""
+
+import argparse
+import struct
+import sys
+
+SSDP_PORT = 1900
+PCAP_MAGIC = {b"\xd4\xc3\xb2\xa1": ("<", 1e-6), b"\xa1\xb2\xc3\xd4": (">", 1e-6),
+              b"\x4d\x3c\xb2\xa1": ("<", 1e-9), b"\xa1\xb2\x3c\x4d": (">", 1e-9)}
+PCAPNG_SHB = 0x0A0D0D0A
+
+LINKTYPE_NULL = 0
+LINKTYPE_ETHERNET = 1
+LINKTYPE_RAW = 101
+LINKTYPE_LINUX_SLL = 113
+LINKTYPE_IPV4 = 228
+LINKTYPE_IPV6 = 229
+LINKTYPE_LINUX_SLL2 = 276
+
+
+class Packet:
+    def __init__(self, time, src, port, payload):
+        self.time = time
+        self.src = src
+        self.port = port
+        self.payload = payload
+
+
+def read_pcap(data):
+    """Yield (linktype, time, frame) from a classic pcap file"""
+    order, resolution = PCAP_MAGIC[data[:4]]
+    linktype = struct.unpack(order + "I", data[20:24])[0] & 0x0FFFFFFF
+    pos = 24
+    while pos + 16 <= len(data):
+        sec, frac, incl, _ = struct.unpack(order + "IIII", data[pos:pos + 16])
+        pos += 16
+        yield linktype, sec + frac * resolution, data[pos:pos + incl]
+        pos += incl
+
+
+def read_pcapng(data):
+    """Yield (linktype, time, frame) from a pcapng file"""
+    order = "<"
+    interfaces = []
+    pos = 0
+    while pos + 12 <= len(data):
+        btype = struct.unpack(order + "I", data[pos:pos + 4])[0]
+        if btype == PCAPNG_SHB:
+            order = "<" if data[pos + 8:pos + 12] == b"\x4d\x3c\x2b\x1a" else ">"
+            interfaces = []
+        blen = struct.unpack(order + "I", data[pos + 4:pos + 8])[0]
+        if blen < 12:
+            break
+        body = data[pos + 8:pos + blen - 4]
+        if btype == 1:                                    # Interface Description Block
+            linktype = struct.unpack(order + "H", body[0:2])[0]
+            resolution = 1e-6
+            opt = 8
+            while opt + 4 <= len(body):
+                code, olen = struct.unpack(order + "HH", body[opt:opt + 4])
+                if code == 0:
+                    break
+                if code == 9 and olen >= 1:               # if_tsresol
+                    v = body[opt + 4]
+                    resolution = 2.0 ** -(v & 0x7F) if v & 0x80 else 10.0 ** -v
+                opt += 4 + ((olen + 3) & ~3)
+            interfaces.append((linktype, resolution))
+        elif btype == 6:                                  # Enhanced Packet Block
+            ifc, hi, lo, incl = struct.unpack(order + "IIII", body[0:16])
+            if ifc < len(interfaces):
+                linktype, resolution = interfaces[ifc]
+                yield linktype, ((hi << 32) | lo) * resolution, body[20:20 + incl]
+        elif btype == 3 and interfaces:                   # Simple Packet Block, no time stamp
+            linktype, _ = interfaces[0]
+            yield linktype, None, body[4:]
+        pos += blen
+
+
+def ip_payload(linktype, frame):
+    """Return (ethertype, ip packet) for a link layer frame, or None"""
+    if linktype == LINKTYPE_ETHERNET:
+        if len(frame) < 14:
+            return None
+        etype = struct.unpack(">H", frame[12:14])[0]
+        pos = 14
+        while etype in (0x8100, 0x88A8) and len(frame) >= pos + 4:
+            etype = struct.unpack(">H", frame[pos + 2:pos + 4])[0]
+            pos += 4
+        return etype, frame[pos:]
+    if linktype == LINKTYPE_LINUX_SLL:
+        return struct.unpack(">H", frame[14:16])[0], frame[16:]
+    if linktype == LINKTYPE_LINUX_SLL2:
+        return struct.unpack(">H", frame[0:2])[0], frame[20:]
+    if linktype == LINKTYPE_NULL:
+        family = struct.unpack("<I", frame[0:4])[0]
+        if family not in (2, 0x02000000):
+            return 0x86DD, frame[4:]
+        return 0x0800, frame[4:]
+    if linktype in (LINKTYPE_RAW, LINKTYPE_IPV4, LINKTYPE_IPV6):
+        if not frame:
+            return None
+        return (0x0800 if frame[0] >> 4 == 4 else 0x86DD), frame
+    return None
+
+
+def udp_payload(etype, ip, stats):
+    """Return (src address bytes, src port, dst port, payload) for a UDP packet, or None"""
+    if etype == 0x0800 and len(ip) >= 20:
+        ihl = (ip[0] & 0x0F) * 4
+        if ip[9] != 17:
+            return None
+        flags = struct.unpack(">H", ip[6:8])[0]
+        if flags & 0x1FFF:
+            stats["fragments"] = stats.get("fragments", 0) + 1
+            return None
+        src = ip[12:16]
+        udp = ip[ihl:]
+    elif etype == 0x86DD and len(ip) >= 40:
+        if ip[6] != 17:
+            return None
+        src = b"\0\0\0\0"
+        udp = ip[40:]
+    else:
+        return None
+    if len(udp) < 8:
+        return None
+    sport, dport, ulen = struct.unpack(">HHH", udp[0:6])
+    return src, sport, dport, udp[8:max(8, min(ulen, len(udp)))]
+
+
+def extract(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data[:4] in PCAP_MAGIC:
+        frames = read_pcap(data)
+    elif struct.unpack("<I", data[:4])[0] == PCAPNG_SHB:
+        frames = read_pcapng(data)
+    else:
+        sys.exit("%s is not a pcap or pcapng file" % path)
+
+    stats = {}
+    packets = []
+    for linktype, time, frame in frames:
+        l3 = ip_payload(linktype, frame)
+        if l3 is None:
+            continue
+        udp = udp_payload(l3[0], l3[1], stats)
+        if udp is None:
+            continue
+        src, sport, dport, payload = udp
+        if SSDP_PORT not in (sport, dport):
+            continue
+        packets.append(Packet(time, src, sport, payload))
+    return packets, stats
+
+
+def classify(payload):
+    """Same classes as the SSDPReplay sketch"""
+    if len(payload) > 1536:
+        return "oversized"
+    if b"\0" in payload:
+        return "malformed"
+    text = payload.lstrip(b" ")
+    if text.startswith(b"M-SEARCH"):
+        headers = {}
+        for line in text.split(b"\r\n")[1:]:
+            name, sep, value = line.partition(b":")
+            if sep:
+                headers.setdefault(name.strip().upper(), value.strip())
+        if b"ST.LEELANAUSOFTWARE.COM" not in headers:
+            return "search_foreign"
+        st = headers.get(b"ST", b"")
+        if st.startswith(b"upnp:rootdevice"):
+            return "lsc_root"
+        if st.startswith(b"uuid:"):
+            return "lsc_uuid"
+        if st.startswith(b"urn:"):
+            return "lsc_urn"
+        return "lsc_other" if st else "malformed"
+    if text.startswith(b"HTTP/1.1"):
+        return "response"
+    if text.startswith(b"NOTIFY * "):
+        return "notify"
+    return "malformed"
+
+
+def deltas(packets, max_gap):
+    result = []
+    last = None
+    for p in packets:
+        if p.time is None or last is None:
+            d = 0
+        else:
+            d = int(round((p.time - last) * 1e6))
+            d = max(0, min(d, max_gap)) if max_gap else max(0, d)
+        if p.time is not None:
+            last = p.time
+        result.append(min(d, 0xFFFFFFFF))
+    return result
+
+
+def write_corpus(path, packets, delta):
+    with open(path, "wb") as f:
+        f.write(b"LSCR" + bytes([1, 0, 0, 0]))
+        for p, d in zip(packets, delta):
+            payload = p.payload[:0xFFFF]
+            f.write(struct.pack("<I4sHH", d, p.src, p.port, len(payload)))
+            f.write(payload)
+
+
+def c_string(payload):
+    out = []
+    line = ""
+    prev_hex = False
+    for b in payload:
+        c = chr(b)
+        if c == "\\" or c == '"':
+            s = "\\" + c
+        elif c == "\r":
+            s = "\\r"
+        elif c == "\n":
+            s = "\\n"
+        elif 32 <= b < 127 and not (prev_hex and c in "0123456789abcdefABCDEF"):
+            s = c
+        elif 32 <= b < 127:
+            s = '""' + c                                  # Close the literal so a hex escape does not swallow c
+        else:
+            s = "\\x%02x" % b
+        prev_hex = s.startswith("\\x")
+        line += s
+        if c == "\n" or len(line) > 100:
+            out.append(line)
+            line = ""
+    if line or not out:
+        out.append(line)
+    return "\n".join('                                 "%s"' % l for l in out).lstrip()
+
+
+def write_header(path, name, packets, delta):
+    lines = ["/**",
+             " *  Replay corpus generated by extras/pcap_replay.py from %s, %d packets" % (name, len(packets)),
+             " */",
+             "",
+             "#ifndef CORPUS_H",
+             "#define CORPUS_H",
+             "",
+             "#include <Arduino.h>",
+             "",
+             "typedef struct {",
+             "  uint32_t    delta;",
+             "  uint8_t     src[4];",
+             "  uint16_t    port;",
+             "  uint16_t    len;",
+             "  PGM_P       data;",
+             "} ReplayPacket;",
+             "",
+             '#define CORPUS_NAME "%s"' % name.replace('"', ""),
+             ""]
+    for i, p in enumerate(packets):
+        lines.append("const char CORPUS_%d[] PROGMEM = %s;" % (i, c_string(p.payload)))
+        lines.append("")
+    lines.append("const ReplayPacket CORPUS[] = {")
+    entries = []
+    for i, (p, d) in enumerate(zip(packets, delta)):
+        entries.append("  {%d, {%d,%d,%d,%d}, %d, %d, CORPUS_%d}" % (d, p.src[0], p.src[1], p.src[2], p.src[3], p.port, len(p.payload), i))
+    lines.append(",\n".join(entries))
+    lines.append("};")
+    lines.append("")
+    lines.append("#define CORPUS_SIZE (sizeof(CORPUS)/sizeof(ReplayPacket))")
+    lines.append("")
+    lines.append("#endif")
+    with open(path, "w") as f:
+        f.write("\n".join(lines) + "\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", help="pcap or pcapng file")
+    parser.add_argument("--out", help="write a corpus file for LittleFS")
+    parser.add_argument("--header", help="write a Corpus.h header")
+    parser.add_argument("--limit", type=int, default=0, help="keep at most this many packets")
+    parser.add_argument("--max-gap", type=int, default=1000000, help="cap gaps between packets, microseconds (0 for no cap)")
+    args = parser.parse_args()
+
+    packets, stats = extract(args.capture)
+    if args.limit:
+        packets = packets[:args.limit]
+    delta = deltas(packets, args.max_gap)
+
+    counts = {}
+    for p in packets:
+        c = classify(p.payload)
+        counts[c] = counts.get(c, 0) + 1
+    span = sum(delta) / 1e6
+    print("%d SSDP packets over %.1f s%s" % (len(packets), span,
+          (", %d IP fragments skipped" % stats["fragments"]) if stats.get("fragments") else ""))
+    for c in sorted(counts, key=counts.get, reverse=True):
+        print("  %-16s %6d" % (c, counts[c]))
+
+    if args.out:
+        write_corpus(args.out, packets, delta)
+    if args.header:
+        name = args.capture.replace("\\", "/").split("/")[-1]
+        write_header(args.header, name, packets, delta)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
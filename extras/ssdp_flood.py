@@ -0,0 +1,243 @@
+#!/usr/bin/env python3
+#
+#  UPnPLib Library
+#  Copyright (C) 2024  Daniel L Toth
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published
+#  by the Free Software Foundation, either version 3 of the License, or any
+#  later version.
+#
+#  The author can be contacted at dan@leelanausoftware.com
+#
+
+"""Offer M-SEARCH/NOTIFY traffic to an SSDP responder over real UDP.
+
+Run the SearchFlood example with FLOOD_MODE set to FLOOD_WIFI (or any sketch
+running SSDP and a web server), then drive it from a host on the same network:
+
+    python3 ssdp_flood.py 192.168.1.17 --mix mixed --rates 10,20,50,100 --duration 5
+
+Packets are sent open loop at each rate, each LSC search carrying a transaction
+that the responder echoes, so responses are matched to requests. For each rate
+one JSON line is written with the packets offered, the requests that expected a
+response and got none, first response latency percentiles, and the latency and
+failures of HTTP GET requests to the device made while the load runs, which
+shows whether SSDP traffic starves the web server. The device writes its own
+statistics (CPU time in readChannel and sending) to Serial once a second.
+"""
+
+import argparse
+import json
+import random
+import re
+import socket
+import threading
+import time
+import urllib.request
+
+SSDP_PORT = 1900
+SSDP_MULTICAST = "239.255.255.250"
+MISS_UUID = "00000000-0000-4000-8000-000000000000"
+SERVICE_TYPE = "urn:LeelanauSoftware-com:service:Basic:1.0.0"
+
+LSC_SEARCH = ("M-SEARCH * HTTP/1.1\r\n"
+              "HOST: 239.255.255.250:1900\r\n"
+              "MAN: ssdp:discover\r\n"
+              "ST: {st}\r\n"
+              "ST.LEELANAUSOFTWARE.COM: \r\n"
+              "TXN.LEELANAUSOFTWARE.COM: {txn:08x}\r\n"
+              "USER-AGENT: Linux UPnP/1.1 LSC-SSDP/1.0\r\n\r\n")
+
+DIAL_SEARCH = ("M-SEARCH * HTTP/1.1\r\n"
+               "HOST: 239.255.255.250:1900\r\n"
+               "MAN: \"ssdp:discover\"\r\n"
+               "MX: 1\r\n"
+               "ST: urn:dial-multiscreen-org:service:dial:1\r\n"
+               "USER-AGENT: Google Chrome/120.0.6099.130 Windows\r\n\r\n")
+
+ALL_SEARCH = ("M-SEARCH * HTTP/1.1\r\n"
+              "HOST: 239.255.255.250:1900\r\n"
+              "MAN: \"ssdp:discover\"\r\n"
+              "MX: 3\r\n"
+              "ST: ssdp:all\r\n\r\n")
+
+IGD_NOTIFY = ("NOTIFY * HTTP/1.1\r\n"
+              "HOST: 239.255.255.250:1900\r\n"
+              "CACHE-CONTROL: max-age=1800\r\n"
+              "LOCATION: http://192.168.1.1:1900/gatedesc.xml\r\n"
+              "NT: urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n"
+              "NTS: ssdp:alive\r\n"
+              "USN: uuid:75802409-bccb-40e7-8e6c-fa095ecce13e::urn:schemas-upnp-org:device:InternetGatewayDevice:1\r\n\r\n")
+
+# Same kinds and weights as examples/SearchFlood/Traffic.h
+KINDS = ["lsc_root", "lsc_uuid_hit", "lsc_uuid_miss", "lsc_urn", "dial", "ssdp_all", "notify"]
+MIXES = {
+    "lsc":     [50, 20, 10, 20, 0, 0, 0],
+    "mixed":   [20, 10, 5, 5, 20, 10, 30],
+    "foreign": [0, 0, 0, 0, 40, 20, 40],
+}
+
+TXN_RE = re.compile(rb"TXN\.LEELANAUSOFTWARE\.COM:\s*([0-9a-fA-F]+)")
+USN_RE = re.compile(rb"USN:\s*uuid:([0-9a-fA-F-]{36})")
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, len(values) * p // 100)]
+
+
+def discover_uuid(sock, dest):
+    """Learn the RootDevice uuid from an LSC root search, for uuid searches that hit"""
+    sock.sendto(LSC_SEARCH.format(st="upnp:rootdevice", txn=0).encode(), dest)
+    deadline = time.time() + 3
+    while time.time() < deadline:
+        sock.settimeout(deadline - time.time())
+        try:
+            data, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            break
+        m = USN_RE.search(data)
+        if m:
+            return m.group(1).decode()
+    return None
+
+
+def render(kind, txn, uuid):
+    if kind == "lsc_root":
+        return LSC_SEARCH.format(st="upnp:rootdevice", txn=txn), True
+    if kind == "lsc_uuid_hit":
+        return LSC_SEARCH.format(st="uuid:" + uuid, txn=txn), True
+    if kind == "lsc_uuid_miss":
+        return LSC_SEARCH.format(st="uuid:" + MISS_UUID, txn=txn), False
+    if kind == "lsc_urn":
+        return LSC_SEARCH.format(st=SERVICE_TYPE, txn=txn), True
+    if kind == "dial":
+        return DIAL_SEARCH, False
+    if kind == "ssdp_all":
+        return ALL_SEARCH, False
+    return IGD_NOTIFY, False
+
+
+class Step:
+    def __init__(self):
+        self.sent = {}          # txn -> (send time, response expected)
+        self.first = {}         # txn -> first response latency
+        self.responses = 0
+        self.http = []
+        self.http_errors = 0
+        self.lock = threading.Lock()
+
+
+def receiver(sock, step, stop):
+    sock.settimeout(0.1)
+    while not stop.is_set():
+        try:
+            data, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            continue
+        now = time.perf_counter()
+        m = TXN_RE.search(data)
+        if not m:
+            continue
+        txn = int(m.group(1), 16)
+        with step.lock:
+            step.responses += 1
+            if txn in step.sent and txn not in step.first:
+                step.first[txn] = now - step.sent[txn][0]
+
+
+def prober(url, interval, step, stop):
+    while not stop.is_set():
+        start = time.perf_counter()
+        try:
+            with urllib.request.urlopen(url, timeout=5) as r:
+                r.read()
+            with step.lock:
+                step.http.append(time.perf_counter() - start)
+        except Exception:
+            with step.lock:
+                step.http_errors += 1
+        stop.wait(interval)
+
+
+def run_step(sock, dest, args, uuid, rate, txn0):
+    step = Step()
+    stop = threading.Event()
+    threads = [threading.Thread(target=receiver, args=(sock, step, stop))]
+    if args.http_interval > 0:
+        threads.append(threading.Thread(target=prober, args=("http://%s:%d/" % (args.device, args.http_port), args.http_interval, step, stop)))
+    for t in threads:
+        t.start()
+
+    rng = random.Random(args.seed)
+    weights = MIXES[args.mix]
+    interval = 1.0 / rate
+    start = time.perf_counter()
+    txn = txn0
+    for i in range(int(rate * args.duration)):
+        next_send = start + i * interval
+        delay = next_send - time.perf_counter()
+        if delay > 0:
+            time.sleep(delay)
+        kind = rng.choices(KINDS, weights)[0]
+        packet, expected = render(kind, txn, uuid)
+        with step.lock:
+            step.sent[txn] = (time.perf_counter(), expected)
+        sock.sendto(packet.encode(), dest)
+        txn += 1
+    elapsed = time.perf_counter() - start
+    time.sleep(args.grace)
+    stop.set()
+    for t in threads:
+        t.join()
+
+    expected = [t for t, (_, e) in step.sent.items() if e]
+    lost = [t for t in expected if t not in step.first]
+    latencies = [v * 1e6 for v in step.first.values()]
+    http = [v * 1e6 for v in step.http]
+    print(json.dumps({
+        "mode": "udp", "mix": args.mix, "offered_pps": rate, "sent": len(step.sent),
+        "achieved_pps": round(len(step.sent) / elapsed, 1), "expected": len(expected),
+        "answered": len(expected) - len(lost), "lost": len(lost), "responses": step.responses,
+        "p50_us": int(percentile(latencies, 50)), "p90_us": int(percentile(latencies, 90)),
+        "p99_us": int(percentile(latencies, 99)), "max_us": int(max(latencies, default=0)),
+        "http_requests": len(http), "http_p50_us": int(percentile(http, 50)),
+        "http_max_us": int(max(http, default=0)), "http_errors": step.http_errors,
+    }), flush=True)
+    return txn
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("device", help="responder IP address")
+    parser.add_argument("--mix", choices=sorted(MIXES), default="mixed")
+    parser.add_argument("--rates", default="5,10,20,50,100,200", help="comma separated packets per second")
+    parser.add_argument("--duration", type=float, default=5.0, help="seconds per rate (default 5)")
+    parser.add_argument("--grace", type=float, default=2.0, help="seconds to wait for late responses after each rate")
+    parser.add_argument("--multicast", action="store_true", help="send to the SSDP multicast group rather than the device")
+    parser.add_argument("--http-port", type=int, default=80)
+    parser.add_argument("--http-interval", type=float, default=0.25, help="seconds between HTTP probes, 0 to disable")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 2)
+    sock.bind(("", 0))
+    dest = (SSDP_MULTICAST if args.multicast else args.device, SSDP_PORT)
+
+    uuid = discover_uuid(sock, (args.device, SSDP_PORT))
+    if uuid is None:
+        print("warning: no response to a root search from %s, uuid searches will all miss" % args.device)
+        uuid = MISS_UUID
+
+    txn = 1
+    for rate in [int(r) for r in args.rates.split(",")]:
+        txn = run_step(sock, dest, args, uuid, rate, txn)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
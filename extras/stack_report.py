@@ -0,0 +1,189 @@
+#!/usr/bin/env python3
+#
+#  UPnPLib Library
+#  Copyright (C) 2024  Daniel L Toth
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published
+#  by the Free Software Foundation, either version 3 of the License, or any
+#  later version.
+#
+#  The author can be contacted at dan@leelanausoftware.com
+#
+
+"""Static worst case stack report from compiler stack usage data.
+
+Compile the library with -fstack-usage -fcallgraph-info=su (GCC 10 or later),
+either on the host or with the ESP toolchain, for example
+
+    arduino-cli compile --build-property "compiler.cpp.extra_flags=-fstack-usage -fcallgraph-info=su" ...
+
+Frame sizes are those of the target compiled for, so use the ESP toolchain
+for numbers that apply to a device. Each .ci file holds the frame size of
+every function in a translation unit and the calls it makes. The report
+follows calls from each root function and prints the deepest chain:
+
+    python3 stack_report.py build/ [--root doSSDP --root displayRoot] [--limit 4096]
+
+Roots are matched as substrings of the demangled function name, and default
+to the paths probed by StackProfiler. A worst case is a lower bound if the
+chain reaches a function with a dynamic frame (a VLA or alloca), an indirect
+call (std::function, virtual functions), recursion, or a function with no
+stack data (the core and SDK, unless compiled with the same flags); these
+are flagged. With only .su files (no .ci), the largest frames are listed.
+The exit status is 1 if any worst case exceeds --limit.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+DEFAULT_ROOTS = [
+    "lsc::SSDP::doSSDP()",
+    "lsc::SSDP::searchRequest(const char*, lsc::SSDPHandler, int, boolean)",
+    "lsc::SSDP::searchRecords(const char*, lsc::SSDPRecordHandler, int, boolean)",
+    "lsc::UPnPDevice::display(",
+    "lsc::RootDevice::displayRoot(",
+    "lsc::RootDevice::metrics(",
+]
+
+STRING = r'"((?:[^"\\]|\\.)*)"'
+NODE = re.compile(r'node:\s*\{\s*title:\s*' + STRING + r'\s*label:\s*' + STRING)
+EDGE = re.compile(r'edge:\s*\{\s*sourcename:\s*' + STRING + r'\s*targetname:\s*' + STRING)
+BYTES = re.compile(r'(\d+) bytes \(([^)]*)\)')
+
+
+class Function:
+    def __init__(self, title, label):
+        lines = label.split("\\n")
+        self.title = title
+        self.name = lines[0]
+        self.where = lines[1] if len(lines) > 1 else ""
+        self.frame = None
+        self.dynamic = False
+        m = BYTES.search(label)
+        if m:
+            self.frame = int(m.group(1))
+            self.dynamic = "dynamic" in m.group(2) and "bounded" not in m.group(2)
+        self.calls = set()
+
+
+def files(paths, ext):
+    for path in paths:
+        if os.path.isdir(path):
+            for top, _, names in os.walk(path):
+                for name in sorted(names):
+                    if name.endswith(ext):
+                        yield os.path.join(top, name)
+        elif path.endswith(ext):
+            yield path
+
+
+def load_graph(paths):
+    functions = {}
+    edges = []
+    for path in files(paths, ".ci"):
+        with open(path, errors="replace") as f:
+            for line in f:
+                m = NODE.search(line)
+                if m:
+                    fn = Function(m.group(1), m.group(2))
+                    known = functions.get(fn.title)
+                    if known is None or (known.frame is None and fn.frame is not None):
+                        functions[fn.title] = fn
+                    continue
+                m = EDGE.search(line)
+                if m:
+                    edges.append((m.group(1), m.group(2)))
+    for source, target in edges:
+        if source in functions:
+            functions[source].calls.add(target)
+    return functions
+
+
+def nested(name):
+    """True for lambdas and template instances that only mention a root in their name"""
+    return "<lambda" in name or "[with" in name
+
+
+def worst(functions, title, memo, active):
+    """Returns (bytes, flags, chain) for the deepest chain from title"""
+    if title in memo:
+        return memo[title]
+    fn = functions.get(title)
+    if title == "__indirect_call":
+        return 0, {"indirect"}, []
+    if fn is None or fn.frame is None:
+        name = fn.name if fn else title
+        return 0, {"unknown"}, [(name, None)]
+    if title in active:
+        return 0, {"recursive"}, [(fn.name, None)]
+    active.add(title)
+    deepest, flags, chain = 0, set(), []
+    for callee in sorted(fn.calls):
+        depth, f, c = worst(functions, callee, memo, active)
+        flags |= f
+        if depth > deepest or not chain:
+            deepest, chain = depth, c
+    active.discard(title)
+    if fn.dynamic:
+        flags.add("dynamic")
+    result = (fn.frame + deepest, flags, [(fn.name, fn.frame)] + chain)
+    memo[title] = result
+    return result
+
+
+def report_graph(functions, roots, limit):
+    over = 0
+    memo = {}
+    for pattern in roots:
+        matches = [fn for fn in functions.values() if fn.frame is not None and pattern in fn.name and not nested(fn.name)]
+        if not matches:
+            print("%-60s %8s" % (pattern[:60], "-"))
+            continue
+        for fn in sorted(matches, key=lambda x: x.name):
+            depth, flags, chain = worst(functions, fn.title, memo, set())
+            flag = ""
+            if limit and depth > limit:
+                flag = "  OVER LIMIT"
+                over += 1
+            print("%-60s %8d  %s%s" % (fn.name[:60], depth, ",".join(sorted(flags)) or "bounded", flag))
+            for name, frame in chain:
+                print("    %8s  %s" % ("?" if frame is None else frame, name[:100]))
+    return over
+
+
+def report_su(paths, top):
+    frames = []
+    for path in files(paths, ".su"):
+        with open(path, errors="replace") as f:
+            for line in f:
+                parts = line.rstrip("\n").split("\t")
+                if len(parts) == 3 and parts[1].isdigit():
+                    frames.append((int(parts[1]), parts[2], parts[0]))
+    frames.sort(reverse=True)
+    for size, qualifier, where in frames[:top]:
+        print("%8d  %-16s %s" % (size, qualifier, where[:120]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("paths", nargs="+", help=".ci or .su files, or directories to search")
+    parser.add_argument("--root", action="append", help="function to report, may be repeated (default: probed paths)")
+    parser.add_argument("--limit", type=int, default=0, help="flag worst cases above this many bytes")
+    parser.add_argument("--top", type=int, default=25, help="frames to list when there is no call graph (default 25)")
+    args = parser.parse_args()
+
+    functions = load_graph(args.paths)
+    if not functions:
+        report_su(args.paths, args.top)
+        return 0
+    over = report_graph(functions, args.root or DEFAULT_ROOTS, args.limit)
+    if over:
+        print("%d path(s) over the %d byte limit" % (over, args.limit))
+    return 1 if over else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,221 @@
+#!/usr/bin/env python3
+#
+#  UPnPLib Library
+#  Copyright (C) 2024  Daniel L Toth
+#
+#  This program is free software: you can redistribute it and/or modify
+#  it under the terms of the GNU Lesser General Public License as published
+#  by the Free Software Foundation, either version 3 of the License, or any
+#  later version.
+#
+#  The author can be contacted at dan@leelanausoftware.com
+#
+
+"""Decode an SSDP trace dumped by TraceRing.
+
+Capture the dump over HTTP from a route added by the sketch, or from the
+serial monitor after TraceRing::dump(Serial); lines before the LSCTRACE
+header, such as other serial output, are ignored:
+
+    curl -s http://device/trace > trace.txt
+    python3 trace_decode.py trace.txt [--summary] [--since 2.5]
+
+Each event is printed with its time in seconds before the dump (time stamps
+are micros() and wrap every 71 minutes, so times are taken relative to the
+dump), the time since the previous event, the interface and its decoded
+arguments. Requests are numbered from their RECEIVED event, and REPLIED
+lines show the time to answer and the packets sent. --summary prints event
+counts and response time statistics instead.
+"""
+
+import argparse
+import sys
+
+EVENTS = {
+    1: "RECEIVED",
+    2: "FILTERED",
+    3: "TRUNCATED",
+    4: "LSC_SEARCH",
+    5: "OTHER_SEARCH",
+    6: "RESPONSE",
+    7: "OTHER",
+    8: "MATCHED",
+    9: "NO_MATCH",
+    10: "QUEUED",
+    11: "SENT",
+    12: "SEND_FAILED",
+    13: "PACED",
+    14: "REPLIED",
+    15: "SEARCH_BEGIN",
+    16: "SEARCH_END",
+}
+
+MATCH_KINDS = {1: "root", 2: "uuid", 3: "type"}
+MATCH_ALL = 0x10
+WRAP = 1 << 32
+
+
+class Event:
+    def __init__(self, time, event, ifc, arg, data):
+        self.time = time
+        self.event = event
+        self.ifc = ifc
+        self.arg = arg
+        self.data = data
+        self.age = 0
+        self.request = None
+
+    @property
+    def name(self):
+        return EVENTS.get(self.event, "EVENT_%d" % self.event)
+
+
+class Trace:
+    def __init__(self):
+        self.version = 0
+        self.capacity = 0
+        self.recorded = 0
+        self.now = 0
+        self.mhz = 0
+        self.events = []
+
+    @property
+    def dropped(self):
+        return max(0, self.recorded - len(self.events))
+
+
+def address(value):
+    """IPAddress byte order, the first octet is the low byte"""
+    return "%d.%d.%d.%d" % (value & 0xff, (value >> 8) & 0xff, (value >> 16) & 0xff, (value >> 24) & 0xff)
+
+
+def parse(lines):
+    """Returns the last complete trace in lines, None if there is none"""
+    trace, current = None, None
+    for line in lines:
+        parts = line.split()
+        if parts and parts[0] == "LSCTRACE":
+            current = Trace()
+            current.version, current.capacity, _, current.recorded, current.now, current.mhz = [int(p) for p in parts[1:7]]
+        elif current is None:
+            continue
+        elif parts == ["END"]:
+            trace, current = current, None
+        elif len(parts) == 5:
+            try:
+                current.events.append(Event(*[int(p, 16) for p in parts]))
+            except ValueError:
+                pass
+    if trace is None:
+        return None
+    # Ages are taken back from the dump time, one wrap of micros() at most between neighbours
+    age = 0
+    later = trace.now
+    for e in reversed(trace.events):
+        age += (later - e.time) % WRAP
+        e.age = age
+        later = e.time
+    request = 0
+    for e in trace.events:
+        if e.event == 1:
+            request += 1
+        if request and e.event not in (15, 16):
+            e.request = request
+    return trace
+
+
+def describe(e, started):
+    ifc = "-" if e.ifc == 0xff else str(e.ifc)
+    if e.event == 1:
+        text = "%d bytes from %s" % (e.arg, address(e.data))
+    elif e.event == 2:
+        text = "routed from %s" % address(e.data)
+    elif e.event == 3:
+        text = "%d bytes read" % e.arg
+    elif e.event == 4:
+        text = "txn %08x%s" % (e.data, " binary" if e.arg else "")
+    elif e.event in (5, 6, 7):
+        text = "prefiltered" if e.arg else ""
+    elif e.event == 8:
+        kind = MATCH_KINDS.get(e.arg & 0x0f, str(e.arg & 0x0f))
+        text = "%s%s st %08x" % (kind, " ssdp:all" if e.arg & MATCH_ALL else "", e.data)
+    elif e.event == 9:
+        text = "st %08x" % e.data if e.data else "no ST header"
+    elif e.event == 10:
+        text = "%d bytes" % e.arg
+    elif e.event in (11, 12):
+        text = "%d bytes to %s" % (e.arg, address(e.data))
+    elif e.event == 13:
+        text = "%d ms" % e.arg
+    elif e.event == 14:
+        start = started.get(e.request)
+        text = "%d packets in %.3f ms" % (start[1], (start[0] - e.age) / 1000.0) if start else ""
+    elif e.event == 15:
+        text = "txn %08x on %d interfaces" % (e.data, e.arg)
+    elif e.event == 16:
+        text = "txn %08x session %d" % (e.data, e.arg)
+    else:
+        text = ""
+    return ifc, text
+
+
+def print_events(trace, since, out):
+    started = {}
+    previous = None
+    print("%12s %10s %5s %-5s %-13s %s" % ("seconds", "delta_us", "req", "ifc", "event", ""), file=out)
+    for e in trace.events:
+        if e.event == 1:
+            started[e.request] = [e.age, 0]
+        elif e.event == 11 and e.request in started:
+            started[e.request][1] += 1
+        delta = "" if previous is None else str(previous.age - e.age)
+        previous = e
+        if since is not None and e.age > since * 1e6:
+            continue
+        ifc, text = describe(e, started)
+        print("%12.6f %10s %5s %-5s %-13s %s" % (-e.age / 1e6, delta, e.request or "", ifc, e.name, text), file=out)
+
+
+def print_summary(trace, out):
+    counts = {}
+    for e in trace.events:
+        counts[e.name] = counts.get(e.name, 0) + 1
+    span = (trace.events[0].age / 1e6) if trace.events else 0
+    print("%d events over %.3f s, %d overwritten, ring of %d at %d MHz" % (len(trace.events), span, trace.dropped, trace.capacity, trace.mhz), file=out)
+    for code in sorted(EVENTS):
+        name = EVENTS[code]
+        if name in counts:
+            print("  %-13s %8d" % (name, counts[name]), file=out)
+    replies, start = [], {}
+    for e in trace.events:
+        if e.event == 1:
+            start[e.request] = e.age
+        elif e.event == 14 and e.request in start:
+            replies.append(start[e.request] - e.age)
+    if replies:
+        replies.sort()
+        pct = lambda p: replies[min(len(replies) - 1, int(p * len(replies)))] / 1000.0
+        print("replies %d: median %.3f ms, 90%% %.3f ms, max %.3f ms" % (len(replies), pct(0.5), pct(0.9), replies[-1] / 1000.0), file=out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("trace", nargs="?", help="dump file, standard input if omitted")
+    parser.add_argument("--summary", action="store_true", help="print event counts and reply times only")
+    parser.add_argument("--since", type=float, help="only events in the last SINCE seconds before the dump")
+    args = parser.parse_args()
+
+    f = open(args.trace, errors="replace") if args.trace else sys.stdin
+    trace = parse(f)
+    if trace is None:
+        print("no complete LSCTRACE dump found", file=sys.stderr)
+        return 1
+    if args.summary:
+        print_summary(trace, sys.stdout)
+    else:
+        print_events(trace, args.since, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,489 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "Federation.h"
+
+namespace lsc {
+
+#define FED_BUFFER_SIZE   1024
+#define FED_LINE_SIZE     (FED_USN_SIZE+FED_LOC_SIZE+FED_DESC_SIZE+8)
+#define FED_VV_SIZE       (FED_MAX_HUBS*(UUID_SIZE+12)+1)
+#define FED_MAX_PARTS     32
+
+/** Message Templates
+ *
+ */
+const char FED_SYNC_MSG[]        PROGMEM = "FED-SYNC * LSC/1.0\r\n"
+                                           "HUB: %s\r\n"
+                                           "VV: ";
+const char FED_DELTA_MSG[]       PROGMEM = "FED-DELTA * LSC/1.0\r\n"
+                                           "HUB: %s\r\n"
+                                           "ORIGIN: %s\r\n"
+                                           "VERSION: %lu\r\n"
+                                           "PART: %02d/%02d\r\n";
+const char FED_RECORD[]          PROGMEM = "REC: %s\t%s\t%s\r\n";
+const char FED_VV_ENTRY[]        PROGMEM = "%s=%lu,";
+
+/** Header field constants
+ *
+ */
+const char FED_SYNC[]            PROGMEM = "FED-SYNC";
+const char FED_DELTA[]           PROGMEM = "FED-DELTA";
+const char FED_HUB_HEADER[]      PROGMEM = "HUB";
+const char FED_VV_HEADER[]       PROGMEM = "VV";
+const char FED_ORIGIN_HEADER[]   PROGMEM = "ORIGIN";
+const char FED_VERSION_HEADER[]  PROGMEM = "VERSION";
+const char FED_PART_HEADER[]     PROGMEM = "PART";
+const char FED_REC[]             PROGMEM = "REC:";
+const char FED_USN_HEADER[]      PROGMEM = "USN";
+const char FED_LOC_HEADER[]      PROGMEM = "LOCATION";
+const char FED_DESC_HEADER[]     PROGMEM = "DESC.LEELANAUSOFTWARE.COM";
+const char FED_ROOTDEVICE[]      PROGMEM = "upnp:rootdevice";
+
+/**
+ *  Copy the next TAB delimited field of a REC line into buffer and return the start of the following field,
+ *  or NULL if this was the last field. truncated is set if the field did not fit in buffer.
+ */
+static const char* nextField(const char* start, char buffer[], size_t size, boolean& truncated) {
+  const char* end = strchr(start,'\t');
+  size_t len = ((end != NULL)?(end-start):(strlen(start))) + 1;   // +1 to include null termination on copy
+  if( len > size ) {
+    len = size;
+    truncated = true;
+  }
+  strlcpy(buffer,start,len);
+  return ((end != NULL)?(end+1):(NULL));
+}
+
+boolean FederationRecord::matches(const char* st) {
+  boolean result = false;
+  if( strcmp_P(st,FED_ROOTDEVICE) == 0 ) result = isRootDevice();
+  else if( strncmp(st,"uuid:",5) == 0 ) {
+    const char* u = st + 5;
+    while( *u == ' ' ) {u++;}
+    size_t len = strlen(u);
+    result = ((strncmp(_usn,"uuid:",5) == 0) && (strncasecmp(_usn+5,u,len) == 0) && (_usn[5+len] == ':'));
+  }
+  else if( strncmp(st,"urn:",4) == 0 ) {
+    const char* type = strstr(_usn,"::");
+    result = ((type != NULL) && (strcmp(type+2,st) == 0));
+  }
+  return result;
+}
+
+/**
+ *  A sweep session still running is cancelled without publishing its records
+ */
+Federation::~Federation() {
+  if( _sweeping ) {
+    _sweeping = false;
+    _ssdp->cancelSearch(_sweepID);
+  }
+  _wifiUdp.stop();
+}
+
+/**
+ *  Hub 0 in the version vector is always this hub, identified by the uuid of its RootDevice.
+ */
+void Federation::begin(RootDevice* root, int port) {
+  begin(root,&_wifiUdp,port);
+}
+
+void Federation::begin(RootDevice* root, UDP* channel, int port) {
+  _root     = root;
+  _udp      = channel;
+  _port     = port;
+  _numHubs  = 0;
+  hubIndex(root->uuid(),true);
+  _udp->begin(port);
+  _lastSync = millis();
+}
+
+boolean Federation::addPeer(IPAddress addr, int port) {
+  boolean result = false;
+  if( _numPeers < FED_MAX_PEERS ) {
+    _peers[_numPeers].addr = addr;
+    _peers[_numPeers].port = port;
+    _numPeers++;
+    result = true;
+  }
+  else SSDP_LOG_WARNING("Federation::addPeer: Peer limit of %d reached\n",FED_MAX_PEERS);
+  return result;
+}
+
+void Federation::doFederation() {
+  if( _root != NULL ) {
+    if( _udp->parsePacket() > 0 ) readChannel();
+    if( millis() - _lastSync >= _syncInterval ) sync();
+  }
+}
+
+void Federation::sync() {
+  for( int i=0; i<_numPeers; i++ ) {sendSync(_peers[i].addr,_peers[i].port);}
+  _lastSync = millis();
+}
+
+/**
+ *  Replace this hub's records with the results of an ssdp:all RootDevice search on ifc. 
+ */
+SSDPResult Federation::sweep(IPAddress ifc, int timeout) {
+  if( _root == NULL ) return SSDP_ERR_UDP;
+  beginSweep();
+  SSDPResult result = SSDP::searchRequest("upnp:rootdevice",[this](UPnPBuffer* b){this->sweepResponse(b);},ifc,timeout,true);
+  endSweep(result);
+  return result;
+}
+
+/**
+ *  Sweep on the channels of a responder, so a device that is both hub and responder opens no sockets for it and does 
+ *  not block the loop. The session is ended by ssdp.doSSDP(), which publishes the sweep through endSweep().
+ */
+SSDPResult Federation::sweep(SSDP* ssdp, int timeout) {
+  if( (_root == NULL) || (ssdp == NULL) ) return SSDP_ERR_UDP;
+  if( _sweeping ) return SSDP_ERR_BUSY;
+  beginSweep();
+  _ssdp     = ssdp;
+  _sweeping = true;
+  SSDPResult result = ssdp->startSearch("upnp:rootdevice",[this](UPnPBuffer* b){this->sweepResponse(b);},timeout,true,&_sweepID,
+                                        [this](SSDPResult r){if( _sweeping ) {_sweeping = false; endSweep(r);}});
+  if( result != SSDP_OK ) {
+    _sweeping = false;
+    endSweep(result);
+  }
+  return result;
+}
+
+/**
+ *  Responses are collected as FED_SWEEP_HUB records alongside the current ones, so this hub keeps answering queries
+ *  and peers keep the current version until the sweep is complete.
+ */
+void Federation::beginSweep() {
+  removeRecords(FED_SWEEP_HUB);
+}
+
+void Federation::sweepResponse(UPnPBuffer* b) {
+  char usn[FED_USN_SIZE];
+  char loc[FED_LOC_SIZE];
+  char desc[FED_DESC_SIZE];
+  usn[0]  = '\0';
+  loc[0]  = '\0';
+  desc[0] = '\0';
+  if( b->headerValue_P(FED_USN_HEADER,usn,FED_USN_SIZE) && !b->truncated() && b->headerValue_P(FED_DESC_HEADER,desc,FED_DESC_SIZE) && !b->truncated() ) {
+    b->headerValue_P(FED_LOC_HEADER,loc,FED_LOC_SIZE);
+    if( !b->truncated() ) addRecord(FED_SWEEP_HUB,usn,loc,desc);
+    else SSDP_LOG_WARNING("Federation::sweep: Location longer than %d ignored for %s\n",FED_LOC_SIZE-1,usn);
+  }
+  else if( b->truncated() ) SSDP_LOG_WARNING("Federation::sweep: Response with USN or DESC too long ignored\n");
+}
+
+/**
+ *  A failed sweep is discarded and this hub keeps its records and version. A successful sweep replaces the records of
+ *  this hub, and the hub version is only incremented if the record set changed, so an unchanged segment generates 
+ *  no FED-DELTA traffic.
+ */
+void Federation::endSweep(SSDPResult result) {
+  if( result != SSDP_OK ) {
+    removeRecords(FED_SWEEP_HUB);
+    SSDP_LOG_WARNING("Federation::sweep: Search failed with result %d, records kept at version %lu\n",result,(unsigned long)_hubs[0].version);
+    return;
+  }
+  removeRecords(0);
+  for( int i=0; i<_numRecords; i++ ) {if( _records[i]._hub == FED_SWEEP_HUB ) _records[i]._hub = 0;}
+  uint32_t d = digest(0);
+  if( (d != _digest) || (_hubs[0].version == 0) ) {
+    _digest = d;
+    _hubs[0].version = ((_hubs[0].version > _peerVersion)?(_hubs[0].version):(_peerVersion)) + 1;
+    SSDP_LOG_INFO("Federation::sweep: Hub version is now %lu\n",(unsigned long)_hubs[0].version);
+  }
+}
+
+void Federation::query(const char* st, FederationHandler handler) {
+  for( int i=0; i<_numRecords; i++ ) {
+    if( (_records[i]._hub != FED_SWEEP_HUB) && _records[i].matches(st) ) handler(&_records[i]);
+  }
+}
+
+/**
+ *  A version is complete once all of its parts have arrived. Until then the previous version is advertised
+ *  so peers resend the whole version on the next exchange. This hub's own version is always complete.
+ */
+uint32_t Federation::completeVersion(int hub) {
+  Hub& h = _hubs[hub];
+  boolean complete = ((hub == 0) || (h.numParts == 0) || (h.parts == ((h.numParts>=32)?(0xFFFFFFFF):((1UL<<h.numParts)-1))));
+  return ((complete)?(h.version):((h.version>0)?(h.version-1):(0)));
+}
+
+int Federation::hubIndex(const char* uuid, boolean add) {
+  int result = -1;
+  for( int i=0; (i<_numHubs) && (result < 0); i++ ) {if( strcmp(_hubs[i].uuid,uuid) == 0 ) result = i;}
+  if( (result < 0) && add ) {
+    if( _numHubs < FED_MAX_HUBS ) {
+      result = _numHubs++;
+      strlcpy(_hubs[result].uuid,uuid,UUID_SIZE);
+      _hubs[result].version  = 0;
+      _hubs[result].parts    = 0;
+      _hubs[result].numParts = 0;
+    }
+    else SSDP_LOG_WARNING("Federation::hubIndex: Hub limit of %d reached, ignoring hub %s\n",FED_MAX_HUBS,uuid);
+  }
+  return result;
+}
+
+/**
+ *  Remove all records from hub, compacting the record array in place.
+ */
+void Federation::removeRecords(int hub) {
+  int j = 0;
+  for( int i=0; i<_numRecords; i++ ) {
+    if( _records[i]._hub != hub ) {
+      if( i != j ) _records[j] = _records[i];
+      j++;
+    }
+  }
+  _numRecords = j;
+}
+
+/**
+ *  A sweep in progress may take the place of one of this hub's current records when the record array is full, since 
+ *  those are about to be replaced, so a sweep has the same room as the records it replaces.
+ */
+boolean Federation::addRecord(int hub, const char* usn, const char* location, const char* desc) {
+  int own = -1;
+  for( int i=0; i<_numRecords; i++ ) {
+    if( (_records[i]._hub == hub) && (strcmp(_records[i]._usn,usn) == 0) ) return false;
+    if( _records[i]._hub == 0 ) own = i;
+  }
+  if( (_numRecords >= FED_MAX_RECORDS) && (hub == FED_SWEEP_HUB) && (own >= 0) ) {
+    _records[own] = _records[--_numRecords];
+  }
+  if( _numRecords >= FED_MAX_RECORDS ) {
+    SSDP_LOG_WARNING("Federation::addRecord: Record limit of %d reached, ignoring %s\n",FED_MAX_RECORDS,usn);
+    return false;
+  }
+  FederationRecord& r = _records[_numRecords++];
+  r._hub = hub;
+  strlcpy(r._usn,usn,FED_USN_SIZE);
+  strlcpy(r._location,location,FED_LOC_SIZE);
+  strlcpy(r._desc,desc,FED_DESC_SIZE);
+  return true;
+}
+
+/**
+ *  FNV-1a hash over the records of hub
+ */
+uint32_t Federation::digest(int hub) {
+  uint32_t h = 2166136261UL;
+  for( int i=0; i<_numRecords; i++ ) {
+    FederationRecord& r = _records[i];
+    if( r._hub == hub ) {
+      const char* fields[3] = {r._usn,r._location,r._desc};
+      for( int f=0; f<3; f++ ) {
+        for( const char* c=fields[f]; *c; c++ ) {h ^= (uint8_t)*c; h *= 16777619UL;}
+        h ^= '\t'; h *= 16777619UL;
+      }
+    }
+  }
+  return h;
+}
+
+void Federation::readChannel() {
+  IPAddress remoteAddr = _udp->remoteIP();
+  int       port       = _udp->remotePort();
+  char txnBuffer[FED_BUFFER_SIZE + 1];
+  txnBuffer[0] = 0;
+  int available = _udp->read(txnBuffer, FED_BUFFER_SIZE);
+  if( available < 0 ) available = 0;
+  txnBuffer[available] = 0;
+  UPnPBuffer buffer = UPnPBuffer(txnBuffer);
+  if( strncmp_P(txnBuffer,FED_DELTA,9) == 0 )     handleDelta(buffer);
+  else if( strncmp_P(txnBuffer,FED_SYNC,8) == 0 ) handleSync(buffer,remoteAddr,port);
+  else SSDP_LOG_FINE("Federation::readChannel: Unknown message from %s\n",remoteAddr.toString().c_str());
+}
+
+/**
+ *  Send FED-DELTA for every hub where this hub holds a newer complete version than the peer, and reply
+ *  with FED-SYNC if the peer holds a version this hub does not. A peer holding a version of this hub at least as
+ *  new as the current one has records from before a restart, and this hub continues from the peer version.
+ */
+void Federation::handleSync(UPnPBuffer& buffer, IPAddress addr, int port) {
+  char vv[FED_VV_SIZE];
+  vv[0] = '\0';
+  buffer.headerValue_P(FED_VV_HEADER,vv,FED_VV_SIZE);
+
+  const char* own = strstr(vv,_hubs[0].uuid);
+  if( (own != NULL) && (own[UUID_SIZE-1] == '=') ) {
+    uint32_t reported = strtoul(own+UUID_SIZE,NULL,10);
+    if( reported > _peerVersion ) _peerVersion = reported;
+    if( (_hubs[0].version > 0) && (reported >= _hubs[0].version) ) {
+      _hubs[0].version = reported + 1;
+      SSDP_LOG_INFO("Federation::handleSync: Peer holds version %lu, hub version is now %lu\n",(unsigned long)reported,(unsigned long)_hubs[0].version);
+    }
+  }
+
+  for( int i=0; i<_numHubs; i++ ) {
+    uint32_t version = completeVersion(i);
+    uint32_t peerVersion = 0;
+    const char* entry = strstr(vv,_hubs[i].uuid);
+    if( (entry != NULL) && (entry[UUID_SIZE-1] == '=') ) peerVersion = strtoul(entry+UUID_SIZE,NULL,10);
+    if( (version > peerVersion) && (version == _hubs[i].version) ) sendDelta(i,addr,port);   // Only complete versions are forwarded
+  }
+
+  boolean peerAhead = false;
+  char uuid[UUID_SIZE];
+  for( const char* entry=vv; (*entry != '\0') && !peerAhead; ) {
+    const char* eq = strchr(entry,'=');
+    if( eq == NULL ) break;
+    size_t len = eq - entry + 1;
+    if( len > UUID_SIZE ) len = UUID_SIZE;
+    strlcpy(uuid,entry,len);
+    uint32_t peerVersion = strtoul(eq+1,NULL,10);
+    int hub = hubIndex(uuid,false);
+    if( hub != 0 ) peerAhead = ((hub < 0)?(peerVersion > 0):(peerVersion > completeVersion(hub)));
+    const char* next = strchr(eq,',');
+    entry = ((next != NULL)?(next+1):(eq+strlen(eq)));
+  }
+  if( peerAhead ) sendSync(addr,port);
+}
+
+/**
+ *  A newer origin version replaces all records from that origin. Parts of the current version are added
+ *  as they arrive and duplicate or older parts are ignored.
+ */
+void Federation::handleDelta(UPnPBuffer& buffer) {
+  char origin[UUID_SIZE];
+  char value[16];
+  origin[0] = '\0';
+  if( !buffer.headerValue_P(FED_ORIGIN_HEADER,origin,UUID_SIZE) ) return;
+  if( !buffer.headerValue_P(FED_VERSION_HEADER,value,sizeof(value)) ) return;
+  uint32_t version = strtoul(value,NULL,10);
+  if( !buffer.headerValue_P(FED_PART_HEADER,value,sizeof(value)) ) return;
+  int part = atoi(value);
+  const char* slash = strchr(value,'/');
+  int numParts = ((slash != NULL)?(atoi(slash+1)):(1));
+  if( (part < 1) || (part > numParts) || (numParts > FED_MAX_PARTS) ) return;
+
+  int hub = hubIndex(origin,true);
+  if( hub <= 0 ) return;                                // Unknown hub that does not fit, or records about ourselves
+  Hub& h = _hubs[hub];
+  uint32_t mask = (1UL << (part-1));
+  if( version > h.version ) {
+    removeRecords(hub);
+    h.version  = version;
+    h.parts    = 0;
+    h.numParts = numParts;
+  }
+  else if( (version < h.version) || ((h.parts & mask) != 0) ) return;
+  h.parts |= mask;
+
+  char line[FED_LINE_SIZE];
+  char usn[FED_USN_SIZE];
+  char loc[FED_LOC_SIZE];
+  char desc[FED_DESC_SIZE];
+  const char* lineStart = buffer.firstLine();
+  while( buffer.hasNextLine(lineStart) ) {
+    lineStart = buffer.getNextLine(lineStart,line,FED_LINE_SIZE);
+    if( strncmp_P(line,FED_REC,4) == 0 ) {
+      boolean truncated = (strlen(line) >= FED_LINE_SIZE-1);
+      const char* field = line + 4;
+      while( *field == ' ' ) {field++;}
+      field = nextField(field,usn,FED_USN_SIZE,truncated);
+      if( field != NULL ) field = nextField(field,loc,FED_LOC_SIZE,truncated);
+      if( field != NULL ) {
+        nextField(field,desc,FED_DESC_SIZE,truncated);
+        if( !truncated ) addRecord(hub,usn,loc,desc);
+        else SSDP_LOG_WARNING("Federation::handleDelta: Record too long ignored from hub %s\n",origin);
+      }
+    }
+  }
+  SSDP_LOG_FINE("Federation::handleDelta: Received part %d/%d of version %lu for hub %s\n",part,numParts,(unsigned long)version,origin);
+}
+
+void Federation::sendSync(IPAddress addr, int port) {
+  char buffer[FED_BUFFER_SIZE];
+  int pos = snprintf_P(buffer,FED_BUFFER_SIZE,FED_SYNC_MSG,_hubs[0].uuid);
+  for( int i=0; (i<_numHubs) && (pos<FED_BUFFER_SIZE); i++ ) {
+    uint32_t version = completeVersion(i);
+    if( version > 0 ) pos += snprintf_P(buffer+pos,FED_BUFFER_SIZE-pos,FED_VV_ENTRY,_hubs[i].uuid,(unsigned long)version);
+  }
+  if( pos < FED_BUFFER_SIZE ) snprintf_P(buffer+pos,FED_BUFFER_SIZE-pos,PSTR("\r\n\r\n"));
+  send(buffer,addr,port);
+}
+
+/**
+ *  Records for a hub version may not fit in a single packet, so the first pass counts parts and the second sends them.
+ */
+void Federation::sendDelta(int hub, IPAddress addr, int port) {
+  char buffer[FED_BUFFER_SIZE];
+  int numParts = 0;
+  int next = 0;
+  do {
+    next = packDelta(hub,next,buffer,FED_BUFFER_SIZE,0,0);
+    numParts++;
+  } while( (next < _numRecords) && (numParts < FED_MAX_PARTS) );
+  if( next < _numRecords ) {
+    int dropped = 0;
+    for( int i=next; i<_numRecords; i++ ) {if( _records[i]._hub == hub ) dropped++;}
+    if( dropped > 0 ) SSDP_LOG_WARNING("Federation::sendDelta: %d records of hub %s do not fit in %d parts and are not sent\n",dropped,_hubs[hub].uuid,FED_MAX_PARTS);
+  }
+
+  next = 0;
+  for( int part=1; part<=numParts; part++ ) {
+    next = packDelta(hub,next,buffer,FED_BUFFER_SIZE,part,numParts);
+    send(buffer,addr,port);
+  }
+}
+
+/**
+ *  Pack records of hub, starting at record index start, into buffer. Returns the index of the first record that
+ *  did not fit, or numRecords() if all remaining records were packed.
+ */
+int Federation::packDelta(int hub, int start, char buffer[], int size, int part, int numParts) {
+  int pos = snprintf_P(buffer,size,FED_DELTA_MSG,_hubs[0].uuid,_hubs[hub].uuid,(unsigned long)completeVersion(hub),part,numParts);
+  int result = _numRecords;
+  boolean packed = false;
+  for( int i=start; (i<_numRecords) && (result == _numRecords); i++ ) {
+    FederationRecord& r = _records[i];
+    if( r._hub == hub ) {
+      int len = snprintf_P(NULL,0,FED_RECORD,r._usn,r._location,r._desc);
+      if( (pos + len + 3 <= size) || !packed ) {
+        if( pos + len + 3 <= size ) pos += snprintf_P(buffer+pos,size-pos,FED_RECORD,r._usn,r._location,r._desc);
+        packed = true;
+      }
+      else result = i;
+    }
+  }
+  if( pos + 3 <= size ) snprintf_P(buffer+pos,size-pos,PSTR("\r\n"));
+  return result;
+}
+
+boolean Federation::send(const char* buffer, IPAddress addr, int port) {
+  int len = strlen(buffer);
+  int ok = _udp->beginPacket(addr,port);
+  if( ok == 1 ) {
+    _udp->write((const unsigned char*)buffer,len);
+    ok = _udp->endPacket();
+  }
+  if( ok != 1 ) SSDP_LOG_WARNING("Federation::send: Error sending %d bytes to %s:%d\n",len,addr.toString().c_str(),port);
+  return (ok == 1);
+}
+
+} // End of namespace lsc
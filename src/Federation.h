@@ -0,0 +1,220 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * Federation.h
+ *
+ *  Discovery federation between hubs. A hub is a RootDevice that periodically sweeps its own network segment with
+ *  an SSDP search and keeps the responses as FederationRecords. Hubs exchange their records over unicast UDP
+ *  so each hub can answer queries about every segment without multicast crossing segment boundaries.
+ *
+ *  Each hub is identified by the uuid of its RootDevice and owns a version number that is incremented whenever a
+ *  sweep changes its record set. Every hub keeps a version vector, the latest version it holds for each known hub,
+ *  and synchronization is anti-entropy over that vector:
+ *
+ *    FED-SYNC * LSC/1.0              Sent to each peer every sync interval
+ *    HUB: hub-uuid                   Sending hub
+ *    VV: uuid=version,uuid=version   Complete versions held by the sending hub
+ *
+ *    FED-DELTA * LSC/1.0             Sent in reply to FED-SYNC for each hub where the receiver holds a newer version
+ *    HUB: hub-uuid                   Sending hub
+ *    ORIGIN: origin-uuid             Hub that produced the records
+ *    VERSION: version                Origin version of the records
+ *    PART: i/n                       Part i of n, records of one origin version may span several packets
+ *    REC: usn<TAB>location<TAB>desc  One line per record, repeated
+ *
+ *  A hub that receives FED-SYNC from a peer holding newer versions replies with its own FED-SYNC, so records flow in
+ *  both directions from a single exchange. A newer origin version replaces all records from that origin; a version is
+ *  only advertised once all of its parts have arrived, so a lost part is requested again on the next exchange.
+ *
+ *  Records are never expired by age, they are superseded by the next version from their origin. A hub starts again at
+ *  version 0 on restart, so it takes its version from the largest version peers report for it in FED-SYNC plus one,
+ *  and peers accept its records again. Hubs can be run on the same host by giving each a distinct port in begin() and
+ *  adding the others as peers on the loopback address, or on caller supplied channels with begin(root,channel,port).
+ */
+
+#ifndef FEDERATION_H
+#define FEDERATION_H
+
+#include "ssdp.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef FED_MAX_RECORDS
+#define FED_MAX_RECORDS     32
+#endif
+#ifndef FED_MAX_HUBS
+#define FED_MAX_HUBS        8
+#endif
+#ifndef FED_MAX_PEERS
+#define FED_MAX_PEERS       8
+#endif
+
+#define FED_PORT            1901                // Default unicast UDP port for hub exchange
+#define FED_USN_SIZE        SSDP_USN_SIZE
+#define FED_LOC_SIZE        SSDP_LOCATION_SIZE
+#define FED_DESC_SIZE       SSDP_DESC_SIZE
+#define FED_SYNC_INTERVAL   30000               // Milliseconds between FED-SYNC to each peer
+#define FED_SWEEP_HUB       0xFF                // Hub of records collected by a sweep in progress
+
+class Federation;
+
+/** FederationRecord class definition
+ *  A single SSDP response (RootDevice, embedded UPnPDevice or UPnPService) held by a hub.
+ *  Class members are as follows:
+ *    usn()          := USN header of the response, uuid:device-UUID::urn:domain-name:device:deviceType:ver
+ *    location()     := LOCATION header of the response
+ *    desc()         := DESC.LEELANAUSOFTWARE.COM header of the response
+ *    hub()          := Index into the Federation version vector of the hub that discovered this record, or
+ *                      FED_SWEEP_HUB for a record of a sweep in progress
+ *    isRootDevice() := Returns true if the record describes a RootDevice (no :puuid: field)
+ *    matches(st)    := Returns true if the record would answer an SSDP search for ST
+ */
+class FederationRecord {
+  public:
+    const char*     usn()                 {return _usn;}
+    const char*     location()            {return _location;}
+    const char*     desc()                {return _desc;}
+    int             hub()                 {return _hub;}
+    boolean         isRootDevice()        {return (strstr(_desc,":puuid:") == NULL);}
+    boolean         matches(const char* st);
+
+  private:
+    uint8_t         _hub = 0;
+    char            _usn[FED_USN_SIZE];
+    char            _location[FED_LOC_SIZE];
+    char            _desc[FED_DESC_SIZE];
+
+    friend class    Federation;
+};
+
+typedef std::function<void(FederationRecord*)> FederationHandler;
+
+/** Federation class definition
+ *  Class members are as follows:
+ *    begin(root,port)        := Start listening for hub exchange on port, hub identity is the uuid of root
+ *    begin(root,channel,port):= As above, exchanging records over the caller supplied UDP channel
+ *    addPeer(addr,port)      := Add a hub to exchange records with, up to FED_MAX_PEERS
+ *    doFederation()          := Called in the Arduino loop(); reads the hub channel and sends FED-SYNC every sync interval
+ *    sweep(ifc,timeout)      := Perform an SSDP ssdp:all search on ifc and publish the results as a new version of this hub
+ *    sweep(ssdp,timeout)     := As above, without blocking, as a search session of the responder ssdp on every interface.
+ *                               Results are published from ssdp.doSSDP() when the session ends. Returns SSDP_ERR_BUSY
+ *                               if a sweep is already running
+ *    sweeping()              := True while a sweep(ssdp,timeout) session is running
+ *    beginSweep()            := Start collecting a sweep, with sweepResponse(b) called on each search response and
+ *    sweepResponse(b)           endSweep(result) called with the search result. Records are only replaced by the
+ *    endSweep(result)           sweep if result is SSDP_OK; sweep() is these three around SSDP::searchRequest()
+ *    query(st,handler)       := Call handler on each record, from every hub, matching the search target st
+ *    numRecords()/record(i)  := Access records held by this hub
+ *    numHubs()/hubUUID(i)    := Access the version vector, hub 0 is always this hub
+ *    hubVersion(i)           := Complete version held for hub i
+ *    sync()                  := Send FED-SYNC to all peers immediately
+ */
+class Federation {
+  public:
+    Federation() {}
+    virtual ~Federation();
+
+    void               begin(RootDevice* root, int port=FED_PORT);
+    void               begin(RootDevice* root, UDP* channel, int port=FED_PORT);
+    boolean            addPeer(IPAddress addr, int port=FED_PORT);
+    void               doFederation();
+    SSDPResult         sweep(IPAddress ifc, int timeout=2000);
+    SSDPResult         sweep(SSDP* ssdp, int timeout=2000);
+    boolean            sweeping()                          {return _sweeping;}
+    void               beginSweep();
+    void               sweepResponse(UPnPBuffer* b);
+    void               endSweep(SSDPResult result);
+    void               query(const char* st, FederationHandler handler);
+    void               sync();
+
+    int                numRecords()                        {return _numRecords;}
+    FederationRecord*  record(int i)                       {return (((i<_numRecords)&&(i>=0))?(&_records[i]):(NULL));}
+    int                numHubs()                           {return _numHubs;}
+    const char*        hubUUID(int i)                      {return (((i<_numHubs)&&(i>=0))?(_hubs[i].uuid):(NULL));}
+    uint32_t           hubVersion(int i)                   {return (((i<_numHubs)&&(i>=0))?(completeVersion(i)):(0));}
+    int                getPort()                           {return _port;}
+    void               setSyncInterval(unsigned long ms)   {_syncInterval = ms;}
+
+  private:
+
+/**
+ *  Version vector entry. parts is a bit mask of the parts received for version, and numParts is the number
+ *  of parts expected. A version is complete once all of its parts have been received.
+ */
+    typedef struct {
+      char          uuid[UUID_SIZE];
+      uint32_t      version;
+      uint32_t      parts;
+      uint8_t       numParts;
+    } Hub;
+
+    typedef struct {
+      IPAddress     addr;
+      int           port;
+    } Peer;
+
+    RootDevice*        _root = NULL;
+    WiFiUDP            _wifiUdp;
+    UDP*               _udp = &_wifiUdp;               // Channel in use, _wifiUdp unless begin() was given a channel
+    int                _port = FED_PORT;
+    unsigned long      _syncInterval = FED_SYNC_INTERVAL;
+    unsigned long      _lastSync = 0;
+    uint32_t           _digest = 0;                    // Digest of this hub's record set, used to decide if a sweep changed anything
+    uint32_t           _peerVersion = 0;               // Largest version of this hub held by a peer, so versions continue across restarts
+    SSDP*              _ssdp = NULL;                   // Responder running the sweep session, while _sweeping
+    int                _sweepID = -1;
+    boolean            _sweeping = false;
+
+    FederationRecord   _records[FED_MAX_RECORDS];
+    int                _numRecords = 0;
+    Hub                _hubs[FED_MAX_HUBS];
+    int                _numHubs = 0;
+    Peer               _peers[FED_MAX_PEERS];
+    int                _numPeers = 0;
+
+    uint32_t           completeVersion(int hub);
+    int                hubIndex(const char* uuid, boolean add);
+    void               removeRecords(int hub);
+    boolean            addRecord(int hub, const char* usn, const char* location, const char* desc);
+    uint32_t           digest(int hub);
+
+    void               readChannel();
+    void               handleSync(UPnPBuffer& buffer, IPAddress addr, int port);
+    void               handleDelta(UPnPBuffer& buffer);
+    void               sendSync(IPAddress addr, int port);
+    void               sendDelta(int hub, IPAddress addr, int port);
+    int                packDelta(int hub, int start, char buffer[], int size, int part, int numParts);
+    boolean            send(const char* buffer, IPAddress addr, int port);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(Federation);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,55 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "Footprint.h"
+
+namespace lsc {
+
+static const char* const _kindNames[FOOTPRINT_KINDS] = {"object","static","stack","heap"};
+
+const char* Footprint::kindName(FootprintKind kind) {return (((kind>=0)&&(kind<FOOTPRINT_KINDS))?(_kindNames[kind]):(""));}
+
+void Footprint::print(FootprintSource source) {
+  uint32_t totals[FOOTPRINT_KINDS] = {0};
+  Serial.printf("%-7s %-52s %5s %7s %8s\n","Kind","Name","Count","Size","Bytes");
+  source([&totals](FootprintKind kind, const char* name, uint32_t count, uint32_t size) {
+    Serial.printf("%-7s %-52s %5u %7u %8u\n",kindName(kind),name,count,size,count*size);
+    if( (kind>=0) && (kind<FOOTPRINT_KINDS) ) totals[kind] += count*size;
+  });
+  Serial.printf("Objects %u bytes, static tables %u bytes, measured heap %u bytes, total %u bytes\n",
+                totals[FOOTPRINT_OBJECT],totals[FOOTPRINT_STATIC],totals[FOOTPRINT_HEAP],
+                totals[FOOTPRINT_OBJECT]+totals[FOOTPRINT_STATIC]+totals[FOOTPRINT_HEAP]);
+}
+
+/**
+ *  Names are type URNs and library names, without quotes or backslashes, so they are written as label values as is
+ */
+void Footprint::formatMetrics(MetricsWriter& w, const char* family, FootprintSource source) {
+  w.family(family,"gauge","Memory footprint in bytes by kind and part");
+  source([&w,family](FootprintKind kind, const char* name, uint32_t count, uint32_t size) {
+    char labels[128];
+    snprintf(labels,sizeof(labels),"kind=\"%s\",name=\"%s\"",kindName(kind),name);
+    w.sample(family,labels,(uint64_t)count*size);
+  });
+}
+
+} // End of namespace lsc
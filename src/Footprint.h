@@ -0,0 +1,81 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * Footprint.h
+ *
+ *  Memory footprint reports. RootDevice::footprint() and SSDP::footprint() hand each part of their footprint to a
+ *  visitor, as a kind, a name, a count and a size in bytes of each:
+ *
+ *    object   Objects of a type in the device hierarchy, or the SSDP instance, sized by objectSize()
+ *    static   Static tables of the library, present whether or not objects exist
+ *    stack    Stack buffers of an operation, the floor of its stack use (StackProfiler measures the whole)
+ *    heap     Heap taken by an operation, measured as the drop in free heap across it
+ *
+ *  Reports can be printed, one table for the whole sketch:
+ *
+ *    Footprint::print([](FootprintVisitor v){root.footprint(v); ssdp.footprint(v);});
+ *
+ *  and are on the RootDevice metrics page.
+ */
+
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include <Arduino.h>
+#include <functional>
+#include "MetricsWriter.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+typedef enum {
+  FOOTPRINT_OBJECT = 0,
+  FOOTPRINT_STATIC,
+  FOOTPRINT_STACK,
+  FOOTPRINT_HEAP,
+  FOOTPRINT_KINDS
+} FootprintKind;
+
+typedef std::function<void(FootprintKind kind, const char* name, uint32_t count, uint32_t size)> FootprintVisitor;
+typedef std::function<void(FootprintVisitor v)>                                                  FootprintSource;
+
+/** Footprint class definition
+ *  Class members are as follows:
+ *    kindName(kind)                  := "object", "static", "stack" or "heap"
+ *    print(source)                   := Print each part from source to Serial, with totals of object, static and heap
+ *                                       bytes. Stack parts are not added, since operations do not run at once
+ *    formatMetrics(w,family,source)  := Write each part from source as a sample of the gauge family, in bytes with
+ *                                       kind and name labels
+ */
+class Footprint {
+  public:
+    static const char*  kindName(FootprintKind kind);
+    static void         print(FootprintSource source);
+    static void         formatMetrics(MetricsWriter& w, const char* family, FootprintSource source);
+};
+
+} // End of namespace lsc
+
+#endif
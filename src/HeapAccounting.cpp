@@ -0,0 +1,181 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "HeapAccounting.h"
+
+namespace lsc {
+
+static const char* const _scopeNames[HEAP_SCOPES] = {"other","setup","ssdp_receive","ssdp_response","ssdp_search","http"};
+
+const char* HeapAccounting::name(HeapScope scope) {return (((scope>=0)&&(scope<HEAP_SCOPES))?(_scopeNames[scope]):(""));}
+
+#if HEAP_ACCOUNTING
+
+HeapStats          HeapAccounting::_stats[HEAP_SCOPES];
+uint32_t           HeapAccounting::_visit[HEAP_SCOPES];
+volatile uint8_t   HeapAccounting::_scope      = HEAP_OTHER;
+uint32_t           HeapAccounting::_forbidden  = 0;
+boolean            HeapAccounting::_strict     = false;
+uint32_t           HeapAccounting::_violations = 0;
+
+HeapScope HeapAccounting::enter(HeapScope scope) {
+  HeapScope previous = (HeapScope)_scope;
+  _visit[scope] = 0;
+  _scope        = scope;
+  return previous;
+}
+
+void HeapAccounting::leave(HeapScope previous) {
+  HeapStats& s = _stats[_scope];
+  if( _visit[_scope] > s.peak ) s.peak = _visit[_scope];
+  _scope = previous;
+}
+
+void HeapAccounting::forbid(HeapScope scope, boolean flag) {
+  if( flag ) _forbidden |= (1 << scope);
+  else _forbidden &= ~(1 << scope);
+}
+
+void              HeapAccounting::setStrict(boolean flag)   {_strict = flag;}
+const HeapStats&  HeapAccounting::stats(HeapScope scope)    {return _stats[(((scope>=0)&&(scope<HEAP_SCOPES))?(scope):(HEAP_OTHER))];}
+uint32_t          HeapAccounting::violations()              {return _violations;}
+
+void HeapAccounting::reset() {
+  memset(_stats,0,sizeof(_stats));
+  memset(_visit,0,sizeof(_visit));
+  _violations = 0;
+}
+
+/**
+ *  Hooks run inside the allocator, so they only count; they must not allocate, print or call back
+ */
+void HeapAccounting::allocated(size_t size) {
+  uint8_t    scope = _scope;
+  HeapStats& s     = _stats[scope];
+  s.allocs++;
+  s.bytes       += size;
+  _visit[scope] += size;
+  if( _forbidden & (1 << scope) ) {
+    s.violations++;
+    _violations++;
+    if( _strict ) abort();
+  }
+}
+
+void HeapAccounting::released() {_stats[_scope].frees++;}
+
+void HeapAccounting::formatMetrics(MetricsWriter& w) {
+  char labels[32];
+  w.family("lsc_heap_allocs_total","counter","Heap allocations by library scope");
+  for( int i=0; i<HEAP_SCOPES; i++ ) {
+    snprintf(labels,sizeof(labels),"scope=\"%s\"",_scopeNames[i]);
+    w.sample("lsc_heap_allocs_total",labels,_stats[i].allocs);
+  }
+  w.family("lsc_heap_frees_total","counter","Heap frees by library scope");
+  for( int i=0; i<HEAP_SCOPES; i++ ) {
+    snprintf(labels,sizeof(labels),"scope=\"%s\"",_scopeNames[i]);
+    w.sample("lsc_heap_frees_total",labels,_stats[i].frees);
+  }
+  w.family("lsc_heap_alloc_bytes_total","counter","Heap bytes requested by library scope");
+  for( int i=0; i<HEAP_SCOPES; i++ ) {
+    snprintf(labels,sizeof(labels),"scope=\"%s\"",_scopeNames[i]);
+    w.sample("lsc_heap_alloc_bytes_total",labels,_stats[i].bytes);
+  }
+  w.family("lsc_heap_scope_peak_bytes","gauge","Most heap bytes requested in a single visit to a scope");
+  for( int i=0; i<HEAP_SCOPES; i++ ) {
+    snprintf(labels,sizeof(labels),"scope=\"%s\"",_scopeNames[i]);
+    w.sample("lsc_heap_scope_peak_bytes",labels,_stats[i].peak);
+  }
+  w.counter("lsc_heap_violations_total","Allocations in forbidden scopes",_violations);
+}
+
+#else
+
+HeapScope         HeapAccounting::enter(HeapScope scope)                {return HEAP_OTHER;}
+void              HeapAccounting::leave(HeapScope previous)             {}
+void              HeapAccounting::forbid(HeapScope scope, boolean flag) {}
+void              HeapAccounting::setStrict(boolean flag)               {}
+const HeapStats&  HeapAccounting::stats(HeapScope scope)                {static HeapStats empty = HeapStats(); return empty;}
+uint32_t          HeapAccounting::violations()                          {return 0;}
+void              HeapAccounting::reset()                               {}
+void              HeapAccounting::formatMetrics(MetricsWriter& w)       {}
+void              HeapAccounting::allocated(size_t size)                {}
+void              HeapAccounting::released()                            {}
+
+#endif
+
+} // End of namespace lsc
+
+#if HEAP_ACCOUNTING
+
+/**
+ *  Allocator hooks, the SDK heap hooks on ESP32 when it has them, and otherwise wrappers for the linker --wrap option
+ */
+#if defined(ESP32) && defined(CONFIG_HEAP_USE_HOOKS)
+
+extern "C" void esp_heap_trace_alloc_hook(void* ptr, size_t size, uint32_t caps) {lsc::HeapAccounting::allocated(size);}
+extern "C" void esp_heap_trace_free_hook(void* ptr)                               {lsc::HeapAccounting::released();}
+
+#else
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void  __real_free(void* ptr);
+void* __real_realloc(void* ptr, size_t size);
+void* __real_calloc(size_t n, size_t size);
+
+void* __wrap_malloc(size_t size) {
+  void* ptr = __real_malloc(size);
+  if( ptr != NULL ) lsc::HeapAccounting::allocated(size);
+  return ptr;
+}
+
+void __wrap_free(void* ptr) {
+  if( ptr != NULL ) lsc::HeapAccounting::released();
+  __real_free(ptr);
+}
+
+/**
+ *  A realloc that succeeds is counted as an allocation of the new size, and as a free of the block it replaces
+ */
+void* __wrap_realloc(void* ptr, size_t size) {
+  void* result = __real_realloc(ptr,size);
+  if( (result != NULL) && (size > 0) ) {
+    lsc::HeapAccounting::allocated(size);
+    if( ptr != NULL ) lsc::HeapAccounting::released();
+  }
+  else if( (ptr != NULL) && (size == 0) ) lsc::HeapAccounting::released();
+  return result;
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+  void* ptr = __real_calloc(n,size);
+  if( ptr != NULL ) lsc::HeapAccounting::allocated(n*size);
+  return ptr;
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,128 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * HeapAccounting.h
+ *
+ *  Heap allocation counters by library subsystem. Library paths enter a scope while they run, and every allocation
+ *  made while a scope is current, std::function captures, String temporaries, IPAddress::toString() and the like, is
+ *  counted against it. Allocations outside any scope are counted as "other". Scopes nest, and the innermost counts:
+ *
+ *    setup          RootDevice::setup() and SSDP::begin()
+ *    ssdp_receive   Reading and parsing a packet in SSDP::doSSDP()
+ *    ssdp_response  Formatting and sending responses
+ *    ssdp_search    Search requests and the handling of search responses
+ *    http           Handlers registered with RouteMetrics::on(), so device pages and service handlers
+ *
+ *  Allocations are seen through hooks on the allocator, so accounting is off unless the library is built with
+ *  HEAP_ACCOUNTING defined as 1, and the link must route the allocator through the hooks. On ESP8266, link with
+ *
+ *    -Wl,--wrap=malloc,--wrap=free,--wrap=realloc,--wrap=calloc
+ *
+ *  On ESP32, if the SDK is built with CONFIG_HEAP_USE_HOOKS, its heap hooks are used and no link flags are needed; 
+ *  otherwise link as above.
+ *
+ *  For tests, forbid(scope) marks allocation in a scope as a violation, and setStrict(true) aborts on the first one, 
+ *  so a hot path that starts to allocate fails with a stack trace at the allocation:
+ *
+ *    HeapAccounting::forbid(HEAP_SSDP_RECEIVE);
+ *    HeapAccounting::setStrict(true);
+ */
+
+#ifndef HEAP_ACCOUNTING_H
+#define HEAP_ACCOUNTING_H
+
+#include <Arduino.h>
+#include "MetricsWriter.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef HEAP_ACCOUNTING
+#define HEAP_ACCOUNTING      0
+#endif
+
+typedef enum {
+  HEAP_OTHER = 0,
+  HEAP_SETUP,
+  HEAP_SSDP_RECEIVE,
+  HEAP_SSDP_RESPONSE,
+  HEAP_SSDP_SEARCH,
+  HEAP_HTTP,
+  HEAP_SCOPES
+} HeapScope;
+
+/** HeapStats
+ *  Allocations counted against one scope since start up or HeapAccounting::reset()
+ */
+typedef struct {
+  uint32_t       allocs;
+  uint32_t       frees;
+  uint64_t       bytes;                         // Bytes requested
+  uint32_t       peak;                          // Most bytes requested in a single visit to the scope
+  uint32_t       violations;                    // Allocations while the scope was forbidden
+} HeapStats;
+
+/** HeapAccounting class definition
+ *  Class members are as follows:
+ *    enter(scope)          := Make scope current and return the scope it replaces, to pass to leave()
+ *    leave(previous)       := Leave the current scope and restore previous
+ *    forbid(scope,flag)    := Count allocations in scope as violations, or stop doing so
+ *    setStrict(flag)       := Abort on a violation
+ *    stats(scope)          := Counters of scope
+ *    violations()          := Violations in all scopes
+ *    name(scope)           := Metric label of scope
+ *    reset()               := Clear counters
+ *    formatMetrics(w)      := Write counters in the Prometheus text format
+ *    allocated(size)       := Allocator hook, count an allocation of size bytes in the current scope
+ *    released()            := Allocator hook, count a free in the current scope
+ */
+class HeapAccounting {
+  public:
+    static HeapScope         enter(HeapScope scope);
+    static void              leave(HeapScope previous);
+    static void              forbid(HeapScope scope, boolean flag=true);
+    static void              setStrict(boolean flag);
+    static const HeapStats&  stats(HeapScope scope);
+    static uint32_t          violations();
+    static const char*       name(HeapScope scope);
+    static void              reset();
+    static void              formatMetrics(MetricsWriter& w);
+    static void              allocated(size_t size);
+    static void              released();
+
+#if HEAP_ACCOUNTING
+  private:
+    static HeapStats         _stats[HEAP_SCOPES];
+    static uint32_t          _visit[HEAP_SCOPES];    // Bytes requested in the current visit to each scope
+    static volatile uint8_t  _scope;
+    static uint32_t          _forbidden;             // Bit per scope
+    static boolean           _strict;
+    static uint32_t          _violations;
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,38 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "Histogram.h"
+
+namespace lsc {
+
+uint32_t Histogram::percentile(int p) const {
+  if( _count == 0 ) return 0;
+  uint32_t rank = (uint32_t)(((uint64_t)_count * p + 99) / 100);
+  uint32_t seen = 0;
+  for( int i=0; i<HISTOGRAM_BUCKETS-1; i++ ) {
+    seen += _buckets[i];
+    if( seen >= rank ) return bound(i);
+  }
+  return _max;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,88 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * Histogram.h
+ *
+ *  Fixed bucket latency histogram. Bucket 0 counts values below HISTOGRAM_FIRST, each following bucket is twice as wide
+ *  as the one before, and the last bucket counts everything above. Adding a value is a count leading zeros and an 
+ *  increment, so histograms can be kept on hot paths, and they never allocate. Values are microseconds, except where
+ *  the owner says otherwise (search times are in milliseconds):
+ *
+ *    Bucket        0      1       2       3      ...   10              11
+ *    Range (us)   0-15  16-31   32-63   64-127   ...  8192-16383   16384 and above
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <Arduino.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define HISTOGRAM_BUCKETS  12
+#define HISTOGRAM_FIRST    16                   // Upper bound of bucket 0
+
+/** Histogram class definition
+ *  Class members are as follows:
+ *    add(v)           := Count a value
+ *    addCycles(c)     := Count a value in CPU cycles, converted at the current CPU frequency
+ *    count()          := Number of values counted
+ *    sum()            := Sum of values counted
+ *    max()            := Largest value counted
+ *    bucket(i)        := Count in bucket i, for 0 <= i < HISTOGRAM_BUCKETS
+ *    bound(i)         := Upper bound of bucket i (exclusive), 0 for the last bucket, which is unbounded
+ *    percentile(p)    := Upper bound of the bucket holding the p'th percentile value, or max() if that is the last bucket
+ *    reset()          := Clear all counts
+ */
+class Histogram {
+  public:
+    void             add(uint32_t us) {
+      int i = ((us < HISTOGRAM_FIRST)?(0):(32 - __builtin_clz(us) - 4));
+      _buckets[((i < HISTOGRAM_BUCKETS)?(i):(HISTOGRAM_BUCKETS-1))]++;
+      _count++;
+      _sum += us;
+      if( us > _max ) _max = us;
+    }
+    void             addCycles(uint32_t cycles)    {add(cycles/ESP.getCpuFreqMHz());}
+
+    uint32_t         count()  const                {return _count;}
+    uint64_t         sum()    const                {return _sum;}
+    uint32_t         max()    const                {return _max;}
+    uint32_t         bucket(int i) const           {return (((i>=0)&&(i<HISTOGRAM_BUCKETS))?(_buckets[i]):(0));}
+    static uint32_t  bound(int i)                  {return ((i<HISTOGRAM_BUCKETS-1)?(HISTOGRAM_FIRST << i):(0));}
+    uint32_t         percentile(int p) const;
+    void             reset()                       {memset(_buckets,0,sizeof(_buckets)); _count = 0; _sum = 0; _max = 0;}
+
+  private:
+    uint32_t         _buckets[HISTOGRAM_BUCKETS] = {0};
+    uint32_t         _count = 0;
+    uint32_t         _max = 0;
+    uint64_t         _sum = 0;
+};
+
+} // End of namespace lsc
+
+#endif
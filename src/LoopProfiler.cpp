@@ -0,0 +1,169 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "LoopProfiler.h"
+
+namespace lsc {
+
+#if LOOP_PROFILER
+
+LoopComponent LoopProfiler::_components[LOOP_MAX_COMPONENTS];
+int           LoopProfiler::_numComponents = 0;
+boolean       LoopProfiler::_enabled       = false;
+uint32_t      LoopProfiler::_threshold     = LOOP_STALL_US;
+boolean       LoopProfiler::_started       = false;
+uint32_t      LoopProfiler::_passStart     = 0;
+uint32_t      LoopProfiler::_passTime      = 0;
+uint32_t      LoopProfiler::_passMax       = 0;
+int           LoopProfiler::_passMaxId     = -1;
+Histogram     LoopProfiler::_passes;
+uint32_t      LoopProfiler::_stalls        = 0;
+uint32_t      LoopProfiler::_otherStalls   = 0;
+uint32_t      LoopProfiler::_lastStall     = 0;
+uint32_t      LoopProfiler::_lastStallAt   = 0;
+
+/**
+ *  Enabling starts a new pass, so time spent while disabled is not counted as a stall
+ */
+void LoopProfiler::enable(boolean flag) {
+  _enabled = flag;
+  _started = false;
+}
+
+boolean LoopProfiler::enabled()                       {return _enabled;}
+void    LoopProfiler::setStallThreshold(uint32_t us)  {_threshold = us;}
+
+int LoopProfiler::begin(const char* name) {
+  if( !_enabled || (name == NULL) ) return -1;
+  for( int i=0; i<_numComponents; i++ ) {if( strncmp(_components[i].name,name,LOOP_NAME_SIZE-1) == 0 ) return i;}
+  if( _numComponents >= LOOP_MAX_COMPONENTS ) return -1;
+  strlcpy(_components[_numComponents].name,name,LOOP_NAME_SIZE);
+  return _numComponents++;
+}
+
+void LoopProfiler::end(int id, uint32_t start) {
+  if( (id < 0) || (id >= _numComponents) ) return;
+  uint32_t us = micros() - start;
+  _components[id].time.add(us);
+  _passTime += us;
+  if( us > _passMax ) {
+    _passMax   = us;
+    _passMaxId = id;
+  }
+}
+
+/**
+ *  Time the pass that just ended and blame a stall on its largest component. Components can nest, RootDevice::doDevice()
+ *  run inside a timed section for example, so time outside of components is an estimate and never negative.
+ */
+void LoopProfiler::loop() {
+  if( !_enabled ) return;
+  uint32_t now = micros();
+  if( _started ) {
+    uint32_t pass  = now - _passStart;
+    uint32_t other = ((pass > _passTime)?(pass - _passTime):(0));
+    _passes.add(pass);
+    if( pass > _threshold ) {
+      _stalls++;
+      _lastStall   = pass;
+      _lastStallAt = millis();
+      if( (_passMaxId < 0) || (other > _passMax) ) _otherStalls++;
+      else _components[_passMaxId].stalls++;
+    }
+  }
+  _started   = true;
+  _passStart = now;
+  _passTime  = 0;
+  _passMax   = 0;
+  _passMaxId = -1;
+}
+
+int                  LoopProfiler::numComponents()  {return _numComponents;}
+const LoopComponent* LoopProfiler::component(int i) {return (((i>=0)&&(i<_numComponents))?(&_components[i]):(NULL));}
+const Histogram&     LoopProfiler::passes()         {return _passes;}
+uint32_t             LoopProfiler::stalls()         {return _stalls;}
+uint32_t             LoopProfiler::otherStalls()    {return _otherStalls;}
+uint32_t             LoopProfiler::lastStall()      {return _lastStall;}
+uint32_t             LoopProfiler::lastStallAt()    {return _lastStallAt;}
+
+void LoopProfiler::reset() {
+  for( int i=0; i<_numComponents; i++ ) {
+    _components[i].stalls = 0;
+    _components[i].time.reset();
+  }
+  _passes.reset();
+  _stalls      = 0;
+  _otherStalls = 0;
+  _lastStall   = 0;
+  _lastStallAt = 0;
+  _started     = false;
+}
+
+void LoopProfiler::formatMetrics(MetricsWriter& w) {
+  char labels[LOOP_NAME_SIZE + 16];
+  if( _passes.count() == 0 ) return;
+  w.family("lsc_loop_pass_seconds","histogram","Time between loop passes");
+  w.histogram("lsc_loop_pass_seconds",NULL,_passes,METRICS_US);
+  w.family("lsc_loop_stall_threshold_seconds","gauge","Passes longer than this are counted as stalls");
+  w.sample("lsc_loop_stall_threshold_seconds",NULL,"%u.%06u",_threshold/1000000,_threshold%1000000);
+  w.family("lsc_loop_stalls_total","counter","Stalled passes by the component that took the most time");
+  for( int i=0; i<_numComponents; i++ ) {
+    snprintf(labels,sizeof(labels),"component=\"%s\"",_components[i].name);
+    w.sample("lsc_loop_stalls_total",labels,_components[i].stalls);
+  }
+  w.sample("lsc_loop_stalls_total","component=\"other\"",_otherStalls);
+  w.family("lsc_loop_last_stall_seconds","gauge","Length of the last stalled pass");
+  w.sample("lsc_loop_last_stall_seconds",NULL,"%u.%06u",_lastStall/1000000,_lastStall%1000000);
+  w.family("lsc_loop_component_max_seconds","gauge","Longest call by component");
+  for( int i=0; i<_numComponents; i++ ) {
+    uint32_t us = _components[i].time.max();
+    snprintf(labels,sizeof(labels),"component=\"%s\"",_components[i].name);
+    w.sample("lsc_loop_component_max_seconds",labels,"%u.%06u",us/1000000,us%1000000);
+  }
+  w.family("lsc_loop_component_seconds","histogram","Time per call by component");
+  for( int i=0; i<_numComponents; i++ ) {
+    snprintf(labels,sizeof(labels),"component=\"%s\"",_components[i].name);
+    w.histogram("lsc_loop_component_seconds",labels,_components[i].time,METRICS_US);
+  }
+}
+
+#else
+
+void                 LoopProfiler::enable(boolean flag)             {}
+boolean              LoopProfiler::enabled()                        {return false;}
+void                 LoopProfiler::setStallThreshold(uint32_t us)   {}
+int                  LoopProfiler::begin(const char* name)          {return -1;}
+void                 LoopProfiler::end(int id, uint32_t start)      {}
+void                 LoopProfiler::loop()                           {}
+int                  LoopProfiler::numComponents()                  {return 0;}
+const LoopComponent* LoopProfiler::component(int i)                 {return NULL;}
+const Histogram&     LoopProfiler::passes()                         {static Histogram empty; return empty;}
+uint32_t             LoopProfiler::stalls()                         {return 0;}
+uint32_t             LoopProfiler::otherStalls()                    {return 0;}
+uint32_t             LoopProfiler::lastStall()                      {return 0;}
+uint32_t             LoopProfiler::lastStallAt()                    {return 0;}
+void                 LoopProfiler::reset()                          {}
+void                 LoopProfiler::formatMetrics(MetricsWriter& w)  {}
+
+#endif
+
+} // End of namespace lsc
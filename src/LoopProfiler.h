@@ -0,0 +1,137 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * LoopProfiler.h
+ *
+ *  Opt-in profiler of the Arduino loop. Time spent in each component of a loop pass, each embedded device's doDevice(), 
+ *  SSDP::doSSDP() and the web server, is attributed to the component by name, and each pass is timed as a whole. A pass
+ *  longer than the stall threshold is counted as a stall, and blamed on the component that took the most time in that
+ *  pass, or on "other" if time outside any component was larger. RootDevice::doDevice() times its devices and marks 
+ *  the start of each pass, and SSDP::doSSDP() times itself; the web server is timed by the sketch:
+ *
+ *    void loop() {
+ *      int      probe = LoopProfiler::begin("http");
+ *      uint32_t start = micros();
+ *      ctx.handleClient();
+ *      LoopProfiler::end(probe,start);
+ *      ssdp.doSSDP();
+ *      root.doDevice();
+ *    }
+ *
+ *  Sketches without a RootDevice call LoopProfiler::loop() once per pass. Nothing is recorded until enable() is called,
+ *  and statistics appear on the RootDevice metrics page. Build with LOOP_PROFILER defined as 0 to remove the profiler.
+ */
+
+#ifndef LOOP_PROFILER_H
+#define LOOP_PROFILER_H
+
+#include <Arduino.h>
+#include "Histogram.h"
+#include "MetricsWriter.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef LOOP_PROFILER
+#define LOOP_PROFILER        1
+#endif
+
+#ifndef LOOP_MAX_COMPONENTS
+#define LOOP_MAX_COMPONENTS  12
+#endif
+
+#ifndef LOOP_STALL_US
+#define LOOP_STALL_US        50000              // Default stall threshold, a pass longer than this is visible in a web UI
+#endif
+
+#define LOOP_NAME_SIZE       24                 // Longer names are kept truncated, and share statistics if they agree that far
+
+/** LoopComponent
+ *  Statistics of one component since enable() or reset(). Total time is time.sum() and the longest call is time.max()
+ */
+typedef struct {
+  char           name[LOOP_NAME_SIZE];
+  uint32_t       stalls;                        // Stalled passes in which this component took the most time
+  Histogram      time;                          // Time per call in microseconds
+} LoopComponent;
+
+/** LoopProfiler class definition
+ *  Class members are as follows:
+ *    enable(flag)          := Start or stop profiling, stopping keeps statistics
+ *    enabled()             := True if profiling
+ *    setStallThreshold(us) := Passes longer than us microseconds are counted as stalls, default LOOP_STALL_US
+ *    begin(name)           := Returns the component id of name, adding it if needed, or -1 if not profiling or the
+ *                             component table is full
+ *    end(id,start)         := Count the time since start (from micros()) against component id, ignored for id -1
+ *    loop()                := Mark the start of a loop pass, timing the pass before it
+ *    numComponents()       := Number of components
+ *    component(i)          := Statistics of component i, or NULL if i is out of range
+ *    passes()              := Histogram of pass times in microseconds
+ *    stalls()              := Number of stalled passes
+ *    otherStalls()         := Stalled passes in which time outside of components was largest
+ *    lastStall()           := Length in microseconds of the last stalled pass, lastStallAt() its end in millis()
+ *    reset()               := Clear statistics, components stay registered
+ *    formatMetrics(w)      := Write loop metrics in the Prometheus text format, nothing if no pass has been timed
+ */
+class LoopProfiler {
+  public:
+    static void                  enable(boolean flag=true);
+    static boolean               enabled();
+    static void                  setStallThreshold(uint32_t us);
+    static int                   begin(const char* name);
+    static void                  end(int id, uint32_t start);
+    static void                  loop();
+    static int                   numComponents();
+    static const LoopComponent*  component(int i);
+    static const Histogram&      passes();
+    static uint32_t              stalls();
+    static uint32_t              otherStalls();
+    static uint32_t              lastStall();
+    static uint32_t              lastStallAt();
+    static void                  reset();
+    static void                  formatMetrics(MetricsWriter& w);
+
+#if LOOP_PROFILER
+  private:
+    static LoopComponent         _components[LOOP_MAX_COMPONENTS];
+    static int                   _numComponents;
+    static boolean               _enabled;
+    static uint32_t              _threshold;
+    static boolean               _started;           // True once a pass start has been marked
+    static uint32_t              _passStart;
+    static uint32_t              _passTime;          // Time attributed to components in the current pass
+    static uint32_t              _passMax;           // Largest component time in the current pass
+    static int                   _passMaxId;
+    static Histogram             _passes;
+    static uint32_t              _stalls;
+    static uint32_t              _otherStalls;
+    static uint32_t              _lastStall;
+    static uint32_t              _lastStallAt;
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
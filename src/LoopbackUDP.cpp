@@ -0,0 +1,96 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "LoopbackUDP.h"
+
+namespace lsc {
+
+LoopbackUDP::LoopbackUDP(int depth) {
+  _depth = ((depth < 1)?(1):((depth > LOOPBACK_MAX_DEPTH)?(LOOPBACK_MAX_DEPTH):(depth)));
+  _slots = new Slot[_depth];
+}
+
+boolean LoopbackUDP::inject(const char* packet, int len, IPAddress src, uint16_t port, uint32_t stamp) {
+  if( _count >= _depth ) return false;
+  Slot& s = _slots[(_head + _count) % _depth];
+  s.len   = ((len < LOOPBACK_PACKET_SIZE)?(len):(LOOPBACK_PACKET_SIZE));
+  memcpy(s.data,packet,s.len);
+  s.src   = src;
+  s.port  = port;
+  s.stamp = stamp;
+  _count++;
+  return true;
+}
+
+/**
+ *  The slot of the previous packet is released here, not when it is returned, since it is read until the next call
+ */
+int LoopbackUDP::parsePacket() {
+  _len = 0;
+  _pos = 0;
+  if( _reading ) {
+    _head    = (_head + 1) % _depth;
+    _count--;
+    _reading = false;
+  }
+  if( _count == 0 ) return 0;
+  _current    = _head;
+  _reading    = true;
+  Slot& s     = _slots[_current];
+  _len        = s.len;
+  _remote     = s.src;
+  _remotePort = s.port;
+  _stamp      = s.stamp;
+  return _len;
+}
+
+int LoopbackUDP::read() {
+  return ((available() > 0)?(_slots[_current].data[_pos++]):(-1));
+}
+
+int LoopbackUDP::read(unsigned char* buffer, size_t len) {
+  int n = available();
+  if( n > (int)len ) n = len;
+  if( n > 0 ) memcpy(buffer,_slots[_current].data + _pos,n);
+  _pos += n;
+  return n;
+}
+
+size_t LoopbackUDP::write(const uint8_t* buffer, size_t size) {
+  if( !_txActive ) return 0;
+  if( _txLen < LOOPBACK_PACKET_SIZE ) {
+    int n = LOOPBACK_PACKET_SIZE - _txLen;
+    if( n > (int)size ) n = size;
+    memcpy(_tx + _txLen,buffer,n);
+  }
+  _txLen += size;
+  return size;
+}
+
+int LoopbackUDP::endPacket() {
+  if( !_txActive ) return 0;
+  _txActive = false;
+  _onSend(_tx,_txLen);
+  return 1;
+}
+
+} // End of namespace lsc
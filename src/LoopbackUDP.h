@@ -0,0 +1,129 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * LoopbackUDP.h
+ *
+ *  In-memory UDP channel for driving an SSDP responder without a network, through
+ *  SSDP::begin(root,multicast,unicast,addr,mask). Packets are injected into a fixed depth receive queue, as the lwIP
+ *  receive mailbox would hold them, and are dropped when the queue is full. Sent packets are passed to the onSend()
+ *  function and discarded. Slots are allocated once in the constructor, so injecting and sending do not touch the heap.
+ *  The slot of the packet being read stays reserved until the next parsePacket(), so injecting into a full queue
+ *  can not overwrite it. This is a test harness for the loopback examples. UPnPLib.h does not include it; a sketch
+ *  includes <LoopbackUDP.h> itself, and sketches that do not use it link none of it.
+ */
+
+#ifndef LOOPBACK_UDP_H
+#define LOOPBACK_UDP_H
+
+#include <Arduino.h>
+#include <Udp.h>
+#include <functional>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define LOOPBACK_MAX_DEPTH    16
+#ifndef LOOPBACK_PACKET_SIZE
+#define LOOPBACK_PACKET_SIZE  1600              // Larger than the responder read buffer, so oversized packets can be offered
+#endif
+
+/** LoopbackUDP class definition
+ *  Class members are as follows:
+ *    inject(...)      := Queue a packet from src:port, stamped with the caller time stamp. Returns false if the queue
+ *                        is full and the packet was dropped. Packets longer than LOOPBACK_PACKET_SIZE are truncated
+ *    stamp()          := Stamp of the packet last returned by parsePacket()
+ *    queued()         := Number of packets waiting to be read, not counting the packet being read
+ *    clear()          := Discard queued packets
+ *    onSend(f)        := Function called on each endPacket() with the packet sent and its length. The packet is
+ *                        truncated at LOOPBACK_PACKET_SIZE but the length is not
+ *    sendIP()/sendPort():= Destination given to beginPacket(), so onSend() can deliver the packet to another channel
+ */
+class LoopbackUDP : public UDP {
+  public:
+    LoopbackUDP(int depth=8);
+    virtual ~LoopbackUDP()                              {delete[] _slots;}
+
+    boolean   inject(const char* packet, int len, IPAddress src, uint16_t port, uint32_t stamp);
+    uint32_t  stamp()                                   {return _stamp;}
+    int       queued()                                  {return _count - ((_reading)?(1):(0));}
+    void      clear()                                   {_count = 0; _len = 0; _pos = 0; _reading = false;}
+    void      onSend(std::function<void(const char*,int)> f)  {_onSend = f;}
+
+    uint8_t   begin(uint16_t port)                      {_port = port; return 1;}
+    void      stop()                                    {clear();}
+    int       beginPacket(IPAddress ip, uint16_t port)  {_txLen = 0; _txActive = true; _txAddr = ip; _txPort = port; return 1;}
+    int       beginPacket(const char* host, uint16_t port) {return beginPacket(IPAddress(),port);}
+    int       endPacket();
+    size_t    write(uint8_t b)                          {return write(&b,1);}
+    size_t    write(const uint8_t* buffer, size_t size);
+    int       parsePacket();
+    int       available()                               {return _len - _pos;}
+    int       read();
+    int       read(unsigned char* buffer, size_t len);
+    int       read(char* buffer, size_t len)            {return read((unsigned char*)buffer,len);}
+    int       peek()                                    {return ((available() > 0)?(_slots[_current].data[_pos]):(-1));}
+    void      flush()                                   {_pos = _len;}
+    IPAddress remoteIP()                                {return _remote;}
+    uint16_t  remotePort()                              {return _remotePort;}
+    IPAddress sendIP()                                  {return _txAddr;}
+    uint16_t  sendPort()                                {return _txPort;}
+
+    using     Print::write;
+
+  private:
+    typedef struct {
+      char       data[LOOPBACK_PACKET_SIZE];
+      int        len;
+      IPAddress  src;
+      uint16_t   port;
+      uint32_t   stamp;
+    } Slot;
+
+    Slot*                       _slots;
+    int                         _depth;
+    int                         _head = 0;                   // Next slot to read
+    int                         _count = 0;
+    int                         _current = 0;                // Slot of the packet being read
+    boolean                     _reading = false;            // True while _current holds the packet being read
+    int                         _len = 0;
+    int                         _pos = 0;
+    IPAddress                   _remote;
+    uint16_t                    _remotePort = 0;
+    uint32_t                    _stamp = 0;
+    uint16_t                    _port = 0;
+    boolean                     _txActive = false;
+    char                        _tx[LOOPBACK_PACKET_SIZE];
+    int                         _txLen = 0;
+    IPAddress                   _txAddr;
+    uint16_t                    _txPort = 0;
+    std::function<void(const char*,int)>  _onSend = [](const char*,int){};
+
+    LoopbackUDP(const LoopbackUDP&)= delete;
+    LoopbackUDP& operator=(const LoopbackUDP&)= delete;
+};
+
+} // End of namespace lsc
+
+#endif
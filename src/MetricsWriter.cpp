@@ -0,0 +1,173 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "MetricsWriter.h"
+
+namespace lsc {
+
+static uint32_t familyHash(const char* name) {
+  uint32_t h = 2166136261UL;
+  for( const char* c=name; *c; c++ ) {h ^= (uint8_t)*c; h *= 16777619UL;}
+  return h;
+}
+
+/**
+ *  A line that does not fit in the space left is written again after a flush. A line longer than the buffer is 
+ *  truncated.
+ */
+void MetricsWriter::vprintf(const char* fmt, va_list args) {
+  if( _collecting || ((_only != 0) && (_current != _only)) ) return;
+  va_list retry;
+  va_copy(retry,args);
+  int n = vsnprintf(_buffer+_len,METRICS_BUFFER_SIZE-_len,fmt,args);
+  if( (n >= METRICS_BUFFER_SIZE-_len) && (_len > 0) ) {
+    _buffer[_len] = '\0';
+    flush();
+    n = vsnprintf(_buffer,METRICS_BUFFER_SIZE,fmt,retry);
+  }
+  va_end(retry);
+  if( n > 0 ) _len += ((n < METRICS_BUFFER_SIZE-_len)?(n):(METRICS_BUFFER_SIZE-_len-1));
+}
+
+void MetricsWriter::printf(const char* fmt, ...) {
+  va_list args;
+  va_start(args,fmt);
+  vprintf(fmt,args);
+  va_end(args);
+}
+
+void MetricsWriter::flush() {
+  if( _len == 0 ) return;
+  _sink(_buffer);
+  _bytes += _len;
+  _len = 0;
+  _buffer[0] = '\0';
+}
+
+void MetricsWriter::family(const char* name, const char* type, const char* help) {
+  _current = familyHash(name);
+  if( _collecting ) {
+    for( int i=0; i<_numFamilies; i++ ) {if( _families[i] == _current ) return;}
+    if( _numFamilies < METRICS_MAX_FAMILIES ) _families[_numFamilies++] = _current;
+    return;
+  }
+  if( _only != 0 ) {
+    if( _headerDone ) return;
+    if( _current == _only ) _headerDone = true;
+  }
+  printf("# HELP %s %s\n# TYPE %s %s\n",name,help,name,type);
+}
+
+/**
+ *  The first pass only collects family names, each later pass writes one family from every source
+ */
+void MetricsWriter::grouped(int n, std::function<void(int)> source) {
+  uint32_t families[METRICS_MAX_FAMILIES];
+  _families    = families;
+  _numFamilies = 0;
+  _collecting  = true;
+  for( int i=0; i<n; i++ ) {_current = 0; source(i);}
+  _collecting  = false;
+  for( int f=0; f<_numFamilies; f++ ) {
+    _only       = families[f];
+    _headerDone = false;
+    for( int i=0; i<n; i++ ) {_current = 0; source(i);}
+  }
+  _only        = 0;
+  _current     = 0;
+  _families    = NULL;
+  _numFamilies = 0;
+}
+
+/**
+ *  Labels of a sample with the scope labels in front
+ */
+const char* MetricsWriter::scoped(char buffer[], int size, const char* labels) {
+  if( _scope == NULL ) return labels;
+  if( labels == NULL ) return _scope;
+  snprintf(buffer,size,"%s,%s",_scope,labels);
+  return buffer;
+}
+
+/**
+ *  64 bit values are converted here, since printf on ESP8266 has no %llu
+ */
+void MetricsWriter::sample(const char* name, const char* labels, uint64_t value) {
+  char digits[21];
+  int  pos = sizeof(digits) - 1;
+  digits[pos] = '\0';
+  do {
+    digits[--pos] = '0' + (value % 10);
+    value /= 10;
+  } while( value > 0 );
+  char buffer[METRICS_LABELS_SIZE];
+  labels = scoped(buffer,sizeof(buffer),labels);
+  if( labels != NULL ) printf("%s{%s} %s\n",name,labels,digits+pos);
+  else printf("%s %s\n",name,digits+pos);
+}
+
+void MetricsWriter::sample(const char* name, const char* labels, const char* fmt, ...) {
+  char buffer[METRICS_LABELS_SIZE];
+  labels = scoped(buffer,sizeof(buffer),labels);
+  if( labels != NULL ) printf("%s{%s} ",name,labels);
+  else printf("%s ",name);
+  va_list args;
+  va_start(args,fmt);
+  vprintf(fmt,args);
+  va_end(args);
+  printf("\n");
+}
+
+/**
+ *  Format value in units per second as decimal seconds, without floating point
+ */
+void MetricsWriter::seconds(char buffer[], int size, uint64_t value, uint32_t units) {
+  int digits = 0;
+  for( uint32_t u=units; u>1; u/=10 ) digits++;
+  snprintf(buffer,size,"%lu.%0*lu",(unsigned long)(value/units),digits,(unsigned long)(value%units));
+}
+
+void MetricsWriter::histogram(const char* name, const char* labels, const Histogram& h, uint32_t units) {
+  char     le[24];
+  uint32_t cumulative = 0;
+  char     buffer[METRICS_LABELS_SIZE];
+  labels = scoped(buffer,sizeof(buffer),labels);
+  const char* sep = ((labels != NULL)?(","):(""));
+  if( labels == NULL ) labels = "";
+  for( int i=0; i<HISTOGRAM_BUCKETS-1; i++ ) {
+    cumulative += h.bucket(i);
+    seconds(le,sizeof(le),Histogram::bound(i),units);
+    printf("%s_bucket{%s%sle=\"%s\"} %lu\n",name,labels,sep,le,(unsigned long)cumulative);
+  }
+  printf("%s_bucket{%s%sle=\"+Inf\"} %lu\n",name,labels,sep,(unsigned long)h.count());
+  seconds(le,sizeof(le),h.sum(),units);
+  if( labels[0] != '\0' ) {
+    printf("%s_sum{%s} %s\n",name,labels,le);
+    printf("%s_count{%s} %lu\n",name,labels,(unsigned long)h.count());
+  }
+  else {
+    printf("%s_sum %s\n",name,le);
+    printf("%s_count %lu\n",name,(unsigned long)h.count());
+  }
+}
+
+} // End of namespace lsc
@@ -0,0 +1,132 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * MetricsWriter.h
+ *
+ *  Streaming writer for the Prometheus text exposition format (version 0.0.4). Lines are formatted into a small fixed
+ *  buffer that is handed to a sink each time it fills, so a metrics page of any length costs METRICS_BUFFER_SIZE bytes
+ *  of stack. For example, a device adds its own gauges by overriding UPnPDevice::formatMetrics():
+ *
+ *    void Thermometer::formatMetrics(MetricsWriter& w) {
+ *      w.family("thermometer_celsius","gauge","Last temperature reading");
+ *      w.sample("thermometer_celsius",NULL,"%d.%d",_tenths/10,abs(_tenths%10));
+ *    }
+ *
+ *  RootDevice calls each device through grouped() with the scope device="<target>", so two Thermometers write
+ *
+ *    # HELP thermometer_celsius Last temperature reading
+ *    # TYPE thermometer_celsius gauge
+ *    thermometer_celsius{device="kitchen"} 21.5
+ *    thermometer_celsius{device="porch"} 8.0
+ *
+ *  grouped() calls its sources once to collect the families they write, then once per family writing only that
+ *  family, so the HELP and TYPE lines of a family are written once and its samples follow them. Within a grouped()
+ *  source every sample must follow the family() it belongs to, and families beyond METRICS_MAX_FAMILIES are dropped.
+ *
+ *  Histograms (see Histogram.h) are written with cumulative buckets, the bucket bounds and sum converted to seconds.
+ *  Metric names are not checked; use lowercase names with underscores and label values without quotes.
+ */
+
+#ifndef METRICS_WRITER_H
+#define METRICS_WRITER_H
+
+#include <Arduino.h>
+#include <functional>
+#include "Histogram.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef METRICS_BUFFER_SIZE
+#define METRICS_BUFFER_SIZE   256
+#endif
+
+#ifndef METRICS_MAX_FAMILIES
+#define METRICS_MAX_FAMILIES  16                // Families written by the sources of one grouped() call
+#endif
+
+#define METRICS_LABELS_SIZE   96
+#define METRICS_CONTENT_TYPE  "text/plain; version=0.0.4"
+#define METRICS_US            1000000           // Histogram units per second, microseconds
+#define METRICS_MS            1000              // Histogram units per second, milliseconds
+
+typedef std::function<void(const char*)> MetricsSink;
+
+/** MetricsWriter class definition
+ *  Class members are as follows:
+ *    family(name,type,help)           := Write the HELP and TYPE lines of a metric family, type is counter, gauge or histogram
+ *    sample(name,labels,value)        := Write a sample, labels is NULL or a label list such as route="/root"
+ *    sample(name,labels,fmt,...)      := Write a sample with a formatted value
+ *    counter(name,help,value)         := Write a family with a single unlabeled sample, also gauge(...)
+ *    histogram(name,labels,h,units)   := Write the bucket, sum and count samples of h, where units is the number of 
+ *                                        histogram units per second, METRICS_US or METRICS_MS
+ *    scope(labels)                    := Labels added to every sample, such as device="root", NULL for none
+ *    grouped(n,source)                := Write the families of sources 0 to n-1, each family once with the samples of 
+ *                                        every source, see above
+ *    printf(fmt,...)                  := Write formatted text
+ *    flush()                          := Hand buffered text to the sink
+ *    bytes()                          := Bytes written so far
+ */
+class MetricsWriter {
+  public:
+    MetricsWriter(MetricsSink sink) : _sink(sink) {_buffer[0] = '\0';}
+    ~MetricsWriter()                                                                 {flush();}
+
+    void         family(const char* name, const char* type, const char* help);
+    void         sample(const char* name, const char* labels, uint64_t value);
+    void         sample(const char* name, const char* labels, const char* fmt, ...);
+    void         counter(const char* name, const char* help, uint64_t value)        {family(name,"counter",help); sample(name,NULL,value);}
+    void         gauge(const char* name, const char* help, uint64_t value)          {family(name,"gauge",help); sample(name,NULL,value);}
+    void         histogram(const char* name, const char* labels, const Histogram& h, uint32_t units);
+    void         scope(const char* labels)                                           {_scope = labels;}
+    void         grouped(int n, std::function<void(int)> source);
+    void         printf(const char* fmt, ...);
+    void         flush();
+    uint32_t     bytes()                                                             {return _bytes + _len;}
+
+  private:
+    MetricsSink  _sink;
+    char         _buffer[METRICS_BUFFER_SIZE];
+    int          _len = 0;
+    uint32_t     _bytes = 0;
+    const char*  _scope = NULL;
+    uint32_t*    _families = NULL;                 // Families collected by grouped(), in the order first written
+    int          _numFamilies = 0;
+    boolean      _collecting = false;              // True while grouped() collects families, nothing is written
+    uint32_t     _only = 0;                        // Family written by the current grouped() pass, 0 outside grouped()
+    boolean      _headerDone = false;
+    uint32_t     _current = 0;                     // Family of the last family() call
+
+    void         vprintf(const char* fmt, va_list args);
+    void         seconds(char buffer[], int size, uint64_t value, uint32_t units);
+    const char*  scoped(char buffer[], int size, const char* labels);
+
+    MetricsWriter(const MetricsWriter&)= delete;
+    MetricsWriter& operator=(const MetricsWriter&)= delete;
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "PerfTrace.h"
+
+#if PERF_TRACE
+#include <atomic>
+#include <chrono>
+#endif
+
+namespace lsc {
+
+#if PERF_TRACE
+
+FILE*      PerfTrace::_out    = NULL;
+uint64_t   PerfTrace::_origin = 0;
+std::mutex PerfTrace::_lock;
+boolean    PerfTrace::_first  = true;
+
+/**
+ *  The file is a JSON array of events, which the trace viewers also accept without its closing bracket, so a trace
+ *  cut short by a crash still opens.
+ */
+boolean PerfTrace::begin(const char* path) {
+  end();
+  {
+    std::lock_guard<std::mutex> guard(_lock);
+    _out = fopen(path,"w");
+    if( _out == NULL ) return false;
+    _origin = 0;
+    _origin = now();
+    _first  = true;
+    fputs("[\n",_out);
+  }
+  threadName("main");
+  return true;
+}
+
+void PerfTrace::end() {
+  std::lock_guard<std::mutex> guard(_lock);
+  if( _out == NULL ) return;
+  fputs("\n]\n",_out);
+  fclose(_out);
+  _out = NULL;
+}
+
+uint64_t PerfTrace::now() {
+  uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  return us - _origin;
+}
+
+/**
+ *  Each thread is given a small id the first time it writes an event
+ */
+int PerfTrace::tid() {
+  static std::atomic<int> next(1);
+  thread_local int id = next++;
+  return id;
+}
+
+void PerfTrace::separator() {
+  if( !_first ) fputs(",\n",_out);
+  _first = false;
+}
+
+void PerfTrace::writeString(const char* s) {
+  fputc('"',_out);
+  for( ; (s != NULL) && (*s != '\0'); s++ ) {
+    if( (*s == '"') || (*s == '\\') ) fputc('\\',_out);
+    if( (unsigned char)*s >= ' ' ) fputc(*s,_out);
+  }
+  fputc('"',_out);
+}
+
+void PerfTrace::complete(const char* cat, const char* name, uint64_t start, const char* key, long value) {
+  uint64_t end = now();
+  int      id  = tid();
+  std::lock_guard<std::mutex> guard(_lock);
+  if( _out == NULL ) return;
+  separator();
+  fputs("{\"ph\":\"X\",\"cat\":",_out);
+  writeString(cat);
+  fputs(",\"name\":",_out);
+  writeString(name);
+  fprintf(_out,",\"pid\":1,\"tid\":%d,\"ts\":%llu,\"dur\":%llu",id,(unsigned long long)start,(unsigned long long)(end - start));
+  if( key != NULL ) {
+    fputs(",\"args\":{",_out);
+    writeString(key);
+    fprintf(_out,":%ld}",value);
+  }
+  fputc('}',_out);
+}
+
+void PerfTrace::instant(const char* cat, const char* name) {
+  uint64_t ts = now();
+  int      id = tid();
+  std::lock_guard<std::mutex> guard(_lock);
+  if( _out == NULL ) return;
+  separator();
+  fputs("{\"ph\":\"i\",\"s\":\"t\",\"cat\":",_out);
+  writeString(cat);
+  fputs(",\"name\":",_out);
+  writeString(name);
+  fprintf(_out,",\"pid\":1,\"tid\":%d,\"ts\":%llu}",id,(unsigned long long)ts);
+}
+
+void PerfTrace::threadName(const char* name) {
+  int id = tid();
+  std::lock_guard<std::mutex> guard(_lock);
+  if( _out == NULL ) return;
+  separator();
+  fprintf(_out,"{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",id);
+  writeString(name);
+  fputs("}}",_out);
+}
+
+#else
+
+boolean  PerfTrace::begin(const char* path)                                                                {return false;}
+void     PerfTrace::end()                                                                                  {}
+uint64_t PerfTrace::now()                                                                                  {return micros();}
+void     PerfTrace::complete(const char* cat, const char* name, uint64_t start, const char* key, long value) {}
+void     PerfTrace::instant(const char* cat, const char* name)                                             {}
+void     PerfTrace::threadName(const char* name)                                                           {}
+
+#endif
+
+} // End of namespace lsc
@@ -0,0 +1,156 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * PerfTrace.h
+ *
+ *  Compile time tracepoints for ESP32, written as Chrome trace event JSON to a file on a mounted filesystem. The file 
+ *  opens directly in ui.perfetto.dev or chrome://tracing. Tracepoints mark the receive, parse, match, render and send stages of each SSDP packet,
+ *  header parsing in UPnPBuffer, device work in RootDevice::doDevice(), and the HTTP route, device page and service 
+ *  dispatch path, each on the thread that ran it. A tracepoint is a scope, timed from its declaration to the end of 
+ *  the enclosing block:
+ *
+ *    void SSDP::flushRecords() {
+ *      PERF_SCOPE_ARG("ssdp","send","bytes",_bin.len);
+ *      ...
+ *    }
+ *
+ *  A slice that does not end with a block is timed explicitly, as the SSDP metrics are:
+ *
+ *    PERF_TRACEPOINT(uint64_t sent = PerfTrace::now());
+ *    ...
+ *    PERF_TRACEPOINT(PerfTrace::complete("ssdp","send",sent,"bytes",len));
+ *
+ *  Tracepoints compile to nothing unless built with PERF_TRACE defined as 1, and write nothing until begin() opens the
+ *  trace file:
+ *
+ *    LittleFS.begin(true);
+ *    PerfTrace::begin("/littlefs/ssdp.json");
+ *    ...
+ *    PerfTrace::end();
+ *
+ *  Events are written with stdio under a std::mutex and threads are told apart with thread_local ids, so PERF_TRACE 
+ *  needs ESP32 and will not build for ESP8266. The library has no host build. Writing to flash takes time between 
+ *  slices, so a trace is for the shape and relative cost of a short run. To record SSDP events without formatting,
+ *  on either chip, use TraceRing.
+ */
+
+#ifndef PERF_TRACE_H
+#define PERF_TRACE_H
+
+#include <Arduino.h>
+
+#ifndef PERF_TRACE
+#define PERF_TRACE           0
+#endif
+
+#if PERF_TRACE
+#ifndef ESP32
+#error "PERF_TRACE needs ESP32, use TraceRing on ESP8266"
+#endif
+#include <stdio.h>
+#include <mutex>
+#endif
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define PERF_CONCAT_(a,b)    a##b
+#define PERF_CONCAT(a,b)     PERF_CONCAT_(a,b)
+
+#if PERF_TRACE
+#define PERF_SCOPE(cat,name)                PerfScope PERF_CONCAT(_perfScope,__LINE__)((cat),(name))
+#define PERF_SCOPE_ARG(cat,name,key,value)  PerfScope PERF_CONCAT(_perfScope,__LINE__)((cat),(name),(key),(value))
+#define PERF_INSTANT(cat,name)              PerfTrace::instant((cat),(name))
+#define PERF_TRACEPOINT(x)                  x
+#else
+#define PERF_SCOPE(cat,name)
+#define PERF_SCOPE_ARG(cat,name,key,value)
+#define PERF_INSTANT(cat,name)
+#define PERF_TRACEPOINT(x)
+#endif
+
+/** PerfTrace class definition
+ *  Class members are as follows:
+ *    begin(path)                     := Open path and start writing events, returns false if it could not be opened
+ *    end()                           := Finish the JSON array and close the file, writing buffered events
+ *    active()                        := True between begin() and end()
+ *    now()                           := Microseconds on the trace clock, since begin() when tracing
+ *    complete(cat,name,start,key,v)  := Write a slice from start to now() on the calling thread, with an optional
+ *                                       integer argument key (NULL for none)
+ *    instant(cat,name)               := Write an instant event on the calling thread
+ *    threadName(name)                := Name the calling thread in the trace, the thread calling begin() is "main"
+ *
+ *  Names and categories are written as given, and must be valid until the event is written.
+ */
+class PerfTrace {
+  public:
+    static boolean               begin(const char* path);
+    static void                  end();
+    static uint64_t              now();
+    static void                  complete(const char* cat, const char* name, uint64_t start, const char* key=NULL, long value=0);
+    static void                  instant(const char* cat, const char* name);
+    static void                  threadName(const char* name);
+
+#if PERF_TRACE
+    static inline boolean active() {return _out != NULL;}
+
+  private:
+    static void                  separator();
+    static void                  writeString(const char* s);
+    static int                   tid();
+
+    static FILE*                 _out;
+    static uint64_t              _origin;            // now() at begin(), time stamps are relative to it
+    static std::mutex            _lock;
+    static boolean               _first;             // No event written yet, so no separator is needed
+#else
+    static inline boolean active() {return false;}
+#endif
+};
+
+/** PerfScope
+ *  A slice timed from construction to destruction, written only if the trace was active at construction
+ */
+class PerfScope {
+  public:
+    PerfScope(const char* cat, const char* name, const char* key=NULL, long value=0) 
+      : _cat(cat), _name(name), _key(key), _value(value), _active(PerfTrace::active()) {if( _active ) _start = PerfTrace::now();}
+    ~PerfScope() {if( _active ) PerfTrace::complete(_cat,_name,_start,_key,_value);}
+
+  private:
+    const char*    _cat;
+    const char*    _name;
+    const char*    _key;
+    long           _value;
+    boolean        _active;
+    uint64_t       _start = 0;
+
+    PerfScope(const PerfScope&)= delete;
+    PerfScope& operator=(const PerfScope&)= delete;
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,156 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * ResponseTemplate.h
+ *
+ *  Search response templates. A response is written straight into the outgoing packet as a sequence of segments, 
+ *  each a literal followed by a field value:
+ *
+ *    HTTP/1.1 200 OK 
+ *    CACHE-CONTROL: max-age = 1800 
+ *    LOCATION: <location>
+ *    ST: <search target>
+ *    USN: uuid:<uuid>::<type>                          (parent uuid and service type for a service)
+ *    DESC.LEELANAUSOFTWARE.COM: :name:<name>:<desc>:
+ *    <transaction line>
+ *
+ *  where <desc> is devices:<n>:services:<n> for a root, services:<n>:puuid:<uuid> for an embedded device, and
+ *  puuid:<uuid> for a service. Literal lengths and the largest response are computed at compile time, and each field 
+ *  is written at most its size in fieldSize(), so SSDP_RESPONSE_SIZE, the largest response a template can write, is 
+ *  derived from the templates rather than chosen. The templates are in this header so that the size is available to
+ *  sketches; SSDP writes them into packets.
+ */
+
+#ifndef RESPONSE_TEMPLATE_H
+#define RESPONSE_TEMPLATE_H
+
+#include <Arduino.h>
+#include "UPnPDevice.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define ST_HEADER_SIZE       100
+#define SSDP_TYPE_SIZE       ST_HEADER_SIZE     // Largest device or service type in a response, a longer type could not be the ST of a search
+#define SSDP_LOCATION_SIZE   128                // LOCATION value of a response
+#define TXN_LINE_SIZE        48                 // TXN.LEELANAUSOFTWARE.COM line of a response
+#define RESPONSE_INT_SIZE    12                 // Decimal int with sign
+#define UDP_DATAGRAM_SIZE    1472               // UDP payload of a 1500 byte Ethernet frame
+
+const char  RESPONSE_LOCATION[]   PROGMEM = "HTTP/1.1 200 OK \r\n"
+                                         "CACHE-CONTROL: max-age = 1800 \r\n"
+                                         "LOCATION: ";
+const char  RESPONSE_ST[]         PROGMEM = "\r\nST: ";
+const char  RESPONSE_USN[]        PROGMEM = "\r\nUSN: uuid:";
+const char  RESPONSE_TYPE[]       PROGMEM = "::";
+const char  RESPONSE_NAME[]       PROGMEM = "\r\nDESC.LEELANAUSOFTWARE.COM: :name:";
+const char  RESPONSE_DEVICES[]    PROGMEM = ":devices:";
+const char  RESPONSE_SERVICES[]   PROGMEM = ":services:";
+const char  RESPONSE_PUUID[]      PROGMEM = ":puuid:";
+const char  RESPONSE_DESC_END[]   PROGMEM = ":\r\n";
+const char  RESPONSE_END[]        PROGMEM = "\r\n\r\n";
+
+typedef enum {
+  FIELD_NONE,
+  FIELD_LOCATION,
+  FIELD_ST,
+  FIELD_UUID,
+  FIELD_TYPE,
+  FIELD_NAME,
+  FIELD_DEVICES,
+  FIELD_SERVICES,
+  FIELD_PUUID,
+  FIELD_TXN
+} ResponseField;
+
+typedef struct {
+  PGM_P          text;
+  uint16_t       len;
+  uint16_t       field;
+} ResponseSegment;
+
+#define RESPONSE_SEGMENT(text,field) {text,sizeof(text)-1,field}
+
+/**
+ *  Largest value written for a field, not including null termination
+ */
+constexpr size_t fieldSize(ResponseField f) {
+  return ((f == FIELD_LOCATION)?(SSDP_LOCATION_SIZE-1):
+          (f == FIELD_ST)?(ST_HEADER_SIZE-1):
+          ((f == FIELD_UUID) || (f == FIELD_PUUID))?(UUID_SIZE-1):
+          (f == FIELD_TYPE)?(SSDP_TYPE_SIZE-1):
+          (f == FIELD_NAME)?(NAME_SIZE-1):
+          ((f == FIELD_DEVICES) || (f == FIELD_SERVICES))?(RESPONSE_INT_SIZE-1):
+          (f == FIELD_TXN)?(TXN_LINE_SIZE-1):(0));
+}
+
+/**
+ *  Largest response a template can write, from segment i on
+ */
+template<size_t N> constexpr size_t templateSize(const ResponseSegment (&t)[N], size_t i = 0) {
+  return ((i < N)?(t[i].len + fieldSize((ResponseField)t[i].field) + templateSize(t,i+1)):(0));
+}
+
+constexpr ResponseSegment ROOT_TEMPLATE[]    PROGMEM = {RESPONSE_SEGMENT(RESPONSE_LOCATION,FIELD_LOCATION),
+                                                        RESPONSE_SEGMENT(RESPONSE_ST,FIELD_ST),
+                                                        RESPONSE_SEGMENT(RESPONSE_USN,FIELD_UUID),
+                                                        RESPONSE_SEGMENT(RESPONSE_TYPE,FIELD_TYPE),
+                                                        RESPONSE_SEGMENT(RESPONSE_NAME,FIELD_NAME),
+                                                        RESPONSE_SEGMENT(RESPONSE_DEVICES,FIELD_DEVICES),
+                                                        RESPONSE_SEGMENT(RESPONSE_SERVICES,FIELD_SERVICES),
+                                                        RESPONSE_SEGMENT(RESPONSE_DESC_END,FIELD_TXN),
+                                                        RESPONSE_SEGMENT(RESPONSE_END,FIELD_NONE)};
+
+constexpr ResponseSegment DEVICE_TEMPLATE[]  PROGMEM = {RESPONSE_SEGMENT(RESPONSE_LOCATION,FIELD_LOCATION),
+                                                        RESPONSE_SEGMENT(RESPONSE_ST,FIELD_ST),
+                                                        RESPONSE_SEGMENT(RESPONSE_USN,FIELD_UUID),
+                                                        RESPONSE_SEGMENT(RESPONSE_TYPE,FIELD_TYPE),
+                                                        RESPONSE_SEGMENT(RESPONSE_NAME,FIELD_NAME),
+                                                        RESPONSE_SEGMENT(RESPONSE_SERVICES,FIELD_SERVICES),
+                                                        RESPONSE_SEGMENT(RESPONSE_PUUID,FIELD_PUUID),
+                                                        RESPONSE_SEGMENT(RESPONSE_DESC_END,FIELD_TXN),
+                                                        RESPONSE_SEGMENT(RESPONSE_END,FIELD_NONE)};
+
+constexpr ResponseSegment SERVICE_TEMPLATE[] PROGMEM = {RESPONSE_SEGMENT(RESPONSE_LOCATION,FIELD_LOCATION),
+                                                        RESPONSE_SEGMENT(RESPONSE_ST,FIELD_ST),
+                                                        RESPONSE_SEGMENT(RESPONSE_USN,FIELD_UUID),
+                                                        RESPONSE_SEGMENT(RESPONSE_TYPE,FIELD_TYPE),
+                                                        RESPONSE_SEGMENT(RESPONSE_NAME,FIELD_NAME),
+                                                        RESPONSE_SEGMENT(RESPONSE_PUUID,FIELD_PUUID),
+                                                        RESPONSE_SEGMENT(RESPONSE_DESC_END,FIELD_TXN),
+                                                        RESPONSE_SEGMENT(RESPONSE_END,FIELD_NONE)};
+
+constexpr size_t maxSize(size_t a, size_t b) {return ((a > b)?(a):(b));}
+
+/**
+ *  Largest text search response with its null termination
+ */
+#define SSDP_RESPONSE_SIZE   (maxSize(templateSize(ROOT_TEMPLATE),maxSize(templateSize(DEVICE_TEMPLATE),templateSize(SERVICE_TEMPLATE))) + 1)
+
+static_assert(SSDP_RESPONSE_SIZE <= UDP_DATAGRAM_SIZE,             "A response must fit in a single unfragmented datagram");
+
+} // End of namespace lsc
+
+#endif
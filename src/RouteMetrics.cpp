@@ -0,0 +1,107 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "RouteMetrics.h"
+#include "PerfTrace.h"
+
+namespace lsc {
+
+#if HTTP_METRICS
+
+RouteStats  RouteMetrics::_routes[HTTP_MAX_ROUTES];
+int         RouteMetrics::_numRoutes = 0;
+RouteStats* RouteMetrics::_current   = NULL;
+
+/**
+ *  A path registered again, for example when setup() is called twice, shares its entry
+ */
+void RouteMetrics::on(WebContext* svr, const char* path, HandlerFunction handler) {
+  RouteStats* r = NULL;
+  for( int i=0; (i<_numRoutes) && (r == NULL); i++ ) {if( strncmp(_routes[i].path,path,ROUTE_PATH_SIZE-1) == 0 ) r = &_routes[i];}
+  if( (r == NULL) && (_numRoutes < HTTP_MAX_ROUTES) ) {
+    r = &_routes[_numRoutes++];
+    strlcpy(r->path,path,ROUTE_PATH_SIZE);
+  }
+  if( r == NULL ) svr->on(path,handler);
+  else svr->on(path,[r,handler](WebContext* s) {
+    PERF_SCOPE("http",r->path);
+    RouteStats* previous = _current;
+    _current = r;
+    uint32_t  start = micros();
+    int       stack = StackProfiler::begin(r->path);
+    HeapScope heap  = HeapAccounting::enter(HEAP_HTTP);
+    handler(s);
+    HeapAccounting::leave(heap);
+    StackProfiler::end(stack);
+    r->time.add(micros() - start);
+    r->requests++;
+    _current = previous;
+  });
+}
+
+void RouteMetrics::responseBytes(int n) {
+  if( (_current != NULL) && (n > 0) ) _current->bytes += n;
+}
+
+int RouteMetrics::numRoutes()                  {return _numRoutes;}
+const RouteStats* RouteMetrics::route(int i)   {return (((i>=0)&&(i<_numRoutes))?(&_routes[i]):(NULL));}
+
+void RouteMetrics::reset() {
+  for( int i=0; i<_numRoutes; i++ ) {
+    _routes[i].requests = 0;
+    _routes[i].bytes    = 0;
+    _routes[i].time.reset();
+  }
+}
+
+void RouteMetrics::formatMetrics(MetricsWriter& w) {
+  char labels[ROUTE_PATH_SIZE + 16];
+  if( _numRoutes == 0 ) return;
+  w.family("lsc_http_requests_total","counter","Requests handled by route");
+  for( int i=0; i<_numRoutes; i++ ) {
+    snprintf(labels,sizeof(labels),"route=\"%s\"",_routes[i].path);
+    w.sample("lsc_http_requests_total",labels,_routes[i].requests);
+  }
+  w.family("lsc_http_response_bytes_total","counter","Response bytes reported by route handlers");
+  for( int i=0; i<_numRoutes; i++ ) {
+    snprintf(labels,sizeof(labels),"route=\"%s\"",_routes[i].path);
+    w.sample("lsc_http_response_bytes_total",labels,_routes[i].bytes);
+  }
+  w.family("lsc_http_handler_seconds","histogram","Handler time by route");
+  for( int i=0; i<_numRoutes; i++ ) {
+    snprintf(labels,sizeof(labels),"route=\"%s\"",_routes[i].path);
+    w.histogram("lsc_http_handler_seconds",labels,_routes[i].time,METRICS_US);
+  }
+}
+
+#else
+
+void RouteMetrics::on(WebContext* svr, const char* path, HandlerFunction handler) {svr->on(path,handler);}
+void RouteMetrics::responseBytes(int n)                                            {}
+int RouteMetrics::numRoutes()                                                      {return 0;}
+const RouteStats* RouteMetrics::route(int i)                                       {return NULL;}
+void RouteMetrics::reset()                                                         {}
+void RouteMetrics::formatMetrics(MetricsWriter& w)                                 {}
+
+#endif
+
+} // End of namespace lsc
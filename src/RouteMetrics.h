@@ -0,0 +1,103 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * RouteMetrics.h
+ *
+ *  Per route HTTP instrumentation. Library handlers are registered with the web server through RouteMetrics::on(),
+ *  which wraps each handler to count requests, time the handler in microseconds, and attribute response bytes to
+ *  the route. The web server does not report what a handler sent, so handlers report it with responseBytes();
+ *  display(), displayRoot(), styles() and metrics() do, and custom service handlers can:
+ *
+ *    void CustomDevice::handleGetMsg(WebContext* svr) {
+ *      svr->send_P(200,"text/xml",Msg_template);
+ *      RouteMetrics::responseBytes(strlen_P(Msg_template));
+ *    }
+ *
+ *  Routes are kept in a fixed table of HTTP_MAX_ROUTES entries; routes registered once the table is full are served
+ *  but not instrumented. Build with HTTP_METRICS defined as 0 to register handlers unwrapped and remove the table.
+ */
+
+#ifndef ROUTE_METRICS_H
+#define ROUTE_METRICS_H
+
+#include <Arduino.h>
+#include <CommonUtil.h>
+#include "Histogram.h"
+#include "MetricsWriter.h"
+#include "StackProfiler.h"
+#include "HeapAccounting.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef HTTP_METRICS
+#define HTTP_METRICS         1
+#endif
+
+#ifndef HTTP_MAX_ROUTES
+#define HTTP_MAX_ROUTES      16
+#endif
+
+#define ROUTE_PATH_SIZE      32                 // Longer paths are kept truncated, and share statistics if they agree that far
+
+/** RouteStats
+ *  Statistics of one route since start up or RouteMetrics::reset()
+ */
+typedef struct {
+  char           path[ROUTE_PATH_SIZE];
+  uint32_t       requests;
+  uint64_t       bytes;
+  Histogram      time;                          // Handler time in microseconds
+} RouteStats;
+
+/** RouteMetrics class definition
+ *  Class members are as follows:
+ *    on(svr,path,handler)  := Register handler at path on svr, instrumented while the route table has room
+ *    responseBytes(n)      := Add n response bytes to the route being handled, ignored outside a handler
+ *    numRoutes()           := Number of instrumented routes
+ *    route(i)              := Statistics of route i, or NULL if i is out of range
+ *    reset()               := Clear statistics, routes stay registered
+ *    formatMetrics(w)      := Write route metrics in the Prometheus text format
+ */
+class RouteMetrics {
+  public:
+    static void               on(WebContext* svr, const char* path, HandlerFunction handler);
+    static void               responseBytes(int n);
+    static int                numRoutes();
+    static const RouteStats*  route(int i);
+    static void               reset();
+    static void               formatMetrics(MetricsWriter& w);
+
+#if HTTP_METRICS
+  private:
+    static RouteStats         _routes[HTTP_MAX_ROUTES];
+    static int                _numRoutes;
+    static RouteStats*        _current;
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
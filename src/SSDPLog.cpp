@@ -0,0 +1,153 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SSDPLog.h"
+
+namespace lsc {
+
+LoggingLevel SSDPLog::_level = NONE;
+
+/**
+ *  Conversions are formatted one at a time, with integer arguments widened to long, since the arguments of a deferred 
+ *  message can not be handed back to vsnprintf. Length modifiers in the format are dropped.
+ */
+int SSDPLog::format(char buffer[], int size, const SSDPLogRecord& r) {
+  char fmt[SSDP_LOG_LINE_SIZE];
+  strncpy_P(fmt,r.fmt,SSDP_LOG_LINE_SIZE-1);
+  fmt[SSDP_LOG_LINE_SIZE-1] = '\0';
+  int         pos = 0;
+  int         arg = 0;
+  const char* p   = fmt;
+  while( (*p != '\0') && (pos < size-1) ) {
+    if( *p != '%' ) {buffer[pos++] = *p++; continue;}
+    if( p[1] == '%' ) {buffer[pos++] = '%'; p += 2; continue;}
+    char spec[16];
+    int  n = 0;
+    spec[n++] = *p++;
+    while( (*p != '\0') && (strchr("-+ #0123456789.",*p) != NULL) ) {
+      if( n < 12 ) spec[n++] = *p;
+      p++;
+    }
+    while( (*p != '\0') && (strchr("hlLqjzt",*p) != NULL) ) p++;
+    char conv = *p;
+    if( conv != '\0' ) p++;
+    boolean  known  = (arg < r.count);
+    boolean  string = known && ((r.strings & (1 << arg)) != 0);
+    uint32_t value  = ((known)?(r.args[arg]):(0));
+    arg++;
+    int left = size - pos;
+    int len  = 0;
+    if( (conv == 's') && string ) {
+      spec[n++] = 's'; spec[n] = '\0';
+      len = snprintf(buffer+pos,left,spec,r.text+value);
+    }
+    else if( ((conv == 'd') || (conv == 'i')) && known && !string ) {
+      spec[n++] = 'l'; spec[n++] = 'd'; spec[n] = '\0';
+      len = snprintf(buffer+pos,left,spec,(long)(int32_t)value);
+    }
+    else if( (conv != '\0') && (strchr("uxXo",conv) != NULL) && known && !string ) {
+      spec[n++] = 'l'; spec[n++] = conv; spec[n] = '\0';
+      len = snprintf(buffer+pos,left,spec,(unsigned long)value);
+    }
+    else if( (conv == 'c') && known && !string ) len = snprintf(buffer+pos,left,"%c",(int)value);
+    else len = snprintf(buffer+pos,left,"?");
+    if( len > 0 ) pos += ((len < left)?(len):(left-1));
+  }
+  buffer[pos] = '\0';
+  return pos;
+}
+
+#if SSDP_LOG_DEFERRED
+
+SSDPLogRecord SSDPLog::_records[SSDP_LOG_RECORDS];
+int           SSDPLog::_head    = 0;
+int           SSDPLog::_count   = 0;
+uint32_t      SSDPLog::_dropped = 0;
+
+SSDPLogRecord* SSDPLog::record(PGM_P fmt) {
+  if( _count >= SSDP_LOG_RECORDS ) {
+    _dropped++;
+    return NULL;
+  }
+  SSDPLogRecord* r = &_records[(_head + _count++) % SSDP_LOG_RECORDS];
+  r->time    = millis();
+  r->fmt     = fmt;
+  r->count   = 0;
+  r->strings = 0;
+  r->textLen = 0;
+  r->text[SSDP_LOG_TEXT_SIZE-1] = '\0';
+  return r;
+}
+
+/**
+ *  A string that does not fit is truncated, and one with no room at all is kept as the empty string at the end of text
+ */
+void SSDPLog::pack(SSDPLogRecord& r, const char* s) {
+  if( r.count >= SSDP_LOG_ARGS ) return;
+  int room = SSDP_LOG_TEXT_SIZE - 1 - r.textLen;
+  if( room <= 0 ) r.args[r.count] = SSDP_LOG_TEXT_SIZE - 1;
+  else {
+    int len = ((s != NULL)?(strnlen(s,room-1)):(0));
+    if( len > 0 ) memcpy(r.text+r.textLen,s,len);
+    r.text[r.textLen+len] = '\0';
+    r.args[r.count] = r.textLen;
+    r.textLen += len + 1;
+  }
+  r.strings |= (1 << r.count);
+  r.count++;
+}
+
+void SSDPLog::packValue(SSDPLogRecord& r, uint32_t v) {
+  if( r.count < SSDP_LOG_ARGS ) r.args[r.count++] = v;
+}
+
+int SSDPLog::flush(Print& out, int max) {
+  char line[SSDP_LOG_LINE_SIZE];
+  int  written = 0;
+  while( (_count > 0) && (written < max) ) {
+    const SSDPLogRecord& r = _records[_head];
+    int n = snprintf(line,SSDP_LOG_LINE_SIZE,"[%lu] ",(unsigned long)r.time);
+    format(line+n,SSDP_LOG_LINE_SIZE-n,r);
+    out.print(line);
+    _head = (_head + 1) % SSDP_LOG_RECORDS;
+    _count--;
+    written++;
+  }
+  if( (_count == 0) && (_dropped > 0) ) {
+    out.printf("SSDPLog: %lu messages dropped\n",(unsigned long)_dropped);
+    _dropped = 0;
+  }
+  return written;
+}
+
+int      SSDPLog::pending()                      {return _count;}
+uint32_t SSDPLog::dropped()                      {return _dropped;}
+
+#else
+
+int      SSDPLog::flush(Print& out, int max)     {return 0;}
+int      SSDPLog::pending()                      {return 0;}
+uint32_t SSDPLog::dropped()                      {return 0;}
+
+#endif
+
+} // End of namespace lsc
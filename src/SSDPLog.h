@@ -0,0 +1,173 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * SSDPLog.h
+ *
+ *  Logging macros for the library, one per level:
+ *
+ *    SSDP_LOG_WARNING("SSDP::flushRecords: Error sending %d records in %d bytes\n",_bin.count,_bin.len);
+ *
+ *  A message is written when the run time level set by SSDP::logging() is at least its level. Levels above 
+ *  SSDP_LOG_LEVEL are compiled out, with their arguments and format strings, so a production build with 
+ *  SSDP_LOG_LEVEL 1 keeps only warnings and checks nothing for the rest. Format strings are kept in flash.
+ *
+ *  Built with SSDP_LOG_DEFERRED 1, a message is not formatted when logged. Its format string and arguments are copied
+ *  to a ring of SSDP_LOG_RECORDS records, and formatted and written later by flush(), called by the sketch where 
+ *  blocking on the UART does no harm:
+ *
+ *    void loop() {
+ *      ssdp.doSSDP();
+ *      root.doDevice();
+ *      SSDPLog::flush(Serial);
+ *    }
+ *
+ *  Deferred arguments are integers (up to 32 bits) and strings, which are copied when logged and truncated to fit in 
+ *  SSDP_LOG_TEXT_SIZE bytes per message. Conversions other than d, i, u, x, X, o, c and s are written as ?. Messages 
+ *  logged while the ring is full are dropped and counted.
+ */
+
+#ifndef SSDP_LOG_H
+#define SSDP_LOG_H
+
+#include <Arduino.h>
+#include <CommonUtil.h>
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef SSDP_LOG_LEVEL
+#define SSDP_LOG_LEVEL       4                  // Most verbose level compiled in, 0 NONE, 1 WARNING, 2 INFO, 3 FINE, 4 FINEST
+#endif
+
+#ifndef SSDP_LOG_DEFERRED
+#define SSDP_LOG_DEFERRED    0
+#endif
+
+#ifndef SSDP_LOG_RECORDS
+#define SSDP_LOG_RECORDS     16
+#endif
+
+#ifndef SSDP_LOG_TEXT_SIZE
+#define SSDP_LOG_TEXT_SIZE   128                // Bytes of string arguments kept per deferred message
+#endif
+
+#define SSDP_LOG_ARGS        6                  // Most arguments kept per deferred message, at most 8
+#define SSDP_LOG_LINE_SIZE   256                // Longest message written by flush()
+
+#define SSDP_LOG_AT(level,fmt,...)  do {if( SSDPLog::enabled(level) ) SSDPLog::log((level),PSTR(fmt),##__VA_ARGS__);} while(0)
+
+#if SSDP_LOG_LEVEL >= 1
+#define SSDP_LOG_WARNING(fmt,...)   SSDP_LOG_AT(WARNING,fmt,##__VA_ARGS__)
+#else
+#define SSDP_LOG_WARNING(fmt,...)   do {} while(0)
+#endif
+
+#if SSDP_LOG_LEVEL >= 2
+#define SSDP_LOG_INFO(fmt,...)      SSDP_LOG_AT(INFO,fmt,##__VA_ARGS__)
+#else
+#define SSDP_LOG_INFO(fmt,...)      do {} while(0)
+#endif
+
+#if SSDP_LOG_LEVEL >= 3
+#define SSDP_LOG_FINE(fmt,...)      SSDP_LOG_AT(FINE,fmt,##__VA_ARGS__)
+#else
+#define SSDP_LOG_FINE(fmt,...)      do {} while(0)
+#endif
+
+#if SSDP_LOG_LEVEL >= 4
+#define SSDP_LOG_FINEST(fmt,...)    SSDP_LOG_AT(FINEST,fmt,##__VA_ARGS__)
+#else
+#define SSDP_LOG_FINEST(fmt,...)    do {} while(0)
+#endif
+
+/** SSDPLogRecord
+ *  A deferred message. String arguments are copied to text, and their argument is the offset of the copy
+ */
+typedef struct {
+  uint32_t       time;                          // millis() when logged
+  PGM_P          fmt;
+  uint8_t        count;                         // Number of arguments kept
+  uint8_t        strings;                       // Bit i is set if argument i is a string
+  uint8_t        textLen;
+  uint32_t       args[SSDP_LOG_ARGS];
+  char           text[SSDP_LOG_TEXT_SIZE];
+} SSDPLogRecord;
+
+/** SSDPLog class definition
+ *  Class members are as follows:
+ *    level(l)                := Set the run time logging level, NONE by default
+ *    level()                 := The run time logging level
+ *    enabled(l)              := True if messages of level l are written
+ *    log(l,fmt,args...)      := Write, or with SSDP_LOG_DEFERRED record, a message with format fmt in flash
+ *    flush(out,max)          := Format and write up to max deferred messages to out, oldest first, each prefixed with
+ *                               its time in milliseconds. Returns the number written
+ *    pending()               := Deferred messages not yet written
+ *    dropped()               := Deferred messages dropped while the ring was full, reported and cleared by flush()
+ *    format(buffer,size,r)   := Format deferred message r into buffer, returns its length
+ */
+class SSDPLog {
+  public:
+    static void                  level(LoggingLevel l)          {_level = l;}
+    static LoggingLevel          level()                        {return _level;}
+    static boolean               enabled(LoggingLevel l)        {return (_level >= l);}
+    static int                   flush(Print& out, int max=SSDP_LOG_RECORDS);
+    static int                   pending();
+    static uint32_t              dropped();
+    static int                   format(char buffer[], int size, const SSDPLogRecord& r);
+
+    template<typename... Args>
+    static void log(LoggingLevel l, PGM_P fmt, Args... args) {
+#if SSDP_LOG_DEFERRED
+      SSDPLogRecord* r = record(fmt);
+      if( r != NULL ) {
+        int packed[] = {0, (pack(*r,args),0)...};
+        (void)packed;
+      }
+#else
+      Serial.printf_P(fmt,args...);
+#endif
+    }
+
+  private:
+    static LoggingLevel          _level;
+
+#if SSDP_LOG_DEFERRED
+    static SSDPLogRecord*        record(PGM_P fmt);
+    static void                  pack(SSDPLogRecord& r, const char* s);
+    static void                  pack(SSDPLogRecord& r, char* s)                {pack(r,(const char*)s);}
+    static void                  packValue(SSDPLogRecord& r, uint32_t v);
+    template<typename T>
+    static void                  pack(SSDPLogRecord& r, T v)                    {packValue(r,(uint32_t)v);}
+
+    static SSDPLogRecord         _records[SSDP_LOG_RECORDS];
+    static int                   _head;
+    static int                   _count;
+    static uint32_t              _dropped;
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
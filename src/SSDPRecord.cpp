@@ -0,0 +1,263 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SSDPRecord.h"
+
+namespace lsc {
+
+const char BIN_MAGIC[]          PROGMEM = "LSCB";
+const char REC_LOCATION[]       PROGMEM = "LOCATION";
+const char REC_USN[]            PROGMEM = "USN";
+const char REC_DESC[]           PROGMEM = "DESC.LEELANAUSOFTWARE.COM";
+const char REC_SERVICE[]        PROGMEM = ":service:";
+
+/**
+ *  Pack a uuid string of the form xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx into 16 bytes. An invalid uuid packs as zeros.
+ */
+static void packUUID(const char* uuid, uint8_t out[16]) {
+  memset(out,0,16);
+  int n = 0;
+  for( int i=0; (uuid[i] != '\0') && (n < 32); i++ ) {
+    char c = uuid[i];
+    if( c == '-' ) continue;
+    if( !isxdigit(c) ) {
+      memset(out,0,16);
+      return;
+    }
+    uint8_t v = ((c <= '9')?(c - '0'):((c | 0x20) - 'a' + 10));
+    out[n/2] |= ((n%2)?(v):(v << 4));
+    n++;
+  }
+  if( n != 32 ) memset(out,0,16);
+}
+
+/**
+ *  Unpack 16 bytes into a uuid string, all zeros unpacks as an empty string
+ */
+static void unpackUUID(const uint8_t in[16], char uuid[UUID_SIZE]) {
+  static const char hex[] = "0123456789abcdef";
+  uint8_t any = 0;
+  for( int i=0; i<16; i++ ) {any |= in[i];}
+  uuid[0] = '\0';
+  if( any == 0 ) return;
+  int pos = 0;
+  for( int i=0; i<16; i++ ) {
+    if( (i == 4) || (i == 6) || (i == 8) || (i == 10) ) uuid[pos++] = '-';
+    uuid[pos++] = hex[in[i] >> 4];
+    uuid[pos++] = hex[in[i] & 0x0F];
+  }
+  uuid[pos] = '\0';
+}
+
+/**
+ *  Text responses carry uuids as the device set them, lower case them to match unpackUUID()
+ */
+static void lowerUUID(char uuid[]) {
+  for( char* c=uuid; *c; c++ ) {*c = tolower(*c);}
+}
+
+static void put16(uint8_t* p, uint16_t v) {p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF;}
+static void put32(uint8_t* p, uint32_t v) {put16(p,v & 0xFFFF); put16(p+2,(v >> 16) & 0xFFFF);}
+static uint16_t get16(const uint8_t* p)   {return (uint16_t)(p[0] | (p[1] << 8));}
+static uint32_t get32(const uint8_t* p)   {return (uint32_t)get16(p) | ((uint32_t)get16(p+2) << 16);}
+
+/**
+ *  Copy the value of a :field: from a DESC header value, up to the next ':'
+ */
+static boolean descField(const char* desc, const char* field, char buffer[], size_t size) {
+  buffer[0] = '\0';
+  const char* start = strstr(desc,field);
+  if( start == NULL ) return false;
+  start += strlen(field);
+  const char* end = strchr(start,':');
+  size_t len = ((end != NULL)?(end - start):(strlen(start)));
+  if( len >= size ) len = size - 1;
+  memcpy(buffer,start,len);
+  buffer[len] = '\0';
+  return true;
+}
+
+SSDPRecord::SSDPRecord() {
+  _uuid[0]  = '\0';
+  _puuid[0] = '\0';
+  _name[0]  = '\0';
+  _path[0]  = '\0';
+}
+
+uint32_t SSDPRecord::hash(const char* s) {
+  uint32_t h = 2166136261UL;
+  while( *s != '\0' ) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+boolean SSDPRecord::isBinary(const char* buffer, int len) {
+  return ((len >= SSDP_BIN_HEADER_SIZE) && (memcmp_P(buffer,BIN_MAGIC,4) == 0) && ((uint8_t)buffer[4] == SSDP_BIN_VERSION));
+}
+
+void SSDPRecord::writeHeader(uint8_t buffer[], int count, uint32_t txn, uint32_t stHash) {
+  memcpy_P(buffer,BIN_MAGIC,4);
+  buffer[4] = SSDP_BIN_VERSION;
+  buffer[5] = count;
+  put16(buffer+6,0);
+  put32(buffer+8,txn);
+  put32(buffer+12,stHash);
+}
+
+int SSDPRecord::readHeader(const char* buffer, int len, uint32_t* txn, uint32_t* stHash) {
+  if( !isBinary(buffer,len) ) return -1;
+  const uint8_t* data = (const uint8_t*)buffer;
+  if( txn != NULL )    *txn    = get32(data+8);
+  if( stHash != NULL ) *stHash = get32(data+12);
+  return data[5];
+}
+
+void SSDPRecord::location(char buffer[], int size) {
+  snprintf(buffer,size,"http://%s:%d%s",_addr.toString().c_str(),_port,_path);
+}
+
+/**
+ *  RootDevice location is the root of the web server, matching the text response
+ */
+void SSDPRecord::set(UPnPDevice* d, IPAddress addr) {
+  RootDevice* r = d->asRootDevice();
+  UPnPDevice* p = d->parentAsDevice();
+  RootDevice* root = d->rootDevice();
+  _kind     = ((r != NULL)?(SSDP_ROOT_RECORD):(SSDP_DEVICE_RECORD));
+  _devices  = ((r != NULL)?(r->numDevices()):(0));
+  _services = d->numServices();
+  _type     = typeID(d->getType());
+  _addr     = addr;
+  _port     = ((root != NULL)?(root->serverPort()):(0));
+  strlcpy(_uuid,d->uuid(),UUID_SIZE);
+  strlcpy(_puuid,((p != NULL)?(p->uuid()):("")),UUID_SIZE);
+  strlcpy(_name,d->getDisplayName(),NAME_SIZE);
+  if( r != NULL ) strlcpy(_path,"/",SSDP_RECORD_PATH_SIZE);
+  else d->getPath(_path,SSDP_RECORD_PATH_SIZE);
+}
+
+void SSDPRecord::set(UPnPService* s, IPAddress addr) {
+  UPnPDevice* p = s->parentAsDevice();
+  RootDevice* root = ((p != NULL)?(p->rootDevice()):(NULL));
+  _kind     = SSDP_SERVICE_RECORD;
+  _devices  = 0;
+  _services = 0;
+  _type     = typeID(s->getType());
+  _addr     = addr;
+  _port     = ((root != NULL)?(root->serverPort()):(0));
+  strlcpy(_uuid,((p != NULL)?(p->uuid()):("")),UUID_SIZE);
+  strlcpy(_puuid,_uuid,UUID_SIZE);
+  strlcpy(_name,s->getDisplayName(),NAME_SIZE);
+  s->getPath(_path,SSDP_RECORD_PATH_SIZE);
+}
+
+/**
+ *  Text responses are parsed from the USN, LOCATION and DESC.LEELANAUSOFTWARE.COM headers
+ */
+boolean SSDPRecord::parse(UPnPBuffer& buffer) {
+  char usn[UUID_SIZE + 100];
+  char loc[SSDP_RECORD_PATH_SIZE + 32];
+  char desc[200];
+  if( !buffer.headerValue_P(REC_USN,usn,sizeof(usn)) || !buffer.headerValue_P(REC_DESC,desc,sizeof(desc)) ) return false;
+
+  char* type = strstr(usn,"::");
+  if( (strncmp(usn,"uuid:",5) != 0) || (type == NULL) ) return false;
+  *type = '\0';
+  type += 2;
+  strlcpy(_uuid,usn+5,UUID_SIZE);
+  lowerUUID(_uuid);
+  _type = typeID(type);
+
+  char field[8];
+  descField(desc,":name:",_name,NAME_SIZE);
+  _devices  = (descField(desc,":devices:",field,sizeof(field))?(atoi(field)):(0));
+  _services = (descField(desc,":services:",field,sizeof(field))?(atoi(field)):(0));
+  if( descField(desc,":puuid:",_puuid,UUID_SIZE) ) _kind = ((strstr_P(type,REC_SERVICE) != NULL)?(SSDP_SERVICE_RECORD):(SSDP_DEVICE_RECORD));
+  else _kind = SSDP_ROOT_RECORD;
+  lowerUUID(_puuid);
+
+  _addr = IPAddress();
+  _port = 0;
+  _path[0] = '\0';
+  if( buffer.headerValue_P(REC_LOCATION,loc,sizeof(loc)) && (strncmp(loc,"http://",7) == 0) ) {
+    char* host = loc + 7;
+    char* path = strchr(host,'/');
+    if( path != NULL ) {
+      strlcpy(_path,path,SSDP_RECORD_PATH_SIZE);
+      *path = '\0';
+    }
+    char* port = strchr(host,':');
+    if( port != NULL ) {
+      *port++ = '\0';
+      _port = atoi(port);
+    }
+    else _port = 80;
+    _addr.fromString(host);
+  }
+  return true;
+}
+
+int SSDPRecord::encode(uint8_t buffer[], int size) {
+  int nameLen = strlen(_name);
+  int pathLen = strlen(_path);
+  int len     = SSDP_BIN_RECORD_SIZE + nameLen + pathLen;
+  if( len > size ) return 0;
+  buffer[0] = _kind;
+  buffer[1] = _devices;
+  buffer[2] = _services;
+  buffer[3] = nameLen;
+  packUUID(_uuid,buffer+4);
+  packUUID(_puuid,buffer+20);
+  put32(buffer+36,_type);
+  for( int i=0; i<4; i++ ) {buffer[40+i] = _addr[i];}
+  put16(buffer+44,_port);
+  buffer[46] = pathLen;
+  buffer[47] = 0;
+  memcpy(buffer+SSDP_BIN_RECORD_SIZE,_name,nameLen);
+  memcpy(buffer+SSDP_BIN_RECORD_SIZE+nameLen,_path,pathLen);
+  return len;
+}
+
+int SSDPRecord::decode(const uint8_t buffer[], int size) {
+  if( size < SSDP_BIN_RECORD_SIZE ) return 0;
+  int nameLen = buffer[3];
+  int pathLen = buffer[46];
+  int len     = SSDP_BIN_RECORD_SIZE + nameLen + pathLen;
+  if( (len > size) || (buffer[0] > SSDP_SERVICE_RECORD) || (nameLen >= NAME_SIZE) || (pathLen >= SSDP_RECORD_PATH_SIZE) ) return 0;
+  _kind     = (SSDPRecordKind)buffer[0];
+  _devices  = buffer[1];
+  _services = buffer[2];
+  unpackUUID(buffer+4,_uuid);
+  unpackUUID(buffer+20,_puuid);
+  _type     = get32(buffer+36);
+  _addr     = IPAddress(buffer[40],buffer[41],buffer[42],buffer[43]);
+  _port     = get16(buffer+44);
+  memcpy(_name,buffer+SSDP_BIN_RECORD_SIZE,nameLen);
+  _name[nameLen] = '\0';
+  memcpy(_path,buffer+SSDP_BIN_RECORD_SIZE+nameLen,pathLen);
+  _path[pathLen] = '\0';
+  return len;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,153 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * SSDPRecord.h
+ *
+ *  Compact binary framing for search responses between LSC devices. A requester asks for binary responses by adding
+ *  the token bin to the ST.LEELANAUSOFTWARE.COM header value, for example "ssdp:all bin". Devices that do not know
+ *  the token ignore it and respond with text, so a requester must accept both forms.
+ *
+ *  A binary response packet is a 16 byte header followed by up to 255 records. Multi-byte fields are little endian
+ *  and IP addresses are in network order:
+ *
+ *    Offset  Size  Packet Header
+ *      0       4   Magic "LSCB"
+ *      4       1   Version (SSDP_BIN_VERSION)
+ *      5       1   Number of records in the packet
+ *      6       2   Reserved
+ *      8       4   Transaction from the TXN.LEELANAUSOFTWARE.COM request header, 0 if none
+ *     12       4   SSDPRecord::hash() of the request ST
+ *
+ *    Offset  Size  Record
+ *      0       1   Kind, SSDPRecordKind
+ *      1       1   Number of embedded devices (RootDevice only)
+ *      2       1   Number of services (RootDevice and UPnPDevice)
+ *      3       1   Length of display name
+ *      4      16   Device uuid, the parent device for a UPnPService
+ *     20      16   Parent device uuid, zero for a RootDevice
+ *     36       4   Type ID, SSDPRecord::typeID() of the device or service type
+ *     40       4   IP address of the location
+ *     44       2   Port of the location
+ *     46       1   Length of location path
+ *     47       1   Reserved
+ *     48       n   Display name, followed by location path, neither null terminated
+ *
+ *  A record is 48 bytes plus name and path, several times smaller than the equivalent text response, and several
+ *  records share one packet. Type IDs are a 32 bit hash of the type string, so a record is compared against a known
+ *  type with isType() rather than carrying the type itself.
+ */
+
+#ifndef SSDP_RECORD_H
+#define SSDP_RECORD_H
+
+#include "UPnPBuffer.h"
+#include "UPnPDevice.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define SSDP_BIN_VERSION        1
+#define SSDP_BIN_HEADER_SIZE    16
+#define SSDP_BIN_RECORD_SIZE    48              // Fixed part of a record
+#ifndef SSDP_BIN_PACKET_SIZE
+#define SSDP_BIN_PACKET_SIZE    512             // Largest binary response packet sent
+#endif
+#define SSDP_RECORD_PATH_SIZE   100
+
+typedef enum {
+  SSDP_ROOT_RECORD    = 0,
+  SSDP_DEVICE_RECORD  = 1,
+  SSDP_SERVICE_RECORD = 2
+} SSDPRecordKind;
+
+/** SSDPRecord class definition
+ *  A single search response, decoded from either a binary record or a text response.
+ *  Class members are as follows:
+ *    kind()                        := RootDevice, UPnPDevice or UPnPService
+ *    uuid()                        := Device uuid, for a UPnPService the uuid of its parent device, in lower case
+ *    puuid()                       := Parent device uuid, empty for a RootDevice, in lower case
+ *    displayName()                 := Display name of the device or service
+ *    typeID()/isType(t)            := Type ID of the device or service, isType() returns true if t hashes to the same ID
+ *    address()/port()/path()       := Location of the device or service
+ *    location(buffer,size)         := Location as a URL, http://address:port/path
+ *    numDevices()/numServices()    := Device and service counts from the response
+ *    set(d,addr)/set(s,addr)       := Fill from a local UPnPDevice or UPnPService, with location on interface addr
+ *    parse(buffer)                 := Fill from a text search response, returns false if required headers are missing
+ *    encode(buffer,size)           := Write the binary record, returns bytes written or 0 if the record does not fit
+ *    decode(buffer,size)           := Read a binary record, returns bytes read or 0 if the record is truncated
+ *    isBinary(buffer,len)          := Returns true if a packet is a binary response packet
+ *    writeHeader(buffer,...)       := Write a binary packet header with count records
+ *    readHeader(buffer,len,...)    := Read a binary packet header, returns the number of records or -1 if not a binary packet
+ *    hash(s)                       := 32 bit FNV-1a hash of a string
+ */
+class SSDPRecord {
+  public:
+    SSDPRecord();
+
+    SSDPRecordKind  kind()                               {return _kind;}
+    boolean         isRootDevice()                       {return (_kind == SSDP_ROOT_RECORD);}
+    boolean         isService()                          {return (_kind == SSDP_SERVICE_RECORD);}
+    const char*     uuid()                               {return _uuid;}
+    const char*     puuid()                              {return _puuid;}
+    const char*     displayName()                        {return _name;}
+    uint32_t        typeID()                             {return _type;}
+    boolean         isType(const char* t)                {return (typeID(t) == _type);}
+    IPAddress       address()                            {return _addr;}
+    int             port()                               {return _port;}
+    const char*     path()                               {return _path;}
+    int             numDevices()                         {return _devices;}
+    int             numServices()                        {return _services;}
+    void            location(char buffer[], int size);
+
+    void            set(UPnPDevice* d, IPAddress addr);
+    void            set(UPnPService* s, IPAddress addr);
+    boolean         parse(UPnPBuffer& buffer);
+    int             encode(uint8_t buffer[], int size);
+    int             decode(const uint8_t buffer[], int size);
+
+    static boolean  isBinary(const char* buffer, int len);
+    static void     writeHeader(uint8_t buffer[], int count, uint32_t txn, uint32_t stHash);
+    static int      readHeader(const char* buffer, int len, uint32_t* txn, uint32_t* stHash);
+    static uint32_t typeID(const char* type)             {return hash(type);}
+    static uint32_t hash(const char* s);
+
+  private:
+    SSDPRecordKind  _kind = SSDP_ROOT_RECORD;
+    uint8_t         _devices = 0;
+    uint8_t         _services = 0;
+    uint32_t        _type = 0;
+    IPAddress       _addr;
+    uint16_t        _port = 0;
+    char            _uuid[UUID_SIZE];
+    char            _puuid[UUID_SIZE];
+    char            _name[NAME_SIZE];
+    char            _path[SSDP_RECORD_PATH_SIZE];
+};
+
+typedef std::function<void(SSDPRecord*)> SSDPRecordHandler;
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,390 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SSDPRelay.h"
+
+namespace lsc {
+
+#define RELAY_HEADER_SIZE   (RELAY_MAX_HOPS*9+1)
+#define RELAY_LOC_SIZE      128
+#define RELAY_LSC_SIZE      40
+
+/** Header field constants
+ *
+ */
+const char RELAY_M_SEARCH[]       PROGMEM = "M-SEARCH";
+const char RELAY_RESPONSE[]       PROGMEM = "HTTP/1.1";
+const char RELAY_HEADER[]         PROGMEM = "RELAY.LEELANAUSOFTWARE.COM";
+const char RELAY_ST_LSC_HEADER[]  PROGMEM = "ST.LEELANAUSOFTWARE.COM";
+const char RELAY_ST_HEADER[]      PROGMEM = "ST";
+const char RELAY_DESC_HEADER[]    PROGMEM = "DESC.LEELANAUSOFTWARE.COM";
+const char RELAY_LOC_HEADER[]     PROGMEM = "LOCATION";
+const char RELAY_HEADER_LINE[]    PROGMEM = "RELAY.LEELANAUSOFTWARE.COM: %s%s%08lx\r\n";
+const char RELAY_LOC_LINE[]       PROGMEM = "LOCATION: %s\r\n";
+const char RELAY_ST_LSC_LINE[]    PROGMEM = "ST.LEELANAUSOFTWARE.COM: %s\r\n";
+const char RELAY_BIN_TOKEN[]      PROGMEM = "bin";
+
+/**
+ *  Return the start of the line for header in a raw packet buffer, or NULL if not present
+ */
+static char* findHeaderLine(char* buffer, PGM_P header) {
+  size_t len = strlen_P(header);
+  char* line = buffer;
+  while( line != NULL ) {
+    char* end = strstr(line,"\r\n");
+    if( (end == NULL) || (end == line) ) return NULL;
+    if( (strncmp_P(line,header,len) == 0) && ((line[len] == ':') || (line[len] == ' ')) ) return line;
+    line = end + 2;
+  }
+  return NULL;
+}
+
+/**
+ *  Remove the line starting at line from a packet buffer of length len, returns the new length
+ */
+static int removeHeaderLine(char* buffer, int len, char* line) {
+  char* end = strstr(line,"\r\n");
+  if( end == NULL ) return len;
+  end += 2;
+  memmove(line,end,len - (end - buffer) + 1);
+  return len - (end - line);
+}
+
+/**
+ *  Insert text as the last header line of a packet buffer of length len, returns the new length or -1 if
+ *  the packet would exceed size
+ */
+static int insertHeaderLine(char* buffer, int len, int size, const char* text) {
+  char* at = strstr(buffer,"\r\n\r\n");
+  int   n  = strlen(text);
+  if( (at == NULL) || (len + n > size) ) return -1;
+  at += 2;
+  memmove(at+n,at,len - (at - buffer) + 1);
+  memcpy(at,text,n);
+  return len + n;
+}
+
+/**
+ *  Remove the space separated token bin from an ST.LEELANAUSOFTWARE.COM value in place, returns true if it was present
+ */
+static boolean stripBinToken(char value[]) {
+  boolean     result = false;
+  char*       out    = value;
+  const char* p      = value;
+  while( *p != '\0' ) {
+    while( *p == ' ' ) {p++;}
+    const char* end = p;
+    while( (*end != '\0') && (*end != ' ') ) {end++;}
+    size_t n = end - p;
+    if( (n == 3) && (strncmp_P(p,RELAY_BIN_TOKEN,3) == 0) ) result = true;
+    else if( n > 0 ) {
+      if( out != value ) *out++ = ' ';
+      memmove(out,p,n);
+      out += n;
+    }
+    p = end;
+  }
+  *out = '\0';
+  return result;
+}
+
+static uint32_t fnv(uint32_t h, const void* data, size_t len) {
+  const uint8_t* c = (const uint8_t*)data;
+  for( size_t i=0; i<len; i++ ) {h ^= c[i]; h *= 16777619UL;}
+  return h;
+}
+
+SSDPRelay::SSDPRelay() {
+  _id = hardwareRandom();
+  memset(&_stats,0,sizeof(_stats));
+  memset(_recent,0,sizeof(_recent));
+  for( int i=0; i<RELAY_MAX_PENDING; i++ ) {_pending[i].port = 0;}
+  _searchBucket   = {(float)RELAY_SEARCH_BURST,0};
+  _responseBucket = {(float)RELAY_RESPONSE_BURST,0};
+}
+
+SSDPRelay::~SSDPRelay() {
+  _mWifiUdp.stop();
+  for( int i=0; i<_numInterfaces; i++ ) {_ifc[i].wifiUdp.stop();}
+}
+
+boolean SSDPRelay::addInterface(IPAddress addr, IPAddress mask, UDP* channel) {
+  boolean result = false;
+  if( _numInterfaces < RELAY_MAX_INTERFACES ) {
+    _ifc[_numInterfaces].addr = addr;
+    _ifc[_numInterfaces].mask = mask;
+    _ifc[_numInterfaces].udp  = ((channel != NULL)?(channel):(&_ifc[_numInterfaces].wifiUdp));
+    _numInterfaces++;
+    result = true;
+  }
+  else SSDP_LOG_WARNING("SSDPRelay::addInterface: Interface limit of %d reached\n",RELAY_MAX_INTERFACES);
+  return result;
+}
+
+/**
+ *  Caller supplied channels are started with begin(UDP_PORT) for multicast and begin(0) for interfaces
+ */
+void SSDPRelay::begin(UDP* multicast) {
+  _mUdp = ((multicast != NULL)?(multicast):(&_mWifiUdp));
+  if( multicast != NULL ) multicast->begin(UDP_PORT);
+#ifdef ESP32
+  else _mWifiUdp.beginMulticast(IPAddress(239,255,255,250),UDP_PORT);
+  for( int i=0; i<_numInterfaces; i++ ) {
+    if( _ifc[i].udp == &_ifc[i].wifiUdp ) _ifc[i].wifiUdp.begin(_ifc[i].addr,0);
+    else _ifc[i].udp->begin(0);
+  }
+#else
+  else _mWifiUdp.beginMulticast(INADDR_ANY,IPAddress(239,255,255,250),UDP_PORT);
+  for( int i=0; i<_numInterfaces; i++ ) {_ifc[i].udp->begin(0);}
+#endif
+  _searchBucket.time   = millis();
+  _responseBucket.time = millis();
+}
+
+void SSDPRelay::doRelay() {
+  if( _mUdp->parsePacket() > 0 ) readSearch();
+  for( int i=0; i<_numInterfaces; i++ ) {
+    if( _ifc[i].udp->parsePacket() > 0 ) readResponse(i);
+  }
+}
+
+int SSDPRelay::interfaceOf(IPAddress addr) {
+  int result = -1;
+  for( int i=0; (i<_numInterfaces) && (result < 0); i++ ) {
+    uint32_t mask = (uint32_t)_ifc[i].mask;
+    if( (((uint32_t)addr) & mask) == (((uint32_t)_ifc[i].addr) & mask) ) result = i;
+  }
+  return result;
+}
+
+boolean SSDPRelay::isDuplicate(uint32_t hash) {
+  unsigned long now = millis();
+  for( int i=0; i<RELAY_DEDUP_SIZE; i++ ) {
+    if( (_recent[i].hash == hash) && (now - _recent[i].time < RELAY_DEDUP_WINDOW) ) return true;
+  }
+  _recent[_nextRecent].hash = hash;
+  _recent[_nextRecent].time = now;
+  _nextRecent = (_nextRecent + 1) % RELAY_DEDUP_SIZE;
+  return false;
+}
+
+boolean SSDPRelay::take(Bucket& b, int rate, int burst) {
+  unsigned long now = millis();
+  b.tokens += ((float)(now - b.time)) * rate / 1000.0;
+  if( b.tokens > burst ) b.tokens = burst;
+  b.time = now;
+  if( b.tokens < 1.0 ) return false;
+  b.tokens -= 1.0;
+  return true;
+}
+
+/**
+ *  Read a search request from the multicast channel and forward it to all other interfaces if it is an LSC
+ *  search that has not looped, is not a duplicate, and is within the search rate.
+ */
+void SSDPRelay::readSearch() {
+  IPAddress remoteAddr = _mUdp->remoteIP();
+  int       port       = _mUdp->remotePort();
+  int       len        = _mUdp->read(_buffer,RELAY_BUFFER_SIZE);
+  if( len <= 0 ) return;
+  _buffer[len] = '\0';
+  if( strncmp_P(_buffer,RELAY_M_SEARCH,8) != 0 ) return;
+
+  int ingress = interfaceOf(remoteAddr);
+  if( ingress < 0 ) return;
+
+  UPnPBuffer buffer = UPnPBuffer(_buffer);
+  char lsc[20];
+  char st[RELAY_ST_SIZE];
+  if( !buffer.headerValue_P(RELAY_ST_LSC_HEADER,lsc,sizeof(lsc)) ) return;
+  if( !buffer.headerValue_P(RELAY_ST_HEADER,st,sizeof(st)) ) return;
+
+  char relays[RELAY_HEADER_SIZE];
+  relays[0] = '\0';
+  if( buffer.headerValue_P(RELAY_HEADER,relays,sizeof(relays)) ) {
+    char id[9];
+    snprintf(id,sizeof(id),"%08lx",(unsigned long)_id);
+    int hops = 1;
+    for( const char* c=relays; *c; c++ ) {if( *c == ',' ) hops++;}
+    if( (strstr(relays,id) != NULL) || (hops >= RELAY_MAX_HOPS) || buffer.truncated() ) {      // Already relayed RELAY_MAX_HOPS times
+      _stats.searchesLooped++;
+      return;
+    }
+  }
+
+  uint32_t hash = 2166136261UL;
+  uint32_t addr = (uint32_t)remoteAddr;
+  hash = fnv(hash,&addr,sizeof(addr));
+  hash = fnv(hash,&port,sizeof(port));
+  hash = fnv(hash,st,strlen(st));
+  hash = fnv(hash,lsc,strlen(lsc));
+  if( isDuplicate(hash) ) {
+    _stats.searchesDuplicate++;
+    return;
+  }
+  if( !take(_searchBucket,RELAY_SEARCH_RATE,RELAY_SEARCH_BURST) ) {
+    _stats.searchesRateLimited++;
+    SSDP_LOG_FINE("SSDPRelay::readSearch: Search from %s rate limited\n",remoteAddr.toString().c_str());
+    return;
+  }
+
+/**
+ *  Remember the requester so responses can be routed back, replacing the oldest entry if all are in use
+ */
+  unsigned long now = millis();
+  int slot = 0;
+  for( int i=0; i<RELAY_MAX_PENDING; i++ ) {
+    if( (_pending[i].port == 0) || (now - _pending[i].time >= RELAY_RESPONSE_WINDOW) ) {slot = i; break;}
+    if( _pending[i].time < _pending[slot].time ) slot = i;
+  }
+  _pending[slot].requester = remoteAddr;
+  _pending[slot].port      = port;
+  _pending[slot].ingress   = ingress;
+  _pending[slot].time      = now;
+  strlcpy(_pending[slot].st,st,RELAY_ST_SIZE);
+
+  if( forward(ingress,len) ) _stats.searchesForwarded++;
+}
+
+/**
+ *  Add this relay to the RELAY header, remove the bin token so responders answer in text, and multicast the search 
+ *  on all interfaces except ingress
+ */
+boolean SSDPRelay::forward(int ingress, int len) {
+  char relays[RELAY_HEADER_SIZE];
+  relays[0] = '\0';
+  char* line = findHeaderLine(_buffer,RELAY_HEADER);
+  if( line != NULL ) {
+    UPnPBuffer buffer = UPnPBuffer(_buffer);
+    buffer.headerValue_P(RELAY_HEADER,relays,sizeof(relays));
+    len = removeHeaderLine(_buffer,len,line);
+  }
+  char relayLine[RELAY_HEADER_SIZE+40];
+  snprintf_P(relayLine,sizeof(relayLine),RELAY_HEADER_LINE,relays,((relays[0]!='\0')?(","):("")),(unsigned long)_id);
+  len = insertHeaderLine(_buffer,len,RELAY_BUFFER_SIZE,relayLine);
+  if( len < 0 ) return false;
+
+  char* lscLine = findHeaderLine(_buffer,RELAY_ST_LSC_HEADER);
+  if( lscLine != NULL ) {
+    char lsc[RELAY_LSC_SIZE];
+    UPnPBuffer buffer = UPnPBuffer(_buffer);
+    buffer.headerValue_P(RELAY_ST_LSC_HEADER,lsc,sizeof(lsc));
+    if( stripBinToken(lsc) ) {
+      char line[RELAY_LSC_SIZE+30];
+      snprintf_P(line,sizeof(line),RELAY_ST_LSC_LINE,lsc);
+      len = removeHeaderLine(_buffer,len,lscLine);
+      len = insertHeaderLine(_buffer,len,RELAY_BUFFER_SIZE,line);
+      if( len < 0 ) return false;
+    }
+  }
+
+  boolean result = true;
+  for( int i=0; i<_numInterfaces; i++ ) {
+    if( i != ingress ) {
+      int ok = 0;
+#ifdef ESP32
+      ok = _ifc[i].udp->beginPacket(IPAddress(239,255,255,250),UDP_PORT);
+#else
+      if( _ifc[i].udp == &_ifc[i].wifiUdp ) ok = _ifc[i].wifiUdp.beginPacketMulticast(IPAddress(239,255,255,250),UDP_PORT,_ifc[i].addr);
+      else ok = _ifc[i].udp->beginPacket(IPAddress(239,255,255,250),UDP_PORT);
+#endif
+      if( ok == 1 ) {
+        _ifc[i].udp->write((const unsigned char*)_buffer,len);
+        ok = _ifc[i].udp->endPacket();
+      }
+      if( ok != 1 ) {
+        result = false;
+        _stats.sendErrors++;
+        SSDP_LOG_WARNING("SSDPRelay::forward: Error forwarding search to %s\n",_ifc[i].addr.toString().c_str());
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ *  Read a response on the egress channel and route it to each requester with a pending search for the same ST
+ */
+void SSDPRelay::readResponse(int egress) {
+  int len = _ifc[egress].udp->read(_buffer,RELAY_BUFFER_SIZE);
+  if( len <= 0 ) return;
+  _buffer[len] = '\0';
+  if( strncmp_P(_buffer,RELAY_RESPONSE,8) != 0 ) return;
+
+  char st[RELAY_ST_SIZE];
+  char location[RELAY_LOC_SIZE];
+  location[0] = '\0';
+  {
+    UPnPBuffer buffer = UPnPBuffer(_buffer);
+    char desc[8];
+    if( !buffer.headerValue_P(RELAY_DESC_HEADER,desc,sizeof(desc)) ) return;
+    if( !buffer.headerValue_P(RELAY_ST_HEADER,st,sizeof(st)) ) return;
+    buffer.headerValue_P(RELAY_LOC_HEADER,location,sizeof(location));
+  }
+
+  boolean matched = false;
+  unsigned long now = millis();
+  for( int i=0; i<RELAY_MAX_PENDING; i++ ) {
+    Pending& p = _pending[i];
+    if( (p.port != 0) && (p.ingress != egress) && (now - p.time < RELAY_RESPONSE_WINDOW) && (strcmp(p.st,st) == 0) ) {
+      matched = true;
+      if( !take(_responseBucket,RELAY_RESPONSE_RATE,RELAY_RESPONSE_BURST) ) {
+        _stats.responsesRateLimited++;
+        continue;
+      }
+      if( _rewrite != NULL ) {
+        char rewritten[RELAY_LOC_SIZE];
+        strlcpy(rewritten,location,sizeof(rewritten));
+/**
+ *      LOCATION is rebuilt for every requester so a rewrite for one ingress never leaks to another
+ */
+        _rewrite(rewritten,sizeof(rewritten),_ifc[p.ingress].addr,_ifc[egress].addr);
+        {
+          char* line = findHeaderLine(_buffer,RELAY_LOC_HEADER);
+          if( line != NULL ) len = removeHeaderLine(_buffer,len,line);
+          char locLine[RELAY_LOC_SIZE+16];
+          snprintf_P(locLine,sizeof(locLine),RELAY_LOC_LINE,rewritten);
+          int newLen = insertHeaderLine(_buffer,len,RELAY_BUFFER_SIZE,locLine);
+          if( newLen < 0 ) continue;
+          len = newLen;
+        }
+      }
+      if( send(*_ifc[p.ingress].udp,p.requester,p.port,len) ) _stats.responsesRelayed++;
+    }
+  }
+  if( !matched ) _stats.responsesUnmatched++;
+}
+
+boolean SSDPRelay::send(UDP& udp, IPAddress addr, int port, int len) {
+  int ok = udp.beginPacket(addr,port);
+  if( ok == 1 ) {
+    udp.write((const unsigned char*)_buffer,len);
+    ok = udp.endPacket();
+  }
+  if( ok != 1 ) {
+    _stats.sendErrors++;
+    SSDP_LOG_WARNING("SSDPRelay::send: Error sending %d bytes to %s:%d\n",len,addr.toString().c_str(),port);
+  }
+  return (ok == 1);
+}
+
+} // End of namespace lsc
@@ -0,0 +1,167 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * SSDPRelay.h
+ *
+ *  Relay of LSC SSDP search requests and responses between network interfaces. Multicast to 239.255.255.250 does not
+ *  cross subnet boundaries, so a relay attached to several subnets listens for M-SEARCH requests carrying the
+ *  ST.LEELANAUSOFTWARE.COM header, multicasts them on every other interface, and routes the unicast responses
+ *  back to the original requester.
+ *
+ *  Forwarded search requests carry a RELAY.LEELANAUSOFTWARE.COM header listing the ids of the relays they passed
+ *  through. A relay drops any request already carrying its own id, or already carrying RELAY_MAX_HOPS ids, so a
+ *  request crosses at most RELAY_MAX_HOPS relays and relay loops cannot form. Relay ids come from the hardware random
+ *  number generator, so relays running the same firmware do not mistake each other for themselves. Requests are also
+ *  de-duplicated over RELAY_DEDUP_WINDOW milliseconds, and both forwarded requests and relayed responses are limited
+ *  by token buckets, so a storm on one side cannot flood the other.
+ *
+ *  Only text responses with a DESC.LEELANAUSOFTWARE.COM header are relayed. The bin token is removed from the
+ *  ST.LEELANAUSOFTWARE.COM header of forwarded searches, so responders across the relay answer in text, which
+ *  SSDP::searchRecords() also decodes, and LOCATION can be rewritten. The LOCATION header is forwarded unchanged
+ *  unless a LocationRewrite function is set, for example when the requester cannot route to the responder subnet
+ *  and a proxy address must be substituted.
+ */
+
+#ifndef SSDP_RELAY_H
+#define SSDP_RELAY_H
+
+#include "ssdp.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#define RELAY_MAX_INTERFACES    4
+#define RELAY_MAX_PENDING       8              // Concurrent forwarded searches awaiting responses
+#define RELAY_MAX_HOPS          4              // Relays a search may cross
+#define RELAY_DEDUP_SIZE        16
+#define RELAY_DEDUP_WINDOW      2000           // Milliseconds a forwarded search is remembered for de-duplication
+#define RELAY_RESPONSE_WINDOW   10000          // Milliseconds responses are routed back for a forwarded search
+#define RELAY_SEARCH_RATE       5              // Forwarded searches per second, sustained
+#define RELAY_SEARCH_BURST      10
+#define RELAY_RESPONSE_RATE     50             // Relayed responses per second, sustained
+#define RELAY_RESPONSE_BURST    50
+#define RELAY_BUFFER_SIZE       1536
+#define RELAY_ST_SIZE           100
+
+/**
+ *  Rewrite location in place for a response received on egress and relayed to a requester on ingress.
+ *  Return true if location was changed.
+ */
+typedef std::function<boolean(char location[], size_t size, IPAddress ingress, IPAddress egress)> LocationRewrite;
+
+/** RelayStatistics
+ *  Counters for relay activity, available from SSDPRelay::statistics()
+ */
+typedef struct {
+  uint32_t searchesForwarded;
+  uint32_t searchesDuplicate;
+  uint32_t searchesLooped;
+  uint32_t searchesRateLimited;
+  uint32_t responsesRelayed;
+  uint32_t responsesUnmatched;
+  uint32_t responsesRateLimited;
+  uint32_t sendErrors;
+} RelayStatistics;
+
+/** SSDPRelay class definition
+ *  Class members are as follows:
+ *    addInterface(addr,mask)   := Add a network interface to relay between, up to RELAY_MAX_INTERFACES
+ *    addInterface(addr,mask,c) := As above, sending and receiving on the caller supplied UDP channel c
+ *    begin()                   := Start listening, must be called after all interfaces are added
+ *    begin(multicast)          := As above, listening for searches on the caller supplied UDP channel
+ *    doRelay()                 := Called in the Arduino loop(); forwards one search and one response per interface
+ *    setLocationRewrite(f)     := Set a LocationRewrite applied to relayed responses
+ *    statistics()              := Relay counters
+ */
+class SSDPRelay {
+  public:
+    SSDPRelay();
+    virtual ~SSDPRelay();
+
+    boolean                 addInterface(IPAddress addr, IPAddress mask, UDP* channel=NULL);
+    void                    begin(UDP* multicast=NULL);
+    void                    doRelay();
+    void                    setLocationRewrite(LocationRewrite f)    {_rewrite = f;}
+    const RelayStatistics&  statistics()                             {return _stats;}
+    uint32_t                relayID()                                {return _id;}
+
+  private:
+
+    typedef struct {
+      IPAddress     addr;
+      IPAddress     mask;
+      WiFiUDP       wifiUdp;
+      UDP*          udp;                       // Forwarded searches are sent, and their responses received, on this channel
+    } Interface;
+
+    typedef struct {
+      IPAddress     requester;
+      int           port;
+      int           ingress;
+      unsigned long time;
+      char          st[RELAY_ST_SIZE];
+    } Pending;
+
+    typedef struct {
+      uint32_t      hash;
+      unsigned long time;
+    } Recent;
+
+    typedef struct {
+      float         tokens;
+      unsigned long time;
+    } Bucket;
+
+    uint32_t           _id;
+    WiFiUDP            _mWifiUdp;
+    UDP*               _mUdp = &_mWifiUdp;         // Multicast listener for all interfaces, _mWifiUdp unless begin() was given a channel
+    Interface          _ifc[RELAY_MAX_INTERFACES];
+    int                _numInterfaces = 0;
+    Pending            _pending[RELAY_MAX_PENDING];
+    Recent             _recent[RELAY_DEDUP_SIZE];
+    int                _nextRecent = 0;
+    Bucket             _searchBucket;
+    Bucket             _responseBucket;
+    LocationRewrite    _rewrite = NULL;
+    RelayStatistics    _stats;
+    char               _buffer[RELAY_BUFFER_SIZE + 1];
+
+    int                interfaceOf(IPAddress addr);
+    void               readSearch();
+    void               readResponse(int egress);
+    boolean            isDuplicate(uint32_t hash);
+    boolean            take(Bucket& b, int rate, int burst);
+    boolean            forward(int ingress, int len);
+    boolean            send(UDP& udp, IPAddress addr, int port, int len);
+
+/**
+ *   Copy construction and assignment are not allowed
+ */
+     DEFINE_EXCLUSIONS(SSDPRelay);
+};
+
+} // End of namespace lsc
+
+#endif
@@ -0,0 +1,76 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "SearchTracker.h"
+
+namespace lsc {
+
+void SearchTracker::begin(unsigned long now, boolean all) {
+  memset(&_stats,0,sizeof(_stats));
+  _stats.sent = now;
+  _all        = all;
+  _numSeen    = 0;
+}
+
+/**
+ *  A response is identified by device uuid, type and location path, so services of the same type on one device are
+ *  distinct. Once SEARCH_TRACKER_SEEN responses are remembered, further responses are not checked for duplicates.
+ */
+void SearchTracker::response(SSDPRecord& record, unsigned long now) {
+  uint32_t key = SSDPRecord::hash(record.uuid());
+  key = key * 31 + record.typeID();
+  key = key * 31 + SSDPRecord::hash(record.path());
+  for( int i=0; i<_numSeen; i++ ) {
+    if( _seen[i] == key ) {
+      _stats.duplicates++;
+      return;
+    }
+  }
+  if( _numSeen < SEARCH_TRACKER_SEEN ) _seen[_numSeen++] = key;
+
+  if( _stats.responses == 0 ) _stats.first = now;
+  _stats.last = now;
+  _stats.responses++;
+  if( _all ) {
+    if( record.isRootDevice() ) _stats.expected += 1 + record.numDevices() + record.numServices();
+    else if( !record.isService() ) _stats.expected += record.numServices();
+  }
+}
+
+void SearchTracker::end(unsigned long now, SSDPSearchMetrics& metrics) {
+  _stats.end     = now;
+  _stats.missing = ((_stats.expected > _stats.responses)?(_stats.expected - _stats.responses):(0));
+  metrics.sessions++;
+  metrics.responses   += _stats.responses;
+  metrics.duplicates  += _stats.duplicates;
+  metrics.nonMatching += _stats.nonMatching;
+  metrics.missing     += _stats.missing;
+  if( _stats.responses > 0 ) {
+    metrics.first.add(_stats.first - _stats.sent);
+    metrics.last.add(_stats.last - _stats.sent);
+  }
+  else metrics.empty++;
+  metrics.duration.add(now - _stats.sent);
+  metrics.lastSession = _stats;
+}
+
+} // End of namespace lsc
@@ -0,0 +1,110 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * SearchTracker.h
+ *
+ *  Per session statistics of a search, and their aggregate across sessions. A session records when its request was
+ *  sent, when the first and last responses were read and when it ended, along with the responses it was handed,
+ *  duplicates of responses already seen, and responses for another request. For ssdp:all searches the DESC counts of
+ *  each response say how many more responses to expect: a RootDevice response announces its embedded devices and
+ *  services, and an embedded device response its services. Responses announced but never received are counted as
+ *  missing. This is a lower bound, since the services of an embedded device that never responded are not known.
+ *
+ *  Times are from the clock of the search, milliseconds, and are taken when a response is read rather than when it
+ *  arrived. SSDP::searchRequest() waits 500 ms after sending before reading, so no response is read sooner.
+ */
+
+#ifndef SEARCH_TRACKER_H
+#define SEARCH_TRACKER_H
+
+#include <Arduino.h>
+#include "SSDPRecord.h"
+#include "Histogram.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef SEARCH_TRACKER_SEEN
+#define SEARCH_TRACKER_SEEN  32                 // Distinct responses remembered per session for duplicate detection
+#endif
+
+/** SSDPSearchStats
+ *  One search session. first and last are 0 if there was no response.
+ */
+typedef struct {
+  unsigned long  sent;
+  unsigned long  first;
+  unsigned long  last;
+  unsigned long  end;
+  uint16_t       responses;           // Distinct responses
+  uint16_t       duplicates;          // Responses already seen in this session
+  uint16_t       nonMatching;         // Search responses for another search target or transaction
+  uint16_t       expected;            // Responses announced by DESC counts, ssdp:all searches only
+  uint16_t       missing;             // Announced but not received
+} SSDPSearchStats;
+
+/** SSDPSearchMetrics
+ *  Search sessions aggregated since start up or SSDP::resetSearchMetrics(). Histograms are in milliseconds from the
+ *  request being sent.
+ */
+typedef struct {
+  uint32_t         sessions;
+  uint32_t         empty;             // Sessions that ended without a response
+  uint32_t         responses;
+  uint32_t         duplicates;
+  uint32_t         nonMatching;
+  uint32_t         missing;
+  Histogram        first;             // Time to first response
+  Histogram        last;              // Time to last response
+  Histogram        duration;          // Time to the end of the session, last response plus the timeout
+  SSDPSearchStats  lastSession;
+} SSDPSearchMetrics;
+
+/** SearchTracker class definition
+ *  Class members are as follows:
+ *    begin(now,all)        := Start a session with the request sent at now. all is true for an ssdp:all search
+ *    response(record,now)  := Count a response for this session
+ *    nonMatching()         := Count a search response for another search
+ *    end(now,metrics)      := End the session and add it to metrics
+ *    stats()               := Statistics of the session
+ */
+class SearchTracker {
+  public:
+    void                    begin(unsigned long now, boolean all);
+    void                    response(SSDPRecord& record, unsigned long now);
+    void                    nonMatching()       {_stats.nonMatching++;}
+    void                    end(unsigned long now, SSDPSearchMetrics& metrics);
+    const SSDPSearchStats&  stats()             {return _stats;}
+
+  private:
+    SSDPSearchStats         _stats;
+    boolean                 _all = false;
+    int                     _numSeen = 0;
+    uint32_t                _seen[SEARCH_TRACKER_SEEN];
+};
+
+} // End of namespace lsc
+
+#endif
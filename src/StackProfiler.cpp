@@ -0,0 +1,162 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "StackProfiler.h"
+
+#ifdef ESP8266
+#include <cont.h>
+#endif
+
+namespace lsc {
+
+/**
+ *  The loop runs on the cont stack on ESP8266 and on the loop task stack on ESP32, and in both cases the stack grows 
+ *  down from its start address
+ */
+int StackProfiler::freeNow() {
+  volatile uint8_t here = 0;
+#ifdef ESP8266
+  return (int)((const uint8_t*)&here - (const uint8_t*)g_pcont->stack);
+#elif defined(ESP32)
+  return (int)((const uint8_t*)&here - pxTaskGetStackStart(NULL));
+#else
+  return 0;
+#endif
+}
+
+uint32_t StackProfiler::freeMin() {
+#ifdef ESP8266
+  return ESP.getFreeContStack();
+#elif defined(ESP32)
+  return uxTaskGetStackHighWaterMark(NULL);
+#else
+  return 0;
+#endif
+}
+
+#if STACK_PROFILE
+
+StackPath          StackProfiler::_paths[STACK_MAX_PATHS];
+int                StackProfiler::_numPaths = 0;
+int                StackProfiler::_active   = -1;
+int                StackProfiler::_free     = 0;
+volatile uint8_t*  StackProfiler::_area     = NULL;
+
+int StackProfiler::begin(const char* name) {
+  if( (_active >= 0) || (name == NULL) ) return -1;
+  int id = -1;
+  for( int i=0; (i<_numPaths) && (id < 0); i++ ) {if( strcmp(_paths[i].name,name) == 0 ) id = i;}
+  if( id < 0 ) {
+    if( _numPaths >= STACK_MAX_PATHS ) return -1;
+    id = _numPaths++;
+    memset(&_paths[id],0,sizeof(StackPath));
+    _paths[id].name     = name;
+    _paths[id].headroom = UINT32_MAX;
+  }
+  int avail = freeNow();
+  if( avail < STACK_PAINT_SIZE + STACK_PAINT_MARGIN ) {
+    _paths[id].skipped++;
+    return -1;
+  }
+  _active = id;
+  _free   = avail;
+  paint();
+  return id;
+}
+
+void StackProfiler::end(int id) {
+  if( (id < 0) || (id != _active) ) return;
+  _active = -1;
+  int used = scan();
+  StackPath& p = _paths[id];
+  p.calls++;
+  if( used >= STACK_PAINT_SIZE ) p.saturated++;
+  if( (uint32_t)used > p.peak ) p.peak = used;
+  if( (uint32_t)(_free - used) < p.headroom ) p.headroom = _free - used;
+}
+
+/**
+ *  The region is a local of paint(), so writing it never reaches below the stack pointer. Its address is kept so that
+ *  scan() reads the same bytes, whatever the frame size of end().
+ */
+void __attribute__((noinline)) StackProfiler::paint() {
+  volatile uint8_t area[STACK_PAINT_SIZE];
+  for( int i=0; i<STACK_PAINT_SIZE; i++ ) area[i] = STACK_PATTERN;
+  _area = area;
+}
+
+int __attribute__((noinline)) StackProfiler::scan() {
+  int untouched = 0;
+  while( (untouched < STACK_PAINT_SIZE) && (_area[untouched] == STACK_PATTERN) ) untouched++;
+  return STACK_PAINT_SIZE - untouched;
+}
+
+int              StackProfiler::numPaths()   {return _numPaths;}
+const StackPath* StackProfiler::path(int i)  {return (((i>=0)&&(i<_numPaths))?(&_paths[i]):(NULL));}
+
+void StackProfiler::reset() {
+  for( int i=0; i<_numPaths; i++ ) {
+    const char* name = _paths[i].name;
+    memset(&_paths[i],0,sizeof(StackPath));
+    _paths[i].name     = name;
+    _paths[i].headroom = UINT32_MAX;
+  }
+}
+
+void StackProfiler::formatMetrics(MetricsWriter& w) {
+  char labels[64];
+  if( _numPaths == 0 ) return;
+  w.family("lsc_stack_peak_bytes","gauge","Most stack used below the probe by path");
+  for( int i=0; i<_numPaths; i++ ) {
+    snprintf(labels,sizeof(labels),"path=\"%s\"",_paths[i].name);
+    w.sample("lsc_stack_peak_bytes",labels,_paths[i].peak);
+  }
+  w.family("lsc_stack_headroom_bytes","gauge","Least stack left free below the path");
+  for( int i=0; i<_numPaths; i++ ) {
+    if( _paths[i].calls == 0 ) continue;
+    snprintf(labels,sizeof(labels),"path=\"%s\"",_paths[i].name);
+    w.sample("lsc_stack_headroom_bytes",labels,_paths[i].headroom);
+  }
+  w.family("lsc_stack_saturated_total","counter","Calls that used the whole painted region, so the peak is a lower bound");
+  for( int i=0; i<_numPaths; i++ ) {
+    snprintf(labels,sizeof(labels),"path=\"%s\"",_paths[i].name);
+    w.sample("lsc_stack_saturated_total",labels,_paths[i].saturated);
+  }
+  w.family("lsc_stack_skipped_total","counter","Calls not measured for lack of free stack");
+  for( int i=0; i<_numPaths; i++ ) {
+    snprintf(labels,sizeof(labels),"path=\"%s\"",_paths[i].name);
+    w.sample("lsc_stack_skipped_total",labels,_paths[i].skipped);
+  }
+}
+
+#else
+
+int              StackProfiler::begin(const char* name)          {return -1;}
+void             StackProfiler::end(int id)                      {}
+int              StackProfiler::numPaths()                       {return 0;}
+const StackPath* StackProfiler::path(int i)                      {return NULL;}
+void             StackProfiler::reset()                          {}
+void             StackProfiler::formatMetrics(MetricsWriter& w)  {}
+
+#endif
+
+} // End of namespace lsc
@@ -0,0 +1,123 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * StackProfiler.h
+ *
+ *  Stack high-water profiling of library paths, by stack painting. A probe paints a region of STACK_PAINT_SIZE bytes 
+ *  below the stack pointer, the path runs, and the region is scanned from its deep end for the first byte overwritten.
+ *  The peak of each path is kept by name, along with the least stack left free below it, since overflows on ESP8266
+ *  come from a deep caller and a deep path together. Probes are placed in:
+ *
+ *    ssdp            SSDP::doSSDP(), reading and answering requests
+ *    searchRequest   SSDP::searchRequest(ST,handler,timeout,ssdpAll), including its request buffer
+ *    searchRecords   SSDP::searchRecords(ST,handler,timeout,ssdpAll)
+ *    route paths     Each handler registered with RouteMetrics::on(), so display(), displayRoot(), styles(), metrics()
+ *                    and service handlers, by route
+ *
+ *  A probe measures the stack used below the point where it is placed, so the frame of the function holding it is not
+ *  included, and the frames of the probe itself (a few dozen bytes) are not counted either. Probes do not nest; a probe reached while another is measuring is ignored, and the outer probe counts its
+ *  stack. A call is not measured if less than STACK_PAINT_SIZE + STACK_PAINT_MARGIN bytes are free.
+ *
+ *  Painting costs a pass over STACK_PAINT_SIZE bytes per call, so profiling is off unless the library is built with 
+ *  STACK_PROFILE defined as 1. The least free stack since start up is on the metrics page either way. For worst case 
+ *  bounds without a device, see extras/stack_report.py.
+ */
+
+#ifndef STACK_PROFILER_H
+#define STACK_PROFILER_H
+
+#include <Arduino.h>
+#include "MetricsWriter.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef STACK_PROFILE
+#define STACK_PROFILE        0
+#endif
+
+#ifndef STACK_PAINT_SIZE
+#ifdef ESP8266
+#define STACK_PAINT_SIZE     2560               // The loop stack is 4KB on ESP8266 and 8KB on ESP32
+#else
+#define STACK_PAINT_SIZE     5120
+#endif
+#endif
+
+#define STACK_PAINT_MARGIN   256                // Stack kept free below the painted region, for interrupts
+#define STACK_MAX_PATHS      16
+#define STACK_PATTERN        0xA5
+
+/** StackPath
+ *  Stack statistics of one path since start up or StackProfiler::reset()
+ */
+typedef struct {
+  const char*    name;                          // Not copied, probes use literals and route paths
+  uint32_t       calls;                         // Calls measured
+  uint32_t       skipped;                       // Calls not measured for lack of free stack
+  uint32_t       saturated;                     // Calls that used the whole painted region, so peak is a lower bound
+  uint32_t       peak;                          // Most stack used below the probe
+  uint32_t       headroom;                      // Least stack left free below the path
+} StackPath;
+
+/** StackProfiler class definition
+ *  Class members are as follows:
+ *    begin(name)       := Paint the stack below the caller for path name, and return a probe id to pass to end(), 
+ *                         or -1 if the call is not measured
+ *    end(id)           := Scan the stack painted by begin() and record the peak of the path, ignored for id -1
+ *    freeNow()         := Bytes of stack free below the caller
+ *    freeMin()         := Least stack free since start up, as reported by the platform
+ *    numPaths()        := Number of paths
+ *    path(i)           := Statistics of path i, or NULL if i is out of range
+ *    reset()           := Clear statistics, paths stay registered
+ *    formatMetrics(w)  := Write path statistics in the Prometheus text format
+ */
+class StackProfiler {
+  public:
+    static int               begin(const char* name);
+    static void              end(int id);
+    static int               freeNow();
+    static uint32_t          freeMin();
+    static int               numPaths();
+    static const StackPath*  path(int i);
+    static void              reset();
+    static void              formatMetrics(MetricsWriter& w);
+
+#if STACK_PROFILE
+  private:
+    static StackPath         _paths[STACK_MAX_PATHS];
+    static int               _numPaths;
+    static int               _active;            // Path being measured, or -1
+    static int               _free;              // Stack free at begin()
+    static volatile uint8_t* _area;              // Deep end of the painted region
+
+    static void              paint();
+    static int               scan();
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
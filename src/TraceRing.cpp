@@ -0,0 +1,111 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+#include "TraceRing.h"
+
+namespace lsc {
+
+#if SSDP_TRACE
+
+TraceEvent* TraceRing::_ring     = NULL;
+int         TraceRing::_capacity = 0;
+int         TraceRing::_next     = 0;
+uint32_t    TraceRing::_recorded = 0;
+boolean     TraceRing::_enabled  = false;
+
+boolean TraceRing::begin(int events) {
+  if( _ring == NULL ) {
+    _capacity = ((events < 1)?(1):((events > TRACE_MAX_EVENTS)?(TRACE_MAX_EVENTS):(events)));
+    _ring     = new TraceEvent[_capacity];
+    if( _ring == NULL ) _capacity = 0;
+  }
+  clear();
+  _enabled = (_ring != NULL);
+  return _enabled;
+}
+
+void     TraceRing::enable(boolean flag) {_enabled = flag && (_ring != NULL);}
+int      TraceRing::capacity()           {return _capacity;}
+int      TraceRing::count()              {return ((_recorded < (uint32_t)_capacity)?((int)_recorded):(_capacity));}
+uint32_t TraceRing::recorded()           {return _recorded;}
+
+const TraceEvent* TraceRing::event(int i) {
+  int n = count();
+  if( (i < 0) || (i >= n) ) return NULL;
+  int first = ((n < _capacity)?(0):(_next));
+  return &_ring[(first + i) % _capacity];
+}
+
+void TraceRing::clear() {
+  _next     = 0;
+  _recorded = 0;
+}
+
+#else
+
+boolean           TraceRing::begin(int events)     {return false;}
+void              TraceRing::enable(boolean flag)  {}
+int               TraceRing::capacity()            {return 0;}
+int               TraceRing::count()               {return 0;}
+uint32_t          TraceRing::recorded()            {return 0;}
+const TraceEvent* TraceRing::event(int i)          {return NULL;}
+void              TraceRing::clear()               {}
+
+#endif
+
+/**
+ *  The header line is 
+ *    LSCTRACE version capacity count recorded now-us cpu-MHz
+ *  followed by count lines of
+ *    time event ifc arg data
+ *  in hex, oldest first, and a line END. The time of the dump lets the decoder place events relative to it.
+ */
+void TraceRing::format(MetricsWriter& w) {
+  boolean wasEnabled = enabled();
+  enable(false);
+  int n = count();
+  w.printf("LSCTRACE %d %d %d %lu %lu %lu\n",TRACE_VERSION,capacity(),n,(unsigned long)recorded(),
+           (unsigned long)micros(),(unsigned long)ESP.getCpuFreqMHz());
+  for( int i=0; i<n; i++ ) {
+    const TraceEvent* t = event(i);
+    w.printf("%08lx %02x %02x %04x %08lx\n",(unsigned long)t->time,t->event,t->ifc,t->arg,(unsigned long)t->data);
+  }
+  w.printf("END\n");
+  enable(wasEnabled);
+}
+
+void TraceRing::dump(Print& out) {
+  MetricsWriter w([&out](const char* chunk){out.print(chunk);});
+  format(w);
+}
+
+void TraceRing::send(WebContext* svr) {
+  svr->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  svr->send(200,"text/plain","");
+  {
+    MetricsWriter w([svr](const char* chunk){svr->sendContent(chunk);});
+    format(w);
+  }
+  svr->sendContent("");
+}
+
+} // End of namespace lsc
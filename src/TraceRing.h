@@ -0,0 +1,184 @@
+/**
+ *
+ *  ssdp Library
+ *  Copyright (C) 2023  Daniel L Toth
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as published
+ *  by the Free Software Foundation, either version 3 of the License, or any
+ *  later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ *  The author can be contacted at dan@leelanausoftware.com
+ *
+ */
+
+/**
+ * TraceRing.h
+ *
+ *  Fixed size binary trace of SSDP responder activity. Each event is 12 bytes: a micros() time stamp, an event code, 
+ *  the interface index and two event arguments. Recording an event is a few stores into a ring allocated once by 
+ *  begin(), with no formatting, so the trace can be left running in production without changing the timing being 
+ *  investigated. When the ring is full the oldest events are overwritten. Nothing is recorded until begin() is called.
+ *
+ *  The trace is dumped on demand, as text with one hex encoded event per line, over serial with dump(Serial) or over 
+ *  HTTP with send(), for example by a route added in the sketch:
+ *
+ *    TraceRing::begin(512);
+ *    ctx.on("/trace",[](WebContext* svr){TraceRing::send(svr);});
+ *
+ *  and decoded on a host by extras/trace_decode.py. Recording is paused while dumping so the dump is a consistent 
+ *  snapshot. Build with SSDP_TRACE defined as 0 to remove tracing from the responder.
+ *
+ *  Arguments of an event are only evaluated when recording. Events and their arguments (arg is 16 bits, data is 32 
+ *  bits, addresses are in IPAddress byte order):
+ *    TRACE_RECEIVED      := Packet read, arg is the packet size and data the sender address
+ *    TRACE_FILTERED      := Multicast packet from outside every interface network, data is the sender address
+ *    TRACE_TRUNCATED     := Packet larger than the read buffer, arg is the bytes read
+ *    TRACE_LSC_SEARCH    := LSC search request, arg is 1 if binary records were requested and data is the transaction
+ *    TRACE_OTHER_SEARCH  := Search request without the LSC header, ignored, arg is 1 if rejected by the prefilter
+ *    TRACE_RESPONSE      := Search response, handed to the search sessions, arg is 1 if rejected by the prefilter
+ *    TRACE_OTHER         := Any other packet (NOTIFY, malformed), ignored, arg is 1 if rejected by the prefilter
+ *    TRACE_MATCHED       := LSC search matched, arg is the match kind (TRACE_MATCH_*) and data the ST hash
+ *    TRACE_NO_MATCH      := LSC search without an ST header or for a UUID not on this device, data is the ST hash
+ *    TRACE_QUEUED        := Response rendered, arg is its size in bytes, or a binary record appended
+ *    TRACE_SENT          := Response packet sent, arg is its size and data the destination address
+ *    TRACE_SEND_FAILED   := Response packet could not be sent, arguments as for TRACE_SENT
+ *    TRACE_PACED         := Pacing delay between responses, arg is the delay in milliseconds
+ *    TRACE_REPLIED       := All responses to a request are posted
+ *    TRACE_SEARCH_BEGIN  := Search session started, arg is the number of interfaces searched and data the transaction
+ *    TRACE_SEARCH_END    := Search session ended, arg is the session id and data the transaction
+ *
+ *  Event codes are part of the dump format, new events are added at the end and the decoder updated to match.
+ */
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <Arduino.h>
+#include <CommonUtil.h>
+#include "MetricsWriter.h"
+
+/** Leelanau Software Company namespace
+*
+*/
+namespace lsc {
+
+#ifndef SSDP_TRACE
+#define SSDP_TRACE           1
+#endif
+
+#if SSDP_TRACE
+#define SSDP_TRACE_EVENT(e,ifc,arg,data)   do {if( TraceRing::enabled() ) TraceRing::record((e),(ifc),(arg),(data));} while(0)
+#else
+#define SSDP_TRACE_EVENT(e,ifc,arg,data)   do {} while(0)
+#endif
+
+#define TRACE_MAX_EVENTS     4096               // Upper bound on the ring size passed to begin()
+#define TRACE_VERSION        1                  // Dump format version
+
+enum TraceEventType : uint8_t {
+  TRACE_NONE = 0,
+  TRACE_RECEIVED,
+  TRACE_FILTERED,
+  TRACE_TRUNCATED,
+  TRACE_LSC_SEARCH,
+  TRACE_OTHER_SEARCH,
+  TRACE_RESPONSE,
+  TRACE_OTHER,
+  TRACE_MATCHED,
+  TRACE_NO_MATCH,
+  TRACE_QUEUED,
+  TRACE_SENT,
+  TRACE_SEND_FAILED,
+  TRACE_PACED,
+  TRACE_REPLIED,
+  TRACE_SEARCH_BEGIN,
+  TRACE_SEARCH_END
+};
+
+/**
+ *  Match kinds of TRACE_MATCHED, with TRACE_MATCH_ALL added when ST.LEELANAUSOFTWARE.COM is ssdp:all
+ */
+#define TRACE_MATCH_ROOT     1
+#define TRACE_MATCH_UUID     2
+#define TRACE_MATCH_TYPE     3
+#define TRACE_MATCH_ALL      0x10
+
+/** TraceEvent
+ *  One recorded event, 12 bytes
+ */
+typedef struct {
+  uint32_t       time;                          // micros() when recorded
+  uint8_t        event;                         // TraceEventType
+  uint8_t        ifc;                           // Interface index, 0xff if none
+  uint16_t       arg;
+  uint32_t       data;
+} TraceEvent;
+
+/** TraceRing class definition
+ *  Class members are as follows:
+ *    begin(events)          := Allocate a ring of events entries (at most TRACE_MAX_EVENTS) and start recording. The
+ *                              ring is allocated once, later calls only clear it. Returns false if the ring could not
+ *                              be allocated
+ *    enable(flag)           := Pause or resume recording, the ring is kept
+ *    enabled()              := True if recording
+ *    record(e,ifc,arg,data) := Record an event, nothing if not recording
+ *    capacity()             := Ring size in events, 0 before begin()
+ *    count()                := Events held, at most capacity()
+ *    recorded()             := Events recorded since begin() or clear(), recorded() - count() were overwritten
+ *    event(i)               := Event i of the ring, oldest first, or NULL if i is out of range
+ *    clear()                := Discard all events
+ *    format(w)              := Write the trace as text, a header line followed by a line per event, oldest first
+ *    dump(out)              := Write the trace to out, for example Serial
+ *    send(svr)              := Send the trace as an HTTP text/plain response
+ */
+class TraceRing {
+  public:
+    static boolean               begin(int events);
+    static void                  enable(boolean flag=true);
+    static int                   capacity();
+    static int                   count();
+    static uint32_t              recorded();
+    static const TraceEvent*     event(int i);
+    static void                  clear();
+    static void                  format(MetricsWriter& w);
+    static void                  dump(Print& out);
+    static void                  send(WebContext* svr);
+
+#if SSDP_TRACE
+    static inline boolean enabled() {return _enabled;}
+    static inline void record(uint8_t e, uint8_t ifc, uint16_t arg, uint32_t data) {
+      if( !_enabled ) return;
+      TraceEvent& t = _ring[_next];
+      t.time  = micros();
+      t.event = e;
+      t.ifc   = ifc;
+      t.arg   = arg;
+      t.data  = data;
+      if( ++_next == _capacity ) _next = 0;
+      _recorded++;
+    }
+
+  private:
+    static TraceEvent*           _ring;
+    static int                   _capacity;
+    static int                   _next;              // Index of the next event recorded
+    static uint32_t              _recorded;
+    static boolean               _enabled;           // Never true without a ring
+#else
+    static inline boolean enabled() {return false;}
+    static inline void record(uint8_t e, uint8_t ifc, uint16_t arg, uint32_t data) {}
+#endif
+};
+
+} // End of namespace lsc
+
+#endif
@@ -21,6 +21,7 @@
  */
 
 #include "UPnPBuffer.h"
+#include "PerfTrace.h"
 
 namespace lsc {
 
@@ -35,7 +36,6 @@ UPnPBuffer::UPnPBuffer(const char* buff) {
   const char* cbuff = buff;
   while( *cbuff == ' ' ) {cbuff++;}
   _buffer = cbuff;
-  _maxLen = maxLen()+1;
 }
 
 /** Copies the header value corresponding to the inpput string header into
@@ -43,44 +43,45 @@ UPnPBuffer::UPnPBuffer(const char* buff) {
  *  character. Leading blanks are removed prior to coping.
  */
 boolean UPnPBuffer::headerValue(const char* header, char buffer[], size_t len) {
-  boolean result = false;
-  int headerLen = strlen(header);
-  int buffLen = maxLineLength();
-  char lineBuff[buffLen];
-  const char* lineStart = _buffer;
+  return findHeader(header,strlen(header),false,buffer,len);
+}
+
+boolean UPnPBuffer::headerValue_P(PGM_P header, char buffer[], size_t len) {
+  return findHeader(header,strlen_P(header),true,buffer,len);
+}
 
-/** Search _buffer one line at a time, taking care to remove starting blanks.
- *  Note that on initialization, _buffer has no starting blanks and each header should match 
- *  from start of line, with no starting blanks.
+/** Search _buffer one line at a time in place, with no copy of each line, so stack use does not depend on the packet.
+ *  Lines end with "\r\n" and have starting blanks removed, and the search ends at the first empty line. A line 
+ *  matches if it begins with header followed by blank or ':', and its value is the rest of the line after ':' and any
+ *  blanks. The last matching line wins. A value longer than len-1 characters is truncated, and truncated() is set.
+ *  With len 0 there is no room for the terminating '\0', so nothing is copied and false is returned.
  */
-  while( hasNextLine( lineStart ) ) {
-     lineStart = getNextLine(lineStart,lineBuff,buffLen);
-     char* headerStart = strstr(lineBuff,header);
-     
-/**  If this line begins with the header string and blank or ':', copy header value into buffer
- *   
- */  
-     if( headerStart != NULL ) {
-       char* headerEnd = headerStart + headerLen;
-       if( (headerStart == lineBuff) && ((*headerEnd == ' ')||(*headerEnd == ':')) ) {
-          char* headerValue = strstr(headerStart,":");
-          if( headerValue != NULL ) {
-            result = true;
-            headerValue++;
-            while(*headerValue == ' ') {++headerValue;}
-            buffer[0] = '\0';
-            if( strlen(headerValue) > 0 ) {
-               headerEnd = headerValue + strlen(headerValue);
-               while( *headerEnd == ' ') {headerEnd--;}
-               int hlen = headerEnd - headerValue + 1;     // +1 to include null termination on copy
-               if( hlen > len ) hlen = len;
-               strlcpy(buffer,headerValue,hlen);
-            }
-          }
-       }
-     }
+boolean UPnPBuffer::findHeader(const char* header, size_t headerLen, boolean progmem, char buffer[], size_t len) {
+  PERF_SCOPE("parse","headerValue");
+  boolean     result    = false;
+  const char* lineStart = _buffer;
+  _truncated = false;
+  if( len == 0 ) return false;
+  while( hasNextLine(lineStart) ) {
+    const char* lineEnd = strstr_P(lineStart,END_OF_LINE);
+    int match = ((progmem)?(strncmp_P(lineStart,header,headerLen)):(strncmp(lineStart,header,headerLen)));
+    const char* headerEnd = lineStart + headerLen;
+    if( (match == 0) && (headerEnd < lineEnd) && ((*headerEnd == ' ')||(*headerEnd == ':')) ) {
+      const char* value = (const char*)memchr(headerEnd,':',lineEnd - headerEnd);
+      if( value != NULL ) {
+        result = true;
+        value++;
+        while( (value < lineEnd) && (*value == ' ') ) {++value;}
+        size_t vlen = lineEnd - value;
+        _truncated  = (vlen >= len);
+        if( _truncated ) vlen = len - 1;
+        memcpy(buffer,value,vlen);
+        buffer[vlen] = '\0';
+      }
+    }
+    lineStart = lineEnd + 2;
+    while( *lineStart == ' ' ) {lineStart++;}
   }
-  
   return result;   
 }
 
@@ -147,7 +148,13 @@ boolean  UPnPBuffer::hasNextLine(const char* lineStart) {
     return result;
 }
 
-int   UPnPBuffer::maxLineLength() {return _maxLen;}
+/**
+ *  The scan for the longest line is only made when it is asked for
+ */
+int   UPnPBuffer::maxLineLength() {
+  if( _maxLen < 0 ) _maxLen = maxLen()+1;
+  return _maxLen;
+}
 
 boolean UPnPBuffer::displayName(char buffer[], size_t len) {
   char headerBuffer[200];
@@ -170,14 +177,6 @@ boolean UPnPBuffer::displayName(char buffer[], size_t len) {
   return result;
 }
 
-boolean UPnPBuffer::headerValue_P(PGM_P header, char buffer[], size_t len) {
-  size_t dim = strlen_P(header)+1;
-  char cheader[dim];
-  strncpy_P(cheader,header,dim-1);
-  cheader[dim-1] = '\0';
-  return headerValue(cheader,buffer,len);
-}
-
 boolean UPnPBuffer::isSearchRequest()  {return (strncmp_P(_buffer,M_SEARCH_HEADER,8) == 0);}
 boolean UPnPBuffer::isSearchResponse() {return (strncmp_P(_buffer,RESPONSE_HEADER,8) == 0);}
 
@@ -38,6 +38,7 @@ class UPnPBuffer {
 //  Return false if header does not exist, otherwise return true with header value filled in buffer
     boolean headerValue(const char* header, char buffer[], size_t len); 
     boolean headerValue_P(PGM_P header, char buffer[], size_t len); 
+    boolean truncated()                             {return _truncated;}  // True if the last header value found did not fit in its buffer
     
     boolean displayName(char buffer[], size_t len); // Return true if DESC header is present and fill buffer with the :name: value                       
     
@@ -48,14 +49,17 @@ class UPnPBuffer {
  *  
  */
     int         maxLineLength();
+    const char* firstLine()                         {return _buffer;}
     const char* getNextLine(const char* lineStart, char buffer[], size_t bufferLen);
     boolean     hasNextLine(const char* startLine);
                                              
   private:
     const char*   _buffer;
-    int           _maxLen = 0;
+    int           _maxLen    = -1;                  // Longest line plus one, -1 until asked for
+    boolean       _truncated = false;
 
     int           maxLen();
+    boolean       findHeader(const char* header, size_t headerLen, boolean progmem, char buffer[], size_t len);
 
 };
 
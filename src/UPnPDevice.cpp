@@ -21,6 +21,7 @@
  */
 
 #include "UPnPDevice.h"
+#include "PerfTrace.h"
 
 /** Leelanau Software Company namespace 
 *  
@@ -33,6 +34,8 @@ namespace lsc {
 INITIALIZE_DEVICE_TYPES(UPnPDevice,LeelanauSoftware-com,Basic,1.0.0);
 INITIALIZE_DEVICE_TYPES(RootDevice,LeelanauSoftware-com,RootDevice,1.0.0);
 
+uint32_t UPnPDevice::_truncations = 0;
+
 void getRandomBytes(unsigned char *a, int len) {for(int i=0; i<len; i++ ) a[i] = (unsigned char) rand()%255;}
 
 void generateUUID(char s[UUID_SIZE])
@@ -99,18 +102,23 @@ void UPnPDevice::display(WebContext* svr) {
   else {
      char buffer[DISPLAY_SIZE];
      int size = sizeof(buffer);
-     int pos = formatHeader(buffer,size,getDisplayName());
-     pos = formatContent(buffer,size,pos);
-     formatTail(buffer,size,pos);
+     if( isTruncated(size,formatPage(buffer,size)) ) _truncations++;
      svr->send(200,"text/html",buffer);
+     RouteMetrics::responseBytes(strlen(buffer));
   }
 }
 
+int UPnPDevice::formatPage(char buffer[], int size) {
+  int pos = formatHeader(buffer,size,getDisplayName());
+  pos = formatContent(buffer,size,pos);
+  return formatTail(buffer,size,pos);
+}
+
 void UPnPDevice::setup(WebContext* svr) {
   char pathBuffer[100];
   pathBuffer[0] = '\0';
   getPath(pathBuffer,100);
-  svr->on(pathBuffer,[this](WebContext* svr){this->display(svr);});
+  RouteMetrics::on(svr,pathBuffer,[this](WebContext* svr){PERF_SCOPE("device",this->getTarget()); this->display(svr);});
   for( int i=0; i<numServices(); i++ ) {service(i)->setup(svr);}
 }
 
@@ -236,25 +244,93 @@ int RootDevice::formatRootContent(char buffer[], int size, int pos ) {
 }
 
 void RootDevice::displayRoot(WebContext* svr) {  
-  Serial.printf("RootDevice::rootDisplay called");
   if( _rootDisplayHandler != NULL ) _rootDisplayHandler(this,svr);
   else {
     char buffer[DISPLAY_SIZE];
     int size = sizeof(buffer);
-    int pos = formatHeader(buffer,size,getDisplayName());        //Add HTML Header Title with Display Name
-    pos = formatRootContent(buffer,size,pos);                    // Add root display content
-    formatTail(buffer,size,pos);                                 // Add the HTML tail
+    if( isTruncated(size,formatRootPage(buffer,size)) ) _truncations++;
     svr->send(200,"text/html",buffer);
+    RouteMetrics::responseBytes(strlen(buffer));
   }
 }
 
+int RootDevice::formatRootPage(char buffer[], int size) {
+  int pos = formatHeader(buffer,size,getDisplayName());          // Add HTML Header Title with Display Name
+  pos = formatRootContent(buffer,size,pos);                      // Add root display content
+  return formatTail(buffer,size,pos);                            // Add the HTML tail
+}
+
+boolean RootDevice::addMetrics(MetricsSource f) {
+  if( _numMetricsSources >= MAX_METRICS_SOURCES ) return false;
+  _metricsSources[_numMetricsSources++] = f;
+  return true;
+}
+
+/**
+ *  The page is sent chunked, so no buffer larger than the MetricsWriter buffer is needed
+ */
+void RootDevice::metrics(WebContext* svr) {
+  svr->setContentLength(CONTENT_LENGTH_UNKNOWN);
+  svr->send(200,METRICS_CONTENT_TYPE,"");
+  {
+    MetricsWriter w([svr](const char* chunk){svr->sendContent(chunk);});
+    formatAllMetrics(w);
+    RouteMetrics::responseBytes(w.bytes());
+  }
+  svr->sendContent("");
+}
+
+void RootDevice::formatAllMetrics(MetricsWriter& w) {
+  w.gauge("lsc_uptime_seconds","Seconds since start up",millis()/1000);
+  w.gauge("lsc_heap_free_bytes","Free heap",ESP.getFreeHeap());
+#ifdef ESP8266
+  w.gauge("lsc_heap_max_block_bytes","Largest free heap block",ESP.getMaxFreeBlockSize());
+  w.gauge("lsc_heap_fragmentation_percent","Heap fragmentation",ESP.getHeapFragmentation());
+#elif defined(ESP32)
+  w.gauge("lsc_heap_max_block_bytes","Largest free heap block",ESP.getMaxAllocHeap());
+  w.gauge("lsc_heap_min_free_bytes","Lowest free heap since start up",ESP.getMinFreeHeap());
+#endif
+  w.gauge("lsc_stack_free_min_bytes","Least loop stack free since start up",StackProfiler::freeMin());
+  w.gauge("lsc_devices","Embedded devices of the RootDevice",numDevices());
+  w.counter("lsc_display_truncations_total","Device pages sent truncated at DISPLAY_SIZE",displayTruncations());
+  RouteMetrics::formatMetrics(w);
+  LoopProfiler::formatMetrics(w);
+  StackProfiler::formatMetrics(w);
+  HeapAccounting::formatMetrics(w);
+  Footprint::formatMetrics(w,"lsc_footprint_bytes",[this](FootprintVisitor v){this->footprint(v);});
+  for( int i=0; i<_numMetricsSources; i++ ) _metricsSources[i](w);
+  char label[TARGET_SIZE+10];
+  w.grouped(_numDevices+1,[this,&w,&label](int i) {
+    UPnPDevice* d = ((i == 0)?((UPnPDevice*)this):(device(i-1)));
+    snprintf(label,sizeof(label),"device=\"%s\"",d->getTarget());
+    w.scope(label);
+    d->formatMetrics(w);
+  });
+  w.scope(NULL);
+  w.flush();
+}
+
 void RootDevice::setup(WebContext* svr) {
+  HeapScope heap = HeapAccounting::enter(HEAP_SETUP);
+  uint32_t  free = ESP.getFreeHeap();
   UPnPDevice::setup(svr);
   _context = svr;
   char pathBuffer[50];
-  svr->on("/styles.css",[this](WebContext* s){this->styles(s);});
-  svr->on("/",[this](WebContext* s){this->displayRoot(s);});
+  RouteMetrics::on(svr,"/styles.css",[this](WebContext* s){this->styles(s);});
+  RouteMetrics::on(svr,"/",[this](WebContext* s){this->displayRoot(s);});
+  if( _metricsEnabled ) RouteMetrics::on(svr,"/metrics",[this](WebContext* s){this->metrics(s);});
   for( int i=0; i<_numDevices; i++ )   {device(i)->setup(svr);}
+  countSetupHeap(free);
+  HeapAccounting::leave(heap);
+}
+
+/**
+ *  Heap taken by setup, mostly request handlers and their captures, is the drop in free heap. Other tasks may allocate
+ *  or free at the same time on ESP32, so it is an estimate.
+ */
+void RootDevice::countSetupHeap(uint32_t before) {
+  uint32_t after = ESP.getFreeHeap();
+  if( before > after ) _setupHeap += before - after;
 }
 
 /** Add a UPnPDevice to this root device
@@ -273,7 +349,11 @@ void RootDevice::addDevice(UPnPDevice* dvc) {
  *     Late binding setup. Setup() has already been called on this RootDevice so any device added
  *     must also be setup();
  */
-       if(getContext() != NULL) dvc->setup(getContext());
+       if(getContext() != NULL) {
+         uint32_t free = ESP.getFreeHeap();
+         dvc->setup(getContext());
+         countSetupHeap(free);
+       }
      }
   }
 }
@@ -304,7 +384,19 @@ UPnPDevice* RootDevice::getDevice(const char* u) {
   return result;
 }
 
-void RootDevice::doDevice() {for( int i=0; i<numDevices(); i++ ) {device(i)->doDevice();}}
+/**
+ *  Each embedded device is timed by target when the loop profiler is enabled, and each call marks a loop pass
+ */
+void RootDevice::doDevice() {
+  LoopProfiler::loop();
+  for( int i=0; i<numDevices(); i++ ) {
+    PERF_SCOPE("device",device(i)->getTarget());
+    int      probe = LoopProfiler::begin(device(i)->getTarget());
+    uint32_t start = micros();
+    device(i)->doDevice();
+    LoopProfiler::end(probe,start);
+  }
+}
 
 void RootDevice::rootLocation(char buffer[], int buffSize, IPAddress ifc) {
   snprintf(buffer,buffSize,"http://%s:%d/",ifc.toString().c_str(),serverPort());
@@ -314,4 +406,40 @@ void RootDevice::location(char buffer[], int buffSize, IPAddress ifc) {
   snprintf(buffer,buffSize,"http://%s:%d/%s",ifc.toString().c_str(),serverPort(),getTarget());
 }
 
+/**
+ *  Objects are reported by type, with the count of each type in the hierarchy and the size of its most derived class.
+ *  Stack parts are the buffers each page operation holds on the stack.
+ */
+void RootDevice::footprint(FootprintVisitor v) {
+  typedef struct {const char* type; uint32_t count; uint32_t size;} TypeCount;
+  TypeCount types[FOOTPRINT_MAX_TYPES];
+  int numTypes = 0;
+  auto count = [&types,&numTypes](const char* type, uint32_t size) {
+    for( int i=0; i<numTypes; i++ ) {if( strcmp(types[i].type,type) == 0 ) {types[i].count++; return;}}
+    if( numTypes < FOOTPRINT_MAX_TYPES ) types[numTypes++] = {type,1,size};
+  };
+  for( int i=-1; i<_numDevices; i++ ) {
+    UPnPDevice* d = ((i<0)?(this):(device(i)));
+    count(d->getType(),d->objectSize());
+    for( int j=0; j<d->numServices(); j++ ) count(d->service(j)->getType(),d->service(j)->objectSize());
+  }
+  for( int i=0; i<numTypes; i++ ) v(FOOTPRINT_OBJECT,types[i].type,types[i].count,types[i].size);
+#if HTTP_METRICS
+  v(FOOTPRINT_STATIC,"RouteMetrics routes",HTTP_MAX_ROUTES,sizeof(RouteStats));
+#endif
+#if LOOP_PROFILER
+  v(FOOTPRINT_STATIC,"LoopProfiler components",LOOP_MAX_COMPONENTS,sizeof(LoopComponent));
+#endif
+#if STACK_PROFILE
+  v(FOOTPRINT_STATIC,"StackProfiler paths",STACK_MAX_PATHS,sizeof(StackPath));
+#endif
+#if HEAP_ACCOUNTING
+  v(FOOTPRINT_STATIC,"HeapAccounting scopes",HEAP_SCOPES,sizeof(HeapStats));
+#endif
+  v(FOOTPRINT_STACK,"display",1,DISPLAY_SIZE);
+  v(FOOTPRINT_STACK,"displayRoot",1,DISPLAY_SIZE);
+  v(FOOTPRINT_STACK,"metrics",1,sizeof(MetricsWriter) + METRICS_MAX_FAMILIES*sizeof(uint32_t) + TARGET_SIZE+10);
+  v(FOOTPRINT_HEAP,"setup",1,_setupHeap);
+}
+
 } // End of namespace lsc
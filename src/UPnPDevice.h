@@ -24,6 +24,12 @@
 #define UPNP_DEVICE_H
 #include <CommonProgmem.h>
 #include "UPnPService.h"
+#include "MetricsWriter.h"
+#include "RouteMetrics.h"
+#include "LoopProfiler.h"
+#include "StackProfiler.h"
+#include "HeapAccounting.h"
+#include "Footprint.h"
 
 /** Leelanau Software Company namespace 
 *  
@@ -34,10 +40,13 @@ namespace lsc {
 #define MAX_DEVICES  8
 #define UUID_SIZE    37
 #define DISPLAY_SIZE 1280
+#define FOOTPRINT_MAX_TYPES 16                 // Distinct device and service types in a footprint report
+#define MAX_METRICS_SOURCES 4
 
 class UPnPDevice;
 
 typedef std::function<void(UPnPDevice*,WebContext*)> DisplayHandler;
+typedef std::function<void(MetricsWriter&)>           MetricsSource;
 
  /** UPnPDevice class definition
   *  A UPnPDevice may have up to MAX_SERVICES UPnPServices and can display itself.
@@ -45,12 +54,17 @@ typedef std::function<void(UPnPDevice*,WebContext*)> DisplayHandler;
   *    numServices()                := Returns the number of UPnPServices
   *    services()                   := Returns an array of MAX_SERVICES UPnPService pointers
   *    display()                    := Responds with an HTML interface for the Object, set on the Web Server as response to the device's target
+  *    formatPage(buffer,size)      := Formats the HTML page sent by display(), header, formatContent() and tail, and returns the write position.
+  *                                    A position of size-1 or more means the page did not fit in buffer
+  *    displayTruncations()         := Number of pages sent by display() or displayRoot() that did not fit in DISPLAY_SIZE
   *    setup()                      := Device specific setup, like setting Web Server request handlers for services. Default is to set display()
   *                                    as a request handler for the target path from root e.g. /rootTarget/deviceTarget. Note that all targets 
   *                                    must be set prior to the call to setup().
   *    setDisplayHandler()          := Sets an alternative display() function, registered with the WebServer at /rootTarget/deviceTarget, defaults 
   *                                    to display()
   *    doDevice()                   := Called in the Arduino loop(); an opportunity to do a unit of work
+  *    formatMetrics(w)             := Write device specific metrics to the RootDevice /metrics page, default is none. Samples
+  *                                    are labeled device="<target>" and each family is written once for all devices
   *    addService(UPnPService*)     := Adds the next service
   *    addServices(UPnPService*...) := Adds up to MAX_SERVICES UPnPServices
   *    service(int n)               := Returns a pointer to the n'th UPnPService when 0 <= n < numServices() and NULL otherwise
@@ -65,7 +79,7 @@ class UPnPDevice : public UPnPObject {
   
      const char*    uuid()                                {return _uuid;}
      int            numServices()                         {return _numServices;}
-     boolean        isDevice(const char* u)               {return (strcmp(u,uuid()) == 0);} 
+     boolean        isDevice(const char* u)               {return (strcasecmp(u,uuid()) == 0);}     // UUIDs compare without case, binary records carry them in lower case
      UPnPService**  services()                            {return _services;}
      UPnPService*   service(int i)                        {return (((i<_numServices)&&(i>=0))?(_services[i]):(NULL));}
      boolean        setUUID(String uuid);
@@ -82,8 +96,10 @@ class UPnPDevice : public UPnPObject {
      virtual void   display(WebContext* svr);                                       // HTTP request handler for UI, ultimately calls formatContent()
      virtual int    formatContent(char buffer[], int size, int pos) {return pos;}   // Format content as displayed on this device, return updated write position
      virtual int    formatRootContent(char buffer[], int size, int pos);            // Format content as displayed on the RootDevice, return updated write position
+     int            formatPage(char buffer[], int size);                            // Format the page sent by display(), return updated write position
      virtual void   setup(WebContext* svr);
      virtual void   location(char buffer[], int buffSize, IPAddress ifc);
+     virtual void   formatMetrics(MetricsWriter& w) {}                              // Write device metrics, see MetricsWriter.h
 
 /**
  *   Macros to define the following Runtime and UPnP Type Info:
@@ -95,6 +111,7 @@ class UPnPDevice : public UPnPObject {
  *     public:  static const char*      upnpType()                  
  *     public:  virtual const char*     getType()                   
  *     public:  virtual boolean         isType(const char* t)       
+ *     public:  virtual size_t          objectSize()
  */
      DEFINE_RTTI;
      DERIVED_TYPE_CHECK(UPnPObject);          
@@ -107,9 +124,17 @@ class UPnPDevice : public UPnPObject {
  *   Send UPnP info to Serial
  */
      static void             printInfo(UPnPDevice* d);
+
+/**
+ *   Pages that filled the display buffer, and so were sent truncated
+ */
+     static uint32_t         displayTruncations()     {return _truncations;}
+     static boolean          isTruncated(int size, int pos) {return (pos >= size-1);}
      
      protected:
      
+     static uint32_t          _truncations;
+     
      UPnPService*             _services[MAX_SERVICES];
      int                      _numServices = 0;
      char                     _uuid[UUID_SIZE];
@@ -131,12 +156,22 @@ class UPnPDevice : public UPnPObject {
  *    devices()                    := Returns an array of MAX_DEVICES UPnPDevice pointers
  *    displayRoot()                := Displays a single HTML Button with the displayName of this RootDevice. Selecting the button
  *                                    will trigger the display() function to be called
+ *    formatRootPage(buffer,size)  := Formats the HTML page sent by displayRoot() and returns the write position
  *    setUp()                      := Device specific setup, like setting Web Server request handlers. Default is to set display()
  *                                    as a request handler for target() and to set the CSS styles from styles()
  *    addDevice(UPnPDevice*)       := Adds the next service
  *    addDevices(UPnPDevice*...)   := Adds up to MAX_DEVICES UPnPDevices
  *    service(int)                 := Returns a pointer to the n'th UPnPDevice
+ *    doDevice()                   := Calls doDevice() on each embedded device, timed by target when the LoopProfiler is enabled
  *    styles()                     := Responds with the CSS styles for this RootDevice.
+ *    enableMetrics()              := Register metrics() at /metrics in setup(), must be called prior to setup()
+ *    addMetrics(MetricsSource)    := Add a writer of metrics from outside the device hierarchy, for example SSDP::formatMetrics(),
+ *                                    up to MAX_METRICS_SOURCES. Returns false if there is no room
+ *    metrics()                    := Responds with memory, display, route, loop, footprint, source and device metrics in the Prometheus text format, 
+ *                                    streamed in chunks of METRICS_BUFFER_SIZE
+ *    formatAllMetrics(w)          := Write the metrics page to a MetricsWriter, for example one writing to Serial
+ *    footprint(v)                 := Report object sizes by type, library tables, page stack buffers and heap taken by
+ *                                    setup to a FootprintVisitor (see Footprint.h)
  */
 class RootDevice : public UPnPDevice {
 
@@ -160,13 +195,20 @@ class RootDevice : public UPnPDevice {
      void               setup(WebContext* svr);
      int                formatContent(char buffer[], int size, int pos);
      int                formatRootContent(char buffer[], int size, int pos);
+     int                formatRootPage(char buffer[], int size);
      void               doDevice();
      void               location(char buffer[], int buffSize, IPAddress addr);
 
      void               setRootDisplayHandler(DisplayHandler f)            {_rootDisplayHandler = f;}
-     virtual void       styles(WebContext* svr)                            {svr->send_P(200,TEXT_CSS,styles_css);}
+     virtual void       styles(WebContext* svr)                            {svr->send_P(200,TEXT_CSS,styles_css); RouteMetrics::responseBytes(strlen_P(styles_css));}
      virtual void       displayRoot(WebContext* svr);
 
+     void               enableMetrics()                                    {_metricsEnabled = true;}
+     boolean            addMetrics(MetricsSource f);
+     virtual void       metrics(WebContext* svr);
+     void               formatAllMetrics(MetricsWriter& w);
+     void               footprint(FootprintVisitor v);
+
      void               addDevice(UPnPDevice* dvc);
 
 /**
@@ -188,6 +230,7 @@ class RootDevice : public UPnPDevice {
  *     public:  static const char*      upnpType()                  
  *     public:  virtual const char*     getType()                   
  *     public:  virtual boolean         isType(const char* t)       
+ *     public:  virtual size_t          objectSize()
  */
      DEFINE_RTTI;
      DERIVED_TYPE_CHECK(UPnPDevice);
@@ -202,6 +245,12 @@ class RootDevice : public UPnPDevice {
      int                     _numDevices = 0;
      WebContext*             _context = NULL;
      DisplayHandler          _rootDisplayHandler = NULL;
+     boolean                 _metricsEnabled = false;
+     MetricsSource           _metricsSources[MAX_METRICS_SOURCES];
+     int                     _numMetricsSources = 0;
+     uint32_t                _setupHeap = 0;
+
+     void                    countSetupHeap(uint32_t before);
      
 /**
  *   Copy construction and assignment are not allowed
@@ -27,6 +27,19 @@
 #include "UPnPBuffer.h"
 #include "UPnPService.h"
 #include "UPnPDevice.h"
+#include "Federation.h"
+#include "SSDPRelay.h"
+#include "SSDPRecord.h"
+#include "Histogram.h"
+#include "SearchTracker.h"
+#include "MetricsWriter.h"
+#include "RouteMetrics.h"
+#include "LoopProfiler.h"
+#include "StackProfiler.h"
+#include "HeapAccounting.h"
+#include "Footprint.h"
+#include "TraceRing.h"
+#include "SSDPLog.h"
 
 using namespace lsc;
 
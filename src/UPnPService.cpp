@@ -21,6 +21,8 @@
  */
 
 #include "UPnPService.h"
+#include "RouteMetrics.h"
+#include "PerfTrace.h"
 /** Leelanau Software Company namespace 
 *  
 */
@@ -153,7 +155,7 @@ void UPnPService::location(char buffer[], int buffSize, IPAddress ifc) {
 void  UPnPService::setup(WebContext* svr) {
   char pathBuffer[100];
   getPath(pathBuffer,100);
-  svr->on(pathBuffer,[this](WebContext* svr){this->handleRequest(svr);});
+  RouteMetrics::on(svr,pathBuffer,[this](WebContext* svr){PERF_SCOPE("service",this->getTarget()); this->handleRequest(svr);});
 }
 
 } // End of namespace lsc
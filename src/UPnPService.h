@@ -40,7 +40,8 @@ typedef std::function<void(void)> CallbackFunction;
 /**
  *   Macro to define Runtime Type Identification and UPnP Device Type
  *   Note that the static upnpType() is tied to the class and virtual getType() is tied to the instance of an Object
- *   the same way that classType() is tied to the class and isClassType() tied to the instance
+ *   the same way that classType() is tied to the class and isClassType() tied to the instance. objectSize() is the size 
+ *   of the most derived class that uses the macro, for memory footprint reports
  */
 #define DEFINE_RTTI     private: static const ClassType  _classType;                                                           \
                         public:  static const ClassType* classType()                 {return &_classType;}                     \
@@ -48,7 +49,8 @@ typedef std::function<void(void)> CallbackFunction;
                         private: static const char*      _upnpType;                                                            \
                         public:  static const char*      upnpType()                  {return _upnpType;}                       \
                         public:  virtual const char*     getType()                   {return upnpType();}                      \
-                        public:  virtual boolean         isType(const char* t)       {return(strcmp(t,getType()) == 0);}  
+                        public:  virtual boolean         isType(const char* t)       {return(strcmp(t,getType()) == 0);}       \
+                        public:  virtual size_t          objectSize()                {return sizeof(*this);}
 
 /**
  *   Define type check for classes derived from a single Base Class
@@ -201,6 +203,7 @@ class UPnPService : public UPnPObject {
  *     public:  static const char*      upnpType()                  
  *     public:  virtual const char*     getType()                   
  *     public:  virtual boolean         isType(const char* t)       
+ *     public:  virtual size_t          objectSize()
  */
      DEFINE_RTTI;
      DERIVED_TYPE_CHECK(UPnPObject);
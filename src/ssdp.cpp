@@ -150,60 +150,66 @@
  */
  
 #include "ssdp.h"
+#include "PerfTrace.h"
+
+#ifdef ESP8266
+extern "C" {
+#include <user_interface.h>
+}
+#include <lwip/igmp.h>
+#elif defined(ESP32)
+#include <lwip/igmp.h>
+#include <lwip/tcpip.h>
+#endif
 
 namespace lsc {
 
 const IPAddress SSDP_MULTICAST(239,255,255,250);
 const long DELAY = 500;
 
-// buffer for sending and receiving UDP data
-#define TXN_BUFFER_SIZE    1536
-#define ST_HEADER_SIZE     100
+// buffer for receiving UDP data, any packet the library sends fits in one unfragmented datagram
+#define TXN_BUFFER_SIZE    UDP_DATAGRAM_SIZE
+#define SSDP_PEEK_SIZE     16                  // Bytes read to classify a packet by its start line
 #define ST_LSC_HEADER_SIZE 20
-#define SSDP_BUFFER_SIZE   1000
+#define SSDP_BUFFER_SIZE   1000                // Search requests, and responses read by searchRequest()
 
-/** Response Templates
- *  
+static_assert(SSDP_BUFFER_SIZE <= TXN_BUFFER_SIZE,     "Search requests must fit in the receive buffer");
+static_assert(SSDP_RESPONSE_SIZE <= SSDP_BUFFER_SIZE,  "Text responses must fit in the search buffer");
+static_assert(SSDP_BIN_PACKET_SIZE <= SSDP_BUFFER_SIZE,"Binary responses must fit in the search buffer");
+
+/**
+ *  Field values of a single response, the field slots of a template (see ResponseTemplate.h) are filled from here
  */
-const char  SERVICE_RESPONSE[]    PROGMEM = "HTTP/1.1 200 OK \r\n"
-                                         "CACHE-CONTROL: max-age = 1800 \r\n"
-                                         "LOCATION: %s\r\n"                                                          // Service Location
-                                         "ST: %s\r\n"                                                                // Search Target
-                                         "USN: uuid:%s::%s\r\n"                                                      // Parent Device uuid and Service type
-                                         "DESC.LEELANAUSOFTWARE.COM: :name:%s:puuid:%s:\r\n\r\n\r\n";              // name and parent Device uuid
-
-const char  DEVICE_RESPONSE[]     PROGMEM = "HTTP/1.1 200 OK \r\n"
-                                         "CACHE-CONTROL: max-age = 1800 \r\n"
-                                         "LOCATION: %s\r\n"                                                          // Device Location
-                                         "ST: %s\r\n"                                                                // Search Target
-                                         "USN: uuid:%s::%s\r\n"                                                      // uuid and device type
-                                         "DESC.LEELANAUSOFTWARE.COM: :name:%s:services:%d:puuid:%s:\r\n\r\n\r\n";  // name, number of services, and parent uuid   
-
-const char  ROOT_RESPONSE[]       PROGMEM = "HTTP/1.1 200 OK \r\n"
-                                         "CACHE-CONTROL: max-age = 1800 \r\n"
-                                         "LOCATION: %s\r\n"                                                           // Root Location
-                                         "ST: %s\r\n"                                                                 // Search Target
-                                         "USN: uuid:%s::%s\r\n"                                                       // uuid and device type
-                                         "DESC.LEELANAUSOFTWARE.COM: :name:%s:devices:%d:services:%d:\r\n\r\n\r\n"; // Number of Devices and Number of Services 
+typedef struct {
+  const char*  location;
+  const char*  st;
+  const char*  uuid;
+  const char*  type;
+  const char*  name;
+  int          devices;
+  int          services;
+  const char*  puuid;
+  const char*  txn;
+} ResponseFields;
 
 const char SSDP_RootSearch[]      PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
                                         "HOST: 239.255.255.250:1900\r\n"
                                         "MAN: ssdp:discover\r\n"
                                         "ST: upnp:rootdevice\r\n"
-                                        "ST.LEELANAUSOFTWARE.COM: \r\n"
-                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+                                        "ST.LEELANAUSOFTWARE.COM: %s\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n%s\r\n";
 const char SSDP_RootAllSearch[]   PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
                                         "HOST: 239.255.255.250:1900\r\n"
                                         "MAN: ssdp:discover\r\n"
                                         "ST: upnp:rootdevice\r\n"
-                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all\r\n"
-                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all%s\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n%s\r\n";
 const char SSDP_Search[]          PROGMEM = "M-SEARCH * HTTP/1.1\r\n"
                                         "HOST: 239.255.255.250:1900\r\n"
                                         "MAN: ssdp:discover\r\n"
                                         "ST: %s\r\n"
-                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all\r\n"
-                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n\r\n";
+                                        "ST.LEELANAUSOFTWARE.COM: ssdp:all%s\r\n"
+                                        "USER-AGENT: ESP8266 UPnP/1.1 LSC-SSDP/1.0\r\n%s\r\n";
 
 /** Header field constants
  *  
@@ -215,6 +221,17 @@ const char ST_UPNP_ROOTDEVICE[]  PROGMEM = "upnp:rootdevice";
 const char ST_UUID[]             PROGMEM = "uuid:";
 const char ST_TYPE[]             PROGMEM = "urn:";
 const char SSDP_ALL[]            PROGMEM = "ssdp:all";
+const char TXN_LSC_HEADER[]      PROGMEM = "TXN.LEELANAUSOFTWARE.COM";
+const char TXN_LSC_LINE[]        PROGMEM = "TXN.LEELANAUSOFTWARE.COM: %s\r\n";
+const char SEARCH_START[]        PROGMEM = "M-SEARCH";
+const char RESPONSE_START[]      PROGMEM = "HTTP/1.1";
+
+/**
+ *  Prefilter token, in RAM so it can be scanned for with memmem()
+ */
+const char LSC_TOKEN[]                   = "ST.LEELANAUSOFTWARE.COM";
+#define    LSC_TOKEN_LEN         (sizeof(LSC_TOKEN) - 1)
+const char BIN_TOKEN[]           PROGMEM = "bin";
 const char DELIM[]               PROGMEM = "::";
 
 
@@ -223,11 +240,83 @@ const char DELIM[]               PROGMEM = "::";
  *  Other wiFi implementations may need to address other functions.
  */
 
+/**
+ *  A single multicast channel is bound to port 1900 on all interfaces, since a second bind to the same port fails.
+ *  The group is joined on each interface address with joinGroup(), so an interface that comes up after the channel
+ *  is started, such as a soft AP, is joined too. ESP32 lwIP calls from the loop task must hold the TCP/IP core lock.
+ */
 void beginMulticast(WiFiUDP& channel) {
+  channel.begin(UDP_PORT);
+}
+
+void joinGroup(IPAddress ifc) {
+  int8_t err = 0;
+#ifdef ESP8266
+  err = igmp_joingroup(ifc,SSDP_MULTICAST);
+#elif defined(ESP32)
+  ip4_addr_t addr;
+  ip4_addr_t group;
+  addr.addr  = (uint32_t)ifc;
+  group.addr = (uint32_t)SSDP_MULTICAST;
+  LOCK_TCPIP_CORE();
+  err = igmp_joingroup(&addr,&group);
+  UNLOCK_TCPIP_CORE();
+#endif
+  if( err != 0 ) SSDP_LOG_WARNING("SSDP::joinGroup: Could not join multicast group on %s\n",ifc.toString().c_str());
+}
+
+void leaveGroup(IPAddress ifc) {
+#ifdef ESP8266
+  igmp_leavegroup(ifc,SSDP_MULTICAST);
+#elif defined(ESP32)
+  ip4_addr_t addr;
+  ip4_addr_t group;
+  addr.addr  = (uint32_t)ifc;
+  group.addr = (uint32_t)SSDP_MULTICAST;
+  LOCK_TCPIP_CORE();
+  igmp_leavegroup(&addr,&group);
+  UNLOCK_TCPIP_CORE();
+#endif
+}
+
+/**
+ *  Unicast channels are bound to the interface address where the platform allows it, so replies and search requests
+ *  leave from the interface they belong to.
+ */
+void beginUnicast(WiFiUDP& channel, IPAddress ifc) {
 #ifdef ESP32
-  channel.beginMulticast(SSDP_MULTICAST,UDP_PORT);
+  channel.begin(ifc,0);
+#else
+  channel.begin(0);
+#endif
+}
+
+int beginSearchPacket(WiFiUDP& channel, IPAddress ifc) {
+  int ok = 0;
+#ifdef ESP8266
+  ok = channel.beginPacketMulticast(SSDP_MULTICAST,UDP_PORT,ifc);
+#elif defined(ESP32)
+  ok = channel.beginPacket(SSDP_MULTICAST,UDP_PORT);
+#endif
+  return ok;
+}
+
+IPAddress softAPSubnetMask() {
+#ifdef ESP8266
+  struct ip_info info;
+  if( wifi_get_ip_info(SOFTAP_IF,&info) ) return IPAddress(info.netmask.addr);
+  return IPAddress(255,255,255,0);
+#elif defined(ESP32)
+  uint8_t cidr = WiFi.softAPSubnetCIDR();
+  uint8_t mask[4] = {0,0,0,0};
+  for( int i=0; (i<4) && (cidr>0); i++ ) {
+    uint8_t bits = ((cidr>=8)?(8):(cidr));
+    mask[i] = (uint8_t)(0xFF << (8-bits));
+    cidr -= bits;
+  }
+  return IPAddress(mask[0],mask[1],mask[2],mask[3]);
 #else
-  channel.beginMulticast(INADDR_ANY,SSDP_MULTICAST,UDP_PORT);
+  return IPAddress(255,255,255,0);
 #endif
 }
 
@@ -248,113 +337,576 @@ void getUUID(char uuid[], int size, const char* st) {
    strncpy(uuid,uuidBuff,size);  
 }
 
-LoggingLevel SSDP::_logging = NONE;
+/**
+ *  Returns true if the ST.LEELANAUSOFTWARE.COM value has the space separated token bin, requesting binary responses
+ */
+boolean isBinaryRequest(const char* st_lsc) {
+  const char* p = st_lsc;
+  while( (p = strstr_P(p,BIN_TOKEN)) != NULL ) {
+    if( ((p == st_lsc) || (p[-1] == ' ')) && ((p[3] == '\0') || (p[3] == ' ')) ) return true;
+    p += 3;
+  }
+  return false;
+}
+
+/**
+ *  Print that fills a null terminated character buffer, truncating as snprintf would. Each write reports every byte
+ *  as written, so a response is rendered the same way into a buffer or into a packet.
+ */
+class BufferPrint : public Print {
+  public:
+  BufferPrint(char buffer[], int size) : _buffer(buffer), _size(size) {if( _size > 0 ) _buffer[0] = '\0';}
+  size_t write(uint8_t c)                         {return write(&c,1);}
+  size_t write(const uint8_t* data, size_t len) {
+    if( _len + 1 < _size ) {
+      size_t n = _size - _len - 1;
+      if( n > len ) n = len;
+      memcpy(_buffer + _len,data,n);
+      _len += n;
+      _buffer[_len] = '\0';
+    }
+    return len;
+  }
+  int    length()                                 {return _len;}
+
+  private:
+  char*  _buffer;
+  int    _size;
+  int    _len = 0;
+};
+
+/**
+ *  Write a literal segment of a template
+ */
+size_t writeLiteral(Print& out, PGM_P text, size_t len) {
+#ifdef ESP8266
+  return out.write_P(text,len);
+#else
+  return out.write((const uint8_t*)text,len);
+#endif
+}
+
+/**
+ *  Write at most size characters of a string field
+ */
+size_t writeField(Print& out, const char* value, size_t size) {
+  size_t len = strnlen(value,size);
+  return out.write((const uint8_t*)value,len);
+}
+
+/**
+ *  Write each literal of template t followed by its field value from f, and return the number of bytes written
+ */
+template<size_t N> size_t writeTemplate(Print& out, const ResponseSegment (&t)[N], const ResponseFields& f) {
+  size_t n = 0;
+  for( size_t i=0; i<N; i++ ) {
+    ResponseSegment seg;
+    memcpy_P(&seg,&t[i],sizeof(ResponseSegment));
+    ResponseField field = (ResponseField)seg.field;
+    n += writeLiteral(out,seg.text,seg.len);
+    switch( field ) {
+      case FIELD_LOCATION: n += writeField(out,f.location,fieldSize(field)); break;
+      case FIELD_ST:       n += writeField(out,f.st,fieldSize(field));       break;
+      case FIELD_UUID:     n += writeField(out,f.uuid,fieldSize(field));     break;
+      case FIELD_TYPE:     n += writeField(out,f.type,fieldSize(field));     break;
+      case FIELD_NAME:     n += writeField(out,f.name,fieldSize(field));     break;
+      case FIELD_DEVICES:  n += out.print(f.devices);                        break;
+      case FIELD_SERVICES: n += out.print(f.services);                       break;
+      case FIELD_PUUID:    n += writeField(out,f.puuid,fieldSize(field));    break;
+      case FIELD_TXN:      n += writeField(out,f.txn,fieldSize(field));      break;
+      case FIELD_NONE:                                                        break;
+    }
+  }
+  return n;
+}
+
+typedef enum {PACKET_UNKNOWN, PACKET_SEARCH, PACKET_RESPONSE, PACKET_OTHER} PacketStart;
+
+/**
+ *  Packet class from the first len bytes of a packet, as UPnPBuffer classifies it, or PACKET_UNKNOWN if the start 
+ *  line is not within them. buffer is null terminated at len.
+ */
+PacketStart packetStart(const char* buffer, int len) {
+  const char* p = buffer;
+  while( *p == ' ' ) {p++;}
+  if( (len - (p - buffer)) < 8 ) return PACKET_UNKNOWN;
+  if( strncmp_P(p,SEARCH_START,8) == 0 ) return PACKET_SEARCH;
+  if( strncmp_P(p,RESPONSE_START,8) == 0 ) return PACKET_RESPONSE;
+  return PACKET_OTHER;
+}
+
+/**
+ *  Match kind of a TRACE_MATCHED event, flagged when all devices and services are requested
+ */
+uint16_t traceMatch(uint16_t kind, const char* st_lsc) {
+  return kind | ((strncmp_P(st_lsc,SSDP_ALL,8) == 0)?(TRACE_MATCH_ALL):(0));
+}
+
+/**
+ *  Returns true if every device and service below the responder answers a search, so DESC counts tell how many
+ *  responses to expect: root searches with ssdp:all, and searches by uuid
+ */
+boolean answersAll(const char* ST, boolean ssdpAll) {
+  if( strcmp_P(ST,ST_UPNP_ROOTDEVICE) == 0 ) return ssdpAll;
+  return (strncmp_P(ST,ST_UUID,5) == 0);
+}
+
+SSDPInterface     SSDP::_interfaces[SSDP_MAX_INTERFACES];
+volatile boolean  SSDP::_interfacesDirty = true;
+SSDPSearchMetrics SSDP::_searchMetrics = SSDPSearchMetrics();
 
-SSDP::SSDP() {}
+SSDP::SSDP() {
+  _txn[0] = '\0';
+  _mChannel = &_mUdp;
+  for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {_channel[i] = &_udp[i];}
+  _clock.now  = []{return millis();};
+  _clock.wait = [](unsigned long ms){delay(ms);};
+  _bin.active = false;
+  for( int i=0; i<SSDP_MAX_SEARCHES; i++ ) {_searches[i].active = false; _searches[i].handler = NULL;}
+}
 
 int SSDP::getMulticastPort() {return UDP_PORT;}
-int SSDP::getUDPPort() {return getLocalPort(_udp);}
+int SSDP::getUDPPort() {return getLocalPort(_udp[SSDP_STA]);}
 
 /**
- *  Listening for SSDP search requests is done on the multicast channel, and replies are done on the
- *  unicast udp channel. Calling begin(0) allows udp to set an available port, which is sent on 
+ *  Register for WiFi network events once. Handlers only mark the interface table dirty, the table is re-read
+ *  on the next doSSDP() or search request.
+ */
+void SSDP::registerNetworkEvents() {
+  static boolean registered = false;
+  if( !registered ) {
+    registered = true;
+#ifdef ESP8266
+    static WiFiEventHandler gotIP        = WiFi.onStationModeGotIP([](const WiFiEventStationModeGotIP& e){SSDP::networkChanged();});
+    static WiFiEventHandler disconnected = WiFi.onStationModeDisconnected([](const WiFiEventStationModeDisconnected& e){SSDP::networkChanged();});
+#elif defined(ESP32)
+    WiFi.onEvent([](WiFiEvent_t e){SSDP::networkChanged();});
+#endif
+  }
+}
+
+void SSDP::refreshInterfaces() {
+  _interfacesDirty = false;
+  _interfaces[SSDP_STA].addr = WiFi.localIP();
+  _interfaces[SSDP_STA].mask = WiFi.subnetMask();
+  _interfaces[SSDP_STA].up   = ((uint32_t)_interfaces[SSDP_STA].addr != 0);
+  _interfaces[SSDP_AP].addr  = WiFi.softAPIP();
+  _interfaces[SSDP_AP].up    = ((uint32_t)_interfaces[SSDP_AP].addr != 0);
+  _interfaces[SSDP_AP].mask  = ((_interfaces[SSDP_AP].up)?(softAPSubnetMask()):(IPAddress()));
+  SSDP_LOG_FINE("SSDP::refreshInterfaces: Station %s soft AP %s\n",_interfaces[SSDP_STA].addr.toString().c_str(),
+                _interfaces[SSDP_AP].addr.toString().c_str());
+}
+
+const SSDPInterface* SSDP::interfaces() {
+  registerNetworkEvents();
+  if( _interfacesDirty ) refreshInterfaces();
+  return _interfaces;
+}
+
+/**
+ *  Listening for SSDP search requests is done on one multicast channel for all interfaces, and replies are done on the
+ *  unicast udp channel of the interface the request came from. Calling begin(0) allows udp to set an available port.
  */
 void SSDP::begin(RootDevice* root) {
+  HeapScope heap = HeapAccounting::enter(HEAP_SETUP);
   _root = root;
-  beginMulticast(_mUdp);
-  _udp.begin(0);
+  interfaces();
+  startInterfaces();
+  HeapAccounting::leave(heap);
+}
+
+/**
+ *  A single interface on caller supplied channels. The interface table of this instance is private, so several
+ *  instances with different addresses can run in one process.
+ */
+void SSDP::begin(RootDevice* root, UDP* multicast, UDP* unicast, IPAddress addr, IPAddress mask) {
+  _root   = root;
+  _custom = true;
+  _table  = _customTable;
+  for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {_customTable[i].up = false;}
+  _customTable[SSDP_STA].addr = addr;
+  _customTable[SSDP_STA].mask = mask;
+  _customTable[SSDP_STA].up   = true;
+  _mChannel          = multicast;
+  _channel[SSDP_STA] = unicast;
+}
+
+/**
+ *  The multicast channel is started once, when the first interface comes up. Group membership and the unicast channel
+ *  are restarted only for interfaces whose address changed since they were started.
+ */
+void SSDP::startInterfaces() {
+  if( !_listening && (_interfaces[SSDP_STA].up || _interfaces[SSDP_AP].up) ) {
+    beginMulticast(_mUdp);
+    _listening = true;
+  }
+  for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {
+    IPAddress addr = ((_interfaces[i].up)?(_interfaces[i].addr):(IPAddress()));
+    if( addr != _bound[i] ) {
+      if( (uint32_t)_bound[i] != 0 ) leaveGroup(_bound[i]);
+      _udp[i].stop();
+      _bound[i] = addr;
+      if( _interfaces[i].up ) {
+        joinGroup(addr);
+        beginUnicast(_udp[i],addr);
+        SSDP_LOG_INFO("SSDP::startInterfaces: Listening on %s\n",addr.toString().c_str());
+      }
+    }
+  }
 }
 
 void SSDP::doSSDP() {
-  doChannel(_mUdp);
-  doChannel(_udp);
+  int      probe = LoopProfiler::begin("ssdp");
+  uint32_t start = micros();
+  int      stack = StackProfiler::begin("ssdp");
+  if( !_custom && _interfacesDirty ) {
+    refreshInterfaces();
+    startInterfaces();
+  }
+  expireSearches();
+  if( _listening || _custom ) doChannel(*_mChannel,SSDP_STA,true);
+  for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {
+    if( _table[i].up ) doChannel(*_channel[i],i,false);
+  }
+  StackProfiler::end(stack);
+  LoopProfiler::end(probe,start);
 }
 
 /**
  *   Send an SSDP request and parse responses with SSDPHandler. Parse responses as long as they are viable, but
  *   don't wait any longer that timeout milliseconds for responses to come in.
  */
-SSDPResult SSDP::searchRequest(const char* ST, SSDPHandler handler, IPAddress ifc, int timeout, boolean ssdpAll) {
+SSDPResult SSDP::searchRequest(const char* ST, SSDPHandler handler, int timeout, boolean ssdpAll) {
+  int        stack  = StackProfiler::begin("searchRequest");
+  SSDPResult result = searchRequest(ST,handler,IPAddress(IPADDR_ANY),timeout,ssdpAll);
+  StackProfiler::end(stack);
+  return result;
+}
+
+SSDPResult SSDP::searchRecords(const char* ST, SSDPRecordHandler handler, int timeout, boolean ssdpAll) {
+  int        stack  = StackProfiler::begin("searchRecords");
+  SSDPResult result = searchRecords(ST,handler,IPAddress(IPADDR_ANY),timeout,ssdpAll);
+  StackProfiler::end(stack);
+  return result;
+}
+
+/**
+ *  Format an M-SEARCH request for ST into buffer, with extra header lines (or an empty string) appended. If binary
+ *  is true the bin token is added to the ST.LEELANAUSOFTWARE.COM value.
+ */
+SSDPResult SSDP::formatSearch(char buffer[], int size, const char* ST, boolean ssdpAll, boolean binary, const char* extra) {
   SSDPResult result = SSDP_OK;
-  char txnBuffer[SSDP_BUFFER_SIZE];
   if( strcmp_P(ST,ST_UPNP_ROOTDEVICE) == 0) {
-     if(ssdpAll) snprintf_P(txnBuffer,SSDP_BUFFER_SIZE,SSDP_RootAllSearch);
-     else snprintf_P(txnBuffer,SSDP_BUFFER_SIZE,SSDP_RootSearch);
+     if(ssdpAll) snprintf_P(buffer,size,SSDP_RootAllSearch,((binary)?(" bin"):("")),extra);
+     else snprintf_P(buffer,size,SSDP_RootSearch,((binary)?("bin"):("")),extra);
   }
-  else if((strncmp_P(ST,ST_UUID,5) == 0) ) snprintf_P(txnBuffer,SSDP_BUFFER_SIZE,SSDP_Search,ST);
-  else if((strncmp_P(ST,ST_TYPE,4) == 0))  snprintf_P(txnBuffer,SSDP_BUFFER_SIZE,SSDP_Search,ST);
+  else if((strncmp_P(ST,ST_UUID,5) == 0) ) snprintf_P(buffer,size,SSDP_Search,ST,((binary)?(" bin"):("")),extra);
+  else if((strncmp_P(ST,ST_TYPE,4) == 0))  snprintf_P(buffer,size,SSDP_Search,ST,((binary)?(" bin"):("")),extra);
   else result = SSDP_ERR_ST;
+  return result;
+}
 
+SSDPResult SSDP::searchRequest(const char* ST, SSDPHandler handler, IPAddress ifc, int timeout, boolean ssdpAll) {
+  HeapScope heap = HeapAccounting::enter(HEAP_SSDP_SEARCH);
+  char request[SSDP_BUFFER_SIZE];
+  SSDPResult result = formatSearch(request,SSDP_BUFFER_SIZE,ST,ssdpAll,false,"");
   if( result == SSDP_OK ) {
-  
-  WiFiUDP udp;
-  int ok = 0;
+    SearchTracker tracker;
+    result = runSearch(request,ifc,timeout,answersAll(ST,ssdpAll),tracker,[ST,handler,&tracker](char* packet, int len) {
+      UPnPBuffer upnpBuff = UPnPBuffer(packet);
+      if( !upnpBuff.isSearchResponse() ) return false;
+           
+/**
+ *    The response MUST have an ST header and the ST header MUST match the search request
+ */
+      char st_header[ST_HEADER_SIZE];
+      st_header[0] = '\0';
+      if( upnpBuff.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) ) {
+        if( strcmp(st_header,ST) == 0) {  
+/**                
+ *        All LSC Devices MUST have a DESC Header in the response
+ */
+          char name[32];
+          if( upnpBuff.displayName(name,32) ) {
+            SSDP_METRIC(SSDPRecord record; if( record.parse(upnpBuff) ) tracker.response(record,millis()));
+            handler(&upnpBuff);
+          }
+          else SSDP_LOG_FINE("SSDP::searchRequest: DESC Header not found\n");
+        }
+        else {
+          SSDP_METRIC(tracker.nonMatching());
+          SSDP_LOG_FINE("SSDP::searchRequest: Search Response %s does not match request %s\n",st_header,ST);
+        }
+      }
+      return true;
+    });
+  }
+  HeapAccounting::leave(heap);
+  return result;
+}
 
-#ifdef ESP8266
-  udp.begin(0);
-  ok = udp.beginPacketMulticast(IPAddress(239,255,255,250),1900,ifc);
-#elif defined(ESP32)
-  udp.begin(ifc,0);
-  ok = udp.beginPacket(IPAddress(239,255,255,250),1900);
-#endif
+/**
+ *  Binary response packets are matched to the request by the hash of ST in the packet header, text responses by the
+ *  ST header, as in searchRequest()
+ */
+SSDPResult SSDP::searchRecords(const char* ST, SSDPRecordHandler handler, IPAddress ifc, int timeout, boolean ssdpAll) {
+  HeapScope heap = HeapAccounting::enter(HEAP_SSDP_SEARCH);
+  char request[SSDP_BUFFER_SIZE];
+  SSDPResult result = formatSearch(request,SSDP_BUFFER_SIZE,ST,ssdpAll,true,"");
+  if( result == SSDP_OK ) {
+    uint32_t stHash = SSDPRecord::hash(ST);
+    SearchTracker tracker;
+    result = runSearch(request,ifc,timeout,answersAll(ST,ssdpAll),tracker,[ST,stHash,handler,&tracker](char* packet, int len) {
+      SSDPRecord record;
+      uint32_t   h = 0;
+      int    count = SSDPRecord::readHeader(packet,len,NULL,&h);
+      if( count >= 0 ) {
+        if( h != stHash ) {
+          SSDP_METRIC(tracker.nonMatching());
+          SSDP_LOG_FINE("SSDP::searchRecords: Binary response does not match request %s\n",ST);
+          return true;
+        }
+        const uint8_t* data = (const uint8_t*)packet;
+        int pos = SSDP_BIN_HEADER_SIZE;
+        for( int i=0; i<count; i++ ) {
+          int n = record.decode(data+pos,len-pos);
+          if( n == 0 ) {
+            SSDP_LOG_WARNING("SSDP::searchRecords: Truncated binary response, %d of %d records read\n",i,count);
+            break;
+          }
+          pos += n;
+          SSDP_METRIC(tracker.response(record,millis()));
+          handler(&record);
+        }
+        return true;
+      }
+      UPnPBuffer upnpBuff = UPnPBuffer(packet);
+      if( !upnpBuff.isSearchResponse() ) return false;
+      char st_header[ST_HEADER_SIZE];
+      st_header[0] = '\0';
+      if( upnpBuff.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) && (strcmp(st_header,ST) == 0) ) {
+        if( record.parse(upnpBuff) ) {
+          SSDP_METRIC(tracker.response(record,millis()));
+          handler(&record);
+        }
+        else SSDP_LOG_FINE("SSDP::searchRecords: USN or DESC Header not found\n");
+      }
+      else {SSDP_METRIC(tracker.nonMatching());}
+      return true;
+    });
+  }
+  HeapAccounting::leave(heap);
+  return result;
+}
 
-  if( ok != 1 ) {
-    result = SSDP_ERR_UDP;
-    if( loggingLevel(WARNING) ) Serial.printf("SSDP::searchRequest: Error on beginPacket\n");  
+/**
+ *  Send a formatted search request and hand each packet received to onPacket, which returns true if the packet was
+ *  a search response. Responses are read as long as they are viable, but no longer than timeout milliseconds after
+ *  the last response. The session is tracked by tracker, which onPacket is given responses to; all is true if every
+ *  device and service below a responder answers.
+ */
+SSDPResult SSDP::runSearch(const char* request, IPAddress ifc, int timeout, boolean all, SearchTracker& tracker, std::function<boolean(char*,int)> onPacket) {
+  SSDPResult result = SSDP_OK;
+
+/**
+ *  Select the interfaces for this session, either every interface that is up or the single interface ifc. An ifc
+ *  not in the interface table is used as given.
+ */
+  IPAddress addrs[SSDP_MAX_INTERFACES];
+  int numAddrs = 0;
+  const SSDPInterface* table = interfaces();
+  if( (uint32_t)ifc == IPADDR_ANY ) {
+    for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {if( table[i].up ) addrs[numAddrs++] = table[i].addr;}
   }
-  if( result == SSDP_OK ) {
-    int len = strlen(txnBuffer);
-    int sz = udp.write((unsigned char*)txnBuffer,len);
-    ok = udp.endPacket();  
+  else addrs[numAddrs++] = ifc;
+
+  WiFiUDP udp[SSDP_MAX_INTERFACES];
+  int len  = strlen(request);
+  int sent = 0;
+  for( int i=0; i<numAddrs; i++ ) {
+    beginUnicast(udp[i],addrs[i]);
+    int ok = beginSearchPacket(udp[i],addrs[i]);
     if( ok != 1 ) {
-      result = SSDP_ERR_SEND;
-      if( loggingLevel(WARNING) ) Serial.printf("SSDP::searchRequest: Error on endPacket attempt to send %d bytes\n",len);
+      SSDP_LOG_WARNING("SSDP::searchRequest: Error on beginPacket for interface %s\n",addrs[i].toString().c_str());
+      continue;
     }
+    udp[i].write((const unsigned char*)request,len);
+    ok = udp[i].endPacket();
+    if( ok != 1 ) {
+      SSDP_LOG_WARNING("SSDP::searchRequest: Error on endPacket attempt to send %d bytes\n",len);
+    }
+    else sent++;
+  }
+  if( numAddrs == 0 ) result = SSDP_ERR_UDP;
+  else if( sent == 0 ) result = SSDP_ERR_SEND;
+  else {
+    SSDP_METRIC(tracker.begin(millis(),all));
     delay(500);
   }
+
   if( result == SSDP_OK ) {
-      long timeStamp = millis();
-      boolean done = false;
-      while( (millis() - timeStamp < timeout) && !done ) {
-         int packetSize = udp.parsePacket();
-         if( packetSize > 0 ) {
-           IPAddress remote = udp.remoteIP();
-           txnBuffer[0] = 0;
-           int available = udp.read(txnBuffer, SSDP_BUFFER_SIZE);
-           txnBuffer[available] = 0;
-           UPnPBuffer upnpBuff = UPnPBuffer(txnBuffer);
-           if( upnpBuff.isSearchResponse() ) {
-/**
- *           Reset the timestamp if we have an incomming response
- */
-             timeStamp = millis();
-           
+    char txnBuffer[SSDP_BUFFER_SIZE];
+    long timeStamp = millis();
+    while( millis() - timeStamp < timeout ) {
+      boolean idle = true;
+      for( int i=0; i<numAddrs; i++ ) {
+        int packetSize = udp[i].parsePacket();
+        if( packetSize > 0 ) {
+          idle = false;
+          txnBuffer[0] = 0;
+          int available = udp[i].read(txnBuffer, SSDP_BUFFER_SIZE-1);
+          if( available < 0 ) available = 0;
+          txnBuffer[available] = 0;
 /**
- *           The response MUST have an ST header and the ST header MUST match the search request
+ *        Reset the timestamp if we have an incomming response
  */
-             char st_header[ST_HEADER_SIZE];
-             st_header[0] = '\0';
-             if( upnpBuff.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) ) {
-               if( strcmp(st_header,ST) == 0) {  
-/**                
- *               All LSC Devices MUST have a DESC Header in the response
+          if( onPacket(txnBuffer,available) ) timeStamp = millis();
+        }
+      }
+      if( idle ) delay(100);
+    }
+    SSDP_METRIC(tracker.end(millis(),_searchMetrics));
+  }
+  for( int i=0; i<numAddrs; i++ ) {udp[i].stop();}
+  return result;
+}
+
+/**
+ *  Start a search session on the responder channels. The request is multicast from the unicast channel of every
+ *  interface that is up, and carries a TXN.LEELANAUSOFTWARE.COM header so responses can be matched to the session.
+ *  Responses are read in doSSDP() along with search requests, so there is no per-search socket setup.
  */
-                 char name[32];
-                 if( upnpBuff.displayName(name,32) ) handler(&upnpBuff);
-                 else if( loggingLevel(FINE) ) Serial.printf("SSDP::searchRequest: DESC Header not found\n");
-               }
-               else if( loggingLevel(FINE) ) Serial.printf("SSDP::searchRequest: Search Response %s does not match request %s\n",st_header,ST);
-             }
-           }
+SSDPResult SSDP::startSearch(const char* ST, SSDPHandler handler, int timeout, boolean ssdpAll, int* id, SSDPSearchEnd done) {
+  PERF_SCOPE("ssdp","startSearch");
+  int slot = -1;
+  for( int i=0; (i<SSDP_MAX_SEARCHES) && (slot<0); i++ ) {if( !_searches[i].active ) slot = i;}
+  if( slot < 0 ) {
+    SSDP_LOG_WARNING("SSDP::startSearch: All %d search sessions are active\n",SSDP_MAX_SEARCHES);
+    return SSDP_ERR_BUSY;
+  }
+
+  HeapScope heap = HeapAccounting::enter(HEAP_SSDP_SEARCH);
+  SSDPSearch& search = _searches[slot];
+  if( _nextTxn == 0 ) _nextTxn = hardwareRandom();                        // Devices booting together start from different transactions
+  if( ++_nextTxn == 0 ) ++_nextTxn;                                       // Transaction 0 is a response without a transaction
+  search.txn = _nextTxn;
+  char txnValue[SSDP_TXN_SIZE];
+  char txnLine[TXN_LINE_SIZE];
+  snprintf(txnValue,SSDP_TXN_SIZE,"%08lx",(unsigned long)search.txn);
+  snprintf_P(txnLine,TXN_LINE_SIZE,TXN_LSC_LINE,txnValue);
+
+  char txnBuffer[SSDP_BUFFER_SIZE];
+  SSDPResult result = formatSearch(txnBuffer,SSDP_BUFFER_SIZE,ST,ssdpAll,false,txnLine);
+  if( result == SSDP_OK ) {
+    int len  = strlen(txnBuffer);
+    int sent = 0;
+    for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {
+      if( _table[i].up ) {
+        int ok = ((_custom)?(_channel[i]->beginPacket(SSDP_MULTICAST,UDP_PORT)):(beginSearchPacket(_udp[i],_table[i].addr)));
+        if( ok == 1 ) {
+          _channel[i]->write((unsigned char*)txnBuffer,len);
+          ok = _channel[i]->endPacket();
         }
-        delay(100);
+        if( ok == 1 ) sent++;
+        else SSDP_LOG_WARNING("SSDP::startSearch: Error sending search on interface %s\n",_table[i].addr.toString().c_str());
       }
-      udp.stop();
     }
+    if( sent == 0 ) result = SSDP_ERR_SEND;
+    else SSDP_TRACE_EVENT(TRACE_SEARCH_BEGIN,0xff,sent,search.txn);
+  }
+  if( result == SSDP_OK ) {
+    strlcpy(search.st,ST,ST_HEADER_SIZE);
+    search.handler      = handler;
+    search.done         = done;
+    search.timeout      = timeout;
+    search.lastResponse = _clock.now();
+    search.active       = true;
+    SSDP_METRIC(search.tracker.begin(search.lastResponse,answersAll(ST,ssdpAll)));
+    if( id != NULL ) *id = slot;
+  }
+  HeapAccounting::leave(heap);
+  return result;
+}
+
+boolean SSDP::searchActive(int id) {
+  return (((id>=0)&&(id<SSDP_MAX_SEARCHES))?(_searches[id].active):(false));
+}
+
+void SSDP::cancelSearch(int id) {endSearch(id,SSDP_CANCELLED);}
+
+/**
+ *  The session is free before done is called, so done may start another search
+ */
+void SSDP::endSearch(int id, SSDPResult result) {
+  if( (id>=0) && (id<SSDP_MAX_SEARCHES) ) {
+    SSDPSearchEnd done = ((_searches[id].active)?(_searches[id].done):(NULL));
+    SSDP_METRIC(if( _searches[id].active ) _searches[id].tracker.end(_clock.now(),_searchMetrics));
+    if( _searches[id].active ) SSDP_TRACE_EVENT(TRACE_SEARCH_END,0xff,id,_searches[id].txn);
+    _searches[id].active  = false;
+    _searches[id].handler = NULL;
+    _searches[id].done    = NULL;
+    if( done ) done(result);
+  }
+}
+
+/**
+ *  Blocking search on the responder channels. doSSDP() is called while waiting, so this device continues to answer
+ *  search requests for the duration of the search.
+ */
+SSDPResult SSDP::search(const char* ST, SSDPHandler handler, int timeout, boolean ssdpAll) {
+  int id = -1;
+  SSDPResult result = startSearch(ST,handler,timeout,ssdpAll,&id);
+  while( (result == SSDP_OK) && searchActive(id) ) {
+    doSSDP();
+    yield();
   }
   return result;
 }
 
+/**
+ *  Search sessions end once timeout milliseconds pass without a response
+ */
+void SSDP::expireSearches() {
+  unsigned long now = _clock.now();
+  for( int i=0; i<SSDP_MAX_SEARCHES; i++ ) {
+    if( _searches[i].active && (now - _searches[i].lastResponse >= (unsigned long)_searches[i].timeout) ) endSearch(i,SSDP_OK);
+  }
+}
+
+/**
+ *  Hand a search response to the session it belongs to. Responses carrying a transaction go only to the session with
+ *  that transaction; responses from devices that do not echo the transaction go to every session with a matching ST.
+ */
+void SSDP::handleSearchResponse(UPnPBuffer& buffer) {
+  PERF_SCOPE("ssdp","searchResponse");
+  char st_header[ST_HEADER_SIZE];
+  char txn[SSDP_TXN_SIZE];
+  char name[32];
+  st_header[0] = '\0';
+  txn[0]       = '\0';
+  if( !buffer.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) ) return;
+  if( !buffer.displayName(name,32) ) {
+    SSDP_LOG_FINE("SSDP::handleSearchResponse: DESC Header not found\n");
+    return;
+  }
+  uint32_t id = 0;
+  if( buffer.headerValue_P(TXN_LSC_HEADER,txn,SSDP_TXN_SIZE) ) id = strtoul(txn,NULL,16);
+  SSDP_METRIC(SSDPRecord record; boolean parsed = false);
+  for( int i=0; i<SSDP_MAX_SEARCHES; i++ ) {
+    SSDPSearch& search = _searches[i];
+    if( search.active && (strcmp(search.st,st_header) == 0) && ((id == 0) || (id == search.txn)) ) {
+      search.lastResponse = _clock.now();
+      SSDP_METRIC(if( !parsed ) parsed = record.parse(buffer); if( parsed ) search.tracker.response(record,search.lastResponse));
+      search.handler(&buffer);
+    }
+    else {SSDP_METRIC(if( search.active ) search.tracker.nonMatching());}
+  }
+}
+
+void SSDP::txnHeader(char buffer[], int size) {
+  buffer[0] = '\0';
+  if( _txn[0] != '\0' ) snprintf_P(buffer,size,TXN_LSC_LINE,_txn);
+}
 
 /**  Read UDP Channel and respond according to the ST and ST.LEELANAUSOFTWARE.COM headers  
  *   
@@ -366,7 +918,8 @@ SSDPResult SSDP::searchRequest(const char* ST, SSDPHandler handler, IPAddress if
  *         
  */
 
-boolean SSDP::readChannel(WiFiUDP& channel) {
+boolean SSDP::readChannel(UDP& channel, int ifc) {
+  PERF_SCOPE("ssdp","receive");
   boolean   result       = false;
   IPAddress remoteAddr   = channel.remoteIP();
   int       port         = channel.remotePort();
@@ -375,25 +928,33 @@ boolean SSDP::readChannel(WiFiUDP& channel) {
  *  Post handler defaults to do nothing.
  */
   setPostHandler([]{});
+  _txn[0] = '\0';
+  SSDP_METRIC(_parsed = 0);
   
 //  read the packet into readBufffer
   char txnBuffer[TXN_BUFFER_SIZE + 1];
-  txnBuffer[0] = 0;
-  int available = channel.read(txnBuffer, TXN_BUFFER_SIZE);
-  txnBuffer[available] = 0;
+  int  available = 0;
+  if( !prefilter(channel,txnBuffer,available,ifc) ) return false;
   UPnPBuffer buffer = UPnPBuffer(txnBuffer);
 
   if( buffer.isSearchRequest() ) {
     char st_lsc_header[ST_LSC_HEADER_SIZE];
     st_lsc_header[0] = '\0';
     if( buffer.headerValue_P(ST_LSC_HEADER,st_lsc_header,ST_LSC_HEADER_SIZE) ) {  // If the packet has an LSC header field
+       SSDP_METRIC(_metrics.lscSearches++);
+       buffer.headerValue_P(TXN_LSC_HEADER,_txn,SSDP_TXN_SIZE);                    // Transaction is echoed on each response if present
+       SSDP_TRACE_EVENT(TRACE_LSC_SEARCH,ifc,isBinaryRequest(st_lsc_header),strtoul(_txn,NULL,16));
        char st_header[ST_HEADER_SIZE];
        st_header[0] = '\0';
-       if( buffer.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) ) { // If the packet has an ST header field  
+       if( buffer.headerValue_P(ST_HEADER,st_header,ST_HEADER_SIZE) && !buffer.truncated() ) { // If the packet has an ST header field that fits 
+          PERF_SCOPE("ssdp","match");
+          SSDP_METRIC(_parsed = ESP.getCycleCount());
+          if( isBinaryRequest(st_lsc_header) ) beginRecords(remoteAddr,port,ifc,st_header);
           if( strncmp_P(st_header,ST_UPNP_ROOTDEVICE,15) == 0 ) { // If this is a Root Device search
              result = true;
-             if(strncmp_P(st_lsc_header,SSDP_ALL,8) == 0) setPostHandler([this,st_header,remoteAddr,port]{this->postAllResponse(_root,st_header,remoteAddr,port);});
-             else setPostHandler([this,st_header,remoteAddr,port]{this->postDeviceResponse(_root,st_header,remoteAddr,port);});
+             if(strncmp_P(st_lsc_header,SSDP_ALL,8) == 0) setPostHandler([this,st_header,remoteAddr,port,ifc]{this->postAllResponse(_root,st_header,remoteAddr,port,ifc);});
+             else setPostHandler([this,st_header,remoteAddr,port,ifc]{this->postDeviceResponse(_root,st_header,remoteAddr,port,ifc);});
+             SSDP_TRACE_EVENT(TRACE_MATCHED,ifc,traceMatch(TRACE_MATCH_ROOT,st_lsc_header),SSDPRecord::hash(st_header));
            }
            else if( strncmp_P(st_header,ST_UUID,5) == 0 ) { // If this is a search by UUID
              char uuid[UUID_SIZE];
@@ -404,34 +965,186 @@ boolean SSDP::readChannel(WiFiUDP& channel) {
              UPnPDevice* device = _root->getDevice(uuid);
              if( device != NULL ) {
                 result = true;
-                if(strncmp_P(st_lsc_header,SSDP_ALL,8) == 0) setPostHandler([this,device,st_header,remoteAddr,port]{this->postAllResponse(device,st_header,remoteAddr,port);});
-                else setPostHandler([this,device,st_header,remoteAddr,port]{this->postDeviceResponse(device,st_header,remoteAddr,port);});
+                if(strncmp_P(st_lsc_header,SSDP_ALL,8) == 0) setPostHandler([this,device,st_header,remoteAddr,port,ifc]{this->postAllResponse(device,st_header,remoteAddr,port,ifc);});
+                else setPostHandler([this,device,st_header,remoteAddr,port,ifc]{this->postDeviceResponse(device,st_header,remoteAddr,port,ifc);});
+                SSDP_TRACE_EVENT(TRACE_MATCHED,ifc,traceMatch(TRACE_MATCH_UUID,st_lsc_header),SSDPRecord::hash(st_header));
              } 
-             else if( loggingLevel(FINE) ) Serial.printf("SSDP::readChannel: device with uuid [%s] does not exist\n",uuid);    
+             else {
+                SSDP_TRACE_EVENT(TRACE_NO_MATCH,ifc,0,SSDPRecord::hash(st_header));
+                SSDP_LOG_FINE("SSDP::readChannel: device with uuid [%s] does not exist\n",uuid);    
+             }
           }
           else if(strncmp_P(st_header,ST_TYPE,4) == 0) { // If this is a search by device/service type
             result = true;      
-            setPostHandler([this,st_header,remoteAddr,port]{this->postAllMatching(_root,st_header,remoteAddr,port);});
+            setPostHandler([this,st_header,remoteAddr,port,ifc]{this->postAllMatching(_root,st_header,remoteAddr,port,ifc);});
+            SSDP_TRACE_EVENT(TRACE_MATCHED,ifc,traceMatch(TRACE_MATCH_TYPE,st_lsc_header),SSDPRecord::hash(st_header));
           }
        }
-       else if( loggingLevel(FINE) ) Serial.printf("SSDP::readChannel: Packet does not have ST header\n");
+       else {
+          SSDP_TRACE_EVENT(TRACE_NO_MATCH,ifc,0,0);
+          SSDP_LOG_FINE("SSDP::readChannel: Packet does not have ST header, or ST is longer than %d\n",ST_HEADER_SIZE-1);
+       }
+    }
+    else {
+       SSDP_METRIC(_metrics.otherSearches++);
+       SSDP_TRACE_EVENT(TRACE_OTHER_SEARCH,ifc,0,0);
     }
   }  
+  else if( buffer.isSearchResponse() ) {
+    SSDP_METRIC(_metrics.responses++; _parsed = ESP.getCycleCount());
+    SSDP_TRACE_EVENT(TRACE_RESPONSE,ifc,0,0);
+    HeapScope heap = HeapAccounting::enter(HEAP_SSDP_SEARCH);
+    handleSearchResponse(buffer);
+    HeapAccounting::leave(heap);
+  }
+  else {
+    SSDP_METRIC(_metrics.other++);
+    SSDP_TRACE_EVENT(TRACE_OTHER,ifc,0,0);
+  }
   return result;  
 }
 
-void SSDP::doChannel(WiFiUDP& channel) {
+/**
+ *  Most traffic on port 1900 is NOTIFY and third party searches, which the responder ignores. The start line is read 
+ *  first, and a packet that is neither a search nor a search response, or a response while no search is active, is
+ *  rejected without reading the rest. A search is read in full, and rejected unless the LSC header token appears 
+ *  somewhere in it. Rejections are conservative: a packet that passes may still be ignored once parsed, but a packet
+ *  rejected would always have been ignored. Returns true with the packet null terminated in buffer if it passes.
+ *  The unread rest of a rejected packet is discarded by the next parsePacket(); flush() is not used since on ESP8266
+ *  it sends rather than discards.
+ */
+boolean SSDP::prefilter(UDP& channel, char buffer[], int& len, int ifc) {
+  SSDP_METRIC(int size = channel.available());
+  len = channel.read(buffer,SSDP_PEEK_SIZE);
+  if( len < 0 ) len = 0;
+  buffer[len] = '\0';
+  PacketStart start = packetStart(buffer,len);
+  if( (start == PACKET_OTHER) || ((start == PACKET_RESPONSE) && !searching()) ) {
+    if( start == PACKET_OTHER ) {
+      SSDP_METRIC(_metrics.other++; _metrics.rejectedOther++);
+      SSDP_TRACE_EVENT(TRACE_OTHER,ifc,1,0);
+    }
+    else {
+      SSDP_METRIC(_metrics.responses++; _metrics.rejectedResponses++);
+      SSDP_TRACE_EVENT(TRACE_RESPONSE,ifc,1,0);
+    }
+    SSDP_METRIC(_metrics.bytesSkipped += size - len);
+    return false;
+  }
+  if( len == SSDP_PEEK_SIZE ) {
+    int n = channel.read(buffer+len,TXN_BUFFER_SIZE-len);
+    if( n > 0 ) len += n;
+    buffer[len] = '\0';
+  }
+  if( (start == PACKET_SEARCH) && (memmem(buffer,len,LSC_TOKEN,LSC_TOKEN_LEN) == NULL) ) {
+    SSDP_METRIC(_metrics.otherSearches++; _metrics.rejectedSearches++);
+    SSDP_TRACE_EVENT(TRACE_OTHER_SEARCH,ifc,1,0);
+    return false;
+  }
+  return true;
+}
+
+boolean SSDP::searching() {
+  for( int i=0; i<SSDP_MAX_SEARCHES; i++ ) {if( _searches[i].active ) return true;}
+  return false;
+}
+
+void SSDP::doChannel(UDP& channel, int ifc, boolean multicast) {
 /**
  * if there's data available, read a packet. If a response is required, post it.
+ * The multicast channel receives for all interfaces, so each packet is handled on the interface of the network it
+ * came from. Packets from outside any interface network (routed requests) are handled by the first interface that is up.
  */
   int packetSize = channel.parsePacket();
   boolean reply = false;
   if (packetSize) {
-    reply = readChannel(channel);
+    PERF_SCOPE_ARG("ssdp","packet","bytes",packetSize);
+    if( multicast && !_custom ) {
+      ifc = interfaceIndex(channel.remoteIP());
+      if( ifc < 0 ) {
+        ifc = ((_interfaces[SSDP_STA].up)?(SSDP_STA):(SSDP_AP));
+        SSDP_METRIC(_metrics.filtered++);
+        SSDP_TRACE_EVENT(TRACE_FILTERED,ifc,0,(uint32_t)channel.remoteIP());
+      }
+    }
+    SSDP_METRIC(_metrics.received++; _metrics.bytesIn += packetSize);
+    SSDP_TRACE_EVENT(TRACE_RECEIVED,ifc,packetSize,(uint32_t)channel.remoteIP());
+    if( packetSize > TXN_BUFFER_SIZE ) SSDP_TRACE_EVENT(TRACE_TRUNCATED,ifc,TXN_BUFFER_SIZE,0);
+    uint32_t  start = ESP.getCycleCount();
+    HeapScope heap  = HeapAccounting::enter(HEAP_SSDP_RECEIVE);
+    reply = readChannel(channel,ifc);
+    HeapAccounting::leave(heap);
+    uint32_t read = ESP.getCycleCount();
+    _timings.packets++;
+    _timings.readCycles += read - start;
+    SSDP_METRIC(uint32_t parsed = ((_parsed != 0)?(_parsed):(read)); _metrics.parse.addCycles(parsed - start));
+    if( reply ) {
+      PERF_SCOPE("ssdp","post");
+      SSDP_METRIC(_excluded = 0);
+      heap = HeapAccounting::enter(HEAP_SSDP_RESPONSE);
+      _postHandler();
+      if( _bin.active ) flushRecords();
+      HeapAccounting::leave(heap);
+      SSDP_TRACE_EVENT(TRACE_REPLIED,ifc,0,0);
+      uint32_t posted = ESP.getCycleCount();
+      _timings.replies++;
+      _timings.postCycles += posted - read;
+      SSDP_METRIC(_metrics.matched++; _metrics.match.addCycles((read - parsed) + (posted - read - _excluded)));
+    }
   }
-  if( reply ) {
-    _postHandler();
+  _bin.active = false;
+}
+
+/**
+ *   If this device is a RootDevice use the Root template, otherwise use the Device template
+ *   Note that RootDevice location does not include the root target, so display will default to RootDevice::displayRoot()
+ */
+int SSDP::writeResponse(Print& out, UPnPDevice* d, const char* st, IPAddress ifc, const char* txnLine) {
+  PERF_SCOPE("ssdp","render");
+  RootDevice* r = d->asRootDevice();
+  UPnPDevice* p = d->parentAsDevice();
+  char locBuff[SSDP_LOCATION_SIZE];
+  locBuff[0] = '\0';
+  if( r != NULL ) r->rootLocation(locBuff,SSDP_LOCATION_SIZE,ifc);
+  else d->location(locBuff,SSDP_LOCATION_SIZE,ifc); 
+  
+  ResponseFields f = {locBuff,st,d->uuid(),d->getType(),d->getDisplayName(),0,d->numServices(),"",txnLine};
+  if( r != NULL ) {
+    f.devices  = r->numDevices();
+    f.services = r->numServices();
+    return writeTemplate(out,ROOT_TEMPLATE,f);
+  }
+  else if( p != NULL ) {
+    f.puuid = p->uuid();
+    return writeTemplate(out,DEVICE_TEMPLATE,f);
   }
+  else return writeTemplate(out,ROOT_TEMPLATE,f);       // Error state, non-root should have a parent
+}
+
+/**
+ *   A service without a parent device has no USN, and writes an empty response
+ */
+int SSDP::writeResponse(Print& out, UPnPService* s, const char* st, IPAddress ifc, const char* txnLine) {
+  PERF_SCOPE("ssdp","render");
+  UPnPDevice* p = s->parentAsDevice();
+  if( p == NULL ) return 0;
+  char locBuff[SSDP_LOCATION_SIZE];
+  locBuff[0] = '\0';
+  s->location(locBuff,SSDP_LOCATION_SIZE,ifc);
+  ResponseFields f = {locBuff,st,p->uuid(),s->getType(),s->getDisplayName(),0,0,p->uuid(),txnLine};
+  return writeTemplate(out,SERVICE_TEMPLATE,f);
+}
+
+int SSDP::formatResponse(char buffer[], int size, UPnPDevice* d, const char* st, IPAddress ifc, const char* txnLine) {
+  BufferPrint out(buffer,size);
+  writeResponse(out,d,st,ifc,txnLine);
+  return out.length();
+}
+
+int SSDP::formatResponse(char buffer[], int size, UPnPService* s, const char* st, IPAddress ifc, const char* txnLine) {
+  BufferPrint out(buffer,size);
+  writeResponse(out,s,st,ifc,txnLine);
+  return out.length();
 }
 
 /**
@@ -442,143 +1155,271 @@ void SSDP::doChannel(WiFiUDP& channel) {
  *      
  *   
  */
-void SSDP::postDeviceResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port) {
-  char txnBuffer[TXN_BUFFER_SIZE + 1];
-  txnBuffer[0] = '\0';
-  RootDevice* r = d->asRootDevice();
-  UPnPDevice* p = d->parentAsDevice();
-
+void SSDP::postDeviceResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifcIndex) {
+  SSDP_METRIC(uint32_t start = ESP.getCycleCount(); uint32_t excluded = _excluded);
+  if( _bin.active ) {
+    SSDPRecord record;
+    record.set(d,_table[ifcIndex].addr);
+    appendRecord(record);
+    SSDP_METRIC(countRender(start,_excluded - excluded));
+    return;
+  }
 /**  
  *  Device location is set to the network adapter receiving the incoming request (either localIP or softAPIP)
  */
-  IPAddress ifc = interfaceAddress(remoteAddr);
-  
-/**
- *   If this device is a RootDevice use the Root template, otherwise use the Device template
- *   Note that RootDevice location does not include the root target, so display will default to RootDevice::displayRoot()
- */
-  char locBuff[128];
-  locBuff[0] = '\0';
-  if( r != NULL ) r->rootLocation(locBuff,128,ifc);
-  else d->location(locBuff,128,ifc); 
-  
-  if( (r != NULL) ) 
-    snprintf_P(txnBuffer,TXN_BUFFER_SIZE,ROOT_RESPONSE,locBuff,st,d->uuid(),d->getType(),d->getDisplayName(),r->numDevices(),r->numServices());  
-  else if( p != NULL ) 
-    snprintf_P(txnBuffer,TXN_BUFFER_SIZE,DEVICE_RESPONSE,locBuff,st,d->uuid(),d->getType(),d->getDisplayName(),d->numServices(),p->uuid());
-  else 
-    snprintf_P(txnBuffer,TXN_BUFFER_SIZE,ROOT_RESPONSE,locBuff,st,d->uuid(),d->getType(),d->getDisplayName(),0,d->numServices()); // Error state, non-root should have a parent
-
-  int len = strlen(txnBuffer);
-  int ok = _udp.beginPacket(remoteAddr, port);
+  UDP&      udp = *_channel[ifcIndex];
+  char txnLine[TXN_LINE_SIZE];
+  txnHeader(txnLine,TXN_LINE_SIZE);
+  PERF_TRACEPOINT(uint64_t sendStart = PerfTrace::now());
+  int ok = udp.beginPacket(remoteAddr, port);
   if( ok != 1 ) {
-    if( loggingLevel(WARNING) ) Serial.printf("postDeviceResponse: Error on beginPacket\n");
+    SSDP_LOG_WARNING("postDeviceResponse: Error on beginPacket\n");
   }
-  int sz = _udp.write((unsigned char*)txnBuffer,len);
-  ok = _udp.endPacket();
+  int len = writeResponse(udp,d,st,_table[ifcIndex].addr,txnLine);
+  SSDP_METRIC(countRender(start,0); start = ESP.getCycleCount());
+  SSDP_TRACE_EVENT(TRACE_QUEUED,ifcIndex,len,0);
+  int sent = ok;
+  ok = udp.endPacket();
+  SSDP_TRACE_EVENT((((sent == 1) && (ok == 1))?(TRACE_SENT):(TRACE_SEND_FAILED)),ifcIndex,len,(uint32_t)remoteAddr);
+  PERF_TRACEPOINT(PerfTrace::complete("ssdp","send",sendStart,"bytes",len));
+  SSDP_METRIC(countSend((sent == 1) && (ok == 1),len,start));
   if( ok != 1 ) {
-    if( loggingLevel(WARNING) ) Serial.printf("postDeviceResponse: Error on endPacket attempt to send %d bytes\",len");
+    SSDP_LOG_WARNING("postDeviceResponse: Error on endPacket attempt to send %d bytes\n",len);
   }
-  delay(500);
+  pace();
 }
 
-void SSDP::postServiceResponse(UPnPService* s, const char* st, IPAddress remoteAddr, int port ) {
+void SSDP::postServiceResponse(UPnPService* s, const char* st, IPAddress remoteAddr, int port, int ifcIndex ) {
+  SSDP_METRIC(uint32_t start = ESP.getCycleCount(); uint32_t excluded = _excluded);
+  if( _bin.active ) {
+    SSDPRecord record;
+    record.set(s,_table[ifcIndex].addr);
+    appendRecord(record);
+    SSDP_METRIC(countRender(start,_excluded - excluded));
+    return;
+  }
 /**  
  *  Service location is set to the network adapter receiving the incoming request (either localIP or softAPIP)
  */
-  IPAddress ifc = interfaceAddress(remoteAddr);
-  
-  char txnBuffer[TXN_BUFFER_SIZE + 1];
-  txnBuffer[0] = '\0';
-  UPnPDevice* p = s->parentAsDevice();
-  char locBuff[128];
-  locBuff[0] = '\0';
-  s->location(locBuff,128,ifc);
-  if( p != NULL ) {
-    snprintf_P(txnBuffer,TXN_BUFFER_SIZE,SERVICE_RESPONSE,locBuff,st,s->getType(),p->uuid(),s->getDisplayName(),p->uuid());
+  UDP&      udp = *_channel[ifcIndex];
+  char txnLine[TXN_LINE_SIZE];
+  txnHeader(txnLine,TXN_LINE_SIZE);
+  PERF_TRACEPOINT(uint64_t sendStart = PerfTrace::now());
+  int ok = udp.beginPacket(remoteAddr, port);
+  if( ok != 1 ) {
+    SSDP_LOG_WARNING("postServiceResponse: Error on beginPacket\n");
   }
-  int len = strlen(txnBuffer);
- 
-  int ok = _udp.beginPacket(remoteAddr, port);
+  int len = writeResponse(udp,s,st,_table[ifcIndex].addr,txnLine);
+  SSDP_METRIC(countRender(start,0); start = ESP.getCycleCount());
+  SSDP_TRACE_EVENT(TRACE_QUEUED,ifcIndex,len,0);
+  int sent = ok;
+  ok = udp.endPacket();
+  SSDP_TRACE_EVENT((((sent == 1) && (ok == 1))?(TRACE_SENT):(TRACE_SEND_FAILED)),ifcIndex,len,(uint32_t)remoteAddr);
+  PERF_TRACEPOINT(PerfTrace::complete("ssdp","send",sendStart,"bytes",len));
+  SSDP_METRIC(countSend((sent == 1) && (ok == 1),len,start));  
   if( ok != 1 ) {
-    if( loggingLevel(WARNING) ) Serial.printf("postServiceResponse: Error on beginPacket\n");
+    SSDP_LOG_WARNING("postServiceResponse: Error on endPacket attempt to send %d bytes\n",len);
+  }
+  pace();
+}
+
+/**
+ *  The binary packet header carries the request transaction and a hash of the request ST, so the requester can match
+ *  responses without parsing records.
+ */
+void SSDP::beginRecords(IPAddress remoteAddr, int port, int ifc, const char* st) {
+  _bin.active    = true;
+  _bin.addr      = remoteAddr;
+  _bin.port      = port;
+  _bin.ifc       = ifc;
+  _bin.count     = 0;
+  _bin.sent      = 0;
+  _bin.len       = SSDP_BIN_HEADER_SIZE;
+  _bin.txn       = ((_txn[0] != '\0')?(strtoul(_txn,NULL,16)):(0));
+  _bin.stHash    = SSDPRecord::hash(st);
+}
+
+void SSDP::appendRecord(SSDPRecord& record) {
+  PERF_SCOPE("ssdp","render");
+  int n = record.encode(_bin.data+_bin.len,SSDP_BIN_PACKET_SIZE-_bin.len);
+  if( (n == 0) || (_bin.count == 255) ) {
+    flushRecords();
+    n = record.encode(_bin.data+_bin.len,SSDP_BIN_PACKET_SIZE-_bin.len);
   }
-  int sz = _udp.write((unsigned char*)txnBuffer,len);
-  ok = _udp.endPacket();  
+  if( n > 0 ) {
+    _bin.len += n;
+    _bin.count++;
+    SSDP_TRACE_EVENT(TRACE_QUEUED,_bin.ifc,n,0);
+  }
+  else SSDP_LOG_WARNING("SSDP::appendRecord: Record for %s does not fit in a binary packet\n",record.displayName());
+}
+
+/**
+ *  Packets after the first are paced as text responses are
+ */
+void SSDP::flushRecords() {
+  if( _bin.count == 0 ) return;
+  if( _bin.sent > 0 ) pace();
+  PERF_SCOPE_ARG("ssdp","send","bytes",_bin.len);
+  SSDPRecord::writeHeader(_bin.data,_bin.count,_bin.txn,_bin.stHash);
+  UDP& udp = *_channel[_bin.ifc];
+  SSDP_METRIC(uint32_t start = ESP.getCycleCount());
+  int ok = udp.beginPacket(_bin.addr,_bin.port);
+  if( ok == 1 ) {
+    udp.write(_bin.data,_bin.len);
+    ok = udp.endPacket();
+  }
+  SSDP_METRIC(countSend(ok == 1,_bin.len,start));
+  SSDP_TRACE_EVENT(((ok == 1)?(TRACE_SENT):(TRACE_SEND_FAILED)),_bin.ifc,_bin.len,(uint32_t)_bin.addr);
   if( ok != 1 ) {
-    if( loggingLevel(WARNING) ) Serial.printf("postServiceResponse: Error on endPacket attempt to send %d bytes\n",len);
+    SSDP_LOG_WARNING("SSDP::flushRecords: Error sending %d records in %d bytes\n",_bin.count,_bin.len);
   }
-  delay(500);
+  _bin.sent++;
+  _bin.count = 0;
+  _bin.len   = SSDP_BIN_HEADER_SIZE;
 }
 
-void SSDP::postAllResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port ) {
-  postDeviceResponse(d, st, remoteAddr, port );
+/**
+ *  Pacing between responses, and the metrics of a response rendered or sent since start. Cycles spent rendering, 
+ *  sending and pacing are excluded from the match stage of the request. skip is cycles since start already counted 
+ *  elsewhere, for example a binary packet sent while adding a record.
+ */
+void SSDP::pace() {
+  PERF_SCOPE("ssdp","pace");
+  SSDP_METRIC(uint32_t start = ESP.getCycleCount());
+  SSDP_TRACE_EVENT(TRACE_PACED,0xff,_responseDelay,0);
+  _clock.wait(_responseDelay);
+  SSDP_METRIC(_metrics.paced++; _excluded += ESP.getCycleCount() - start);
+}
+
+void SSDP::countRender(uint32_t start, uint32_t skip) {
+  uint32_t cycles = ESP.getCycleCount() - start - skip;
+  _metrics.render.addCycles(cycles);
+  _metrics.queued++;
+  _excluded += cycles;
+}
+
+void SSDP::countSend(boolean ok, int len, uint32_t start) {
+  uint32_t cycles = ESP.getCycleCount() - start;
+  if( ok ) {
+    _metrics.sent++;
+    _metrics.bytesOut += len;
+  }
+  else _metrics.failed++;
+  _metrics.send.addCycles(cycles);
+  _excluded += cycles;
+}
+
+void SSDP::postAllResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifc ) {
+  postDeviceResponse(d, st, remoteAddr, port, ifc );
   UPnPService** services = d->services();
   for(int i=0; i<d->numServices(); i++ ) {
-    postServiceResponse(services[i],st,remoteAddr, port);
+    postServiceResponse(services[i],st,remoteAddr, port, ifc);
   }
   RootDevice* r = d->asRootDevice();
   if( r != NULL ) {
     UPnPDevice** devices = r->devices();
     for( int i=0; i<r->numDevices(); i++ ) {
-      postAllResponse(devices[i],st,remoteAddr, port);
+      postAllResponse(devices[i],st,remoteAddr, port, ifc);
     }
   }
 }
 
-void SSDP::postAllMatching(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port ) {
-  if( loggingLevel(FINEST) ) {
-    Serial.printf("SSDP::postAllMatching: Searching for device or service %s\n", st);
-    Serial.printf("                       Device type is  %s\n", d->getType());
-    if( d->isType(st) )  Serial.printf("                       Device type is a match, posting response\n");
-    else  Serial.printf("                       Device type is NOT a match\n");
-  }
-  if(d->isType(st)) postDeviceResponse(d, st, remoteAddr, port );
+void SSDP::postAllMatching(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifc ) {
+  SSDP_LOG_FINEST("SSDP::postAllMatching: Searching for device or service %s\n"
+                  "                       Device type %s is %s\n",st,d->getType(),((d->isType(st))?("a match"):("NOT a match")));
+  if(d->isType(st)) postDeviceResponse(d, st, remoteAddr, port, ifc );
   UPnPService** services = d->services();
-  Serial.printf("                       Searching services for device type %s\n", d->getType());
   for(int i=0; i<d->numServices(); i++ ) {
-    if( loggingLevel(FINEST) ) {
-       Serial.printf("                            Service type is  %s\n", services[i]->getType());
-       if( services[i]->isType(st) )  Serial.printf("                            Service type is a match, posting response\n");
-       else  Serial.printf("                            Service type is NOT a match\n");
-    }
-    if( services[i]->isType(st) ) postServiceResponse(services[i],st,remoteAddr,port);
+    SSDP_LOG_FINEST("                            Service type %s is %s\n",services[i]->getType(),((services[i]->isType(st))?("a match"):("NOT a match")));
+    if( services[i]->isType(st) ) postServiceResponse(services[i],st,remoteAddr,port,ifc);
   }
   RootDevice* r = d->asRootDevice();
   if( r != NULL ) {
     UPnPDevice** devices = r->devices();
     for( int i=0; i<r->numDevices(); i++ ) {
-      postAllMatching(devices[i],st,remoteAddr,port);
+      postAllMatching(devices[i],st,remoteAddr,port,ifc);
     }
   }
 }
 
-boolean SSDP::isLocalIP(IPAddress address) {
-  IPAddress local_IP     = WiFi.localIP();
-  IPAddress subnet       = WiFi.subnetMask();
-  uint32_t  localIPMask  = ((uint32_t)local_IP)  & ((uint32_t)subnet);
-  uint32_t  addr         = (uint32_t) address;
-  return((addr&localIPMask)!=0);  
+void SSDP::formatMetrics(MetricsWriter& w) {
+  const SSDPMetrics& m = _metrics;
+  w.counter("lsc_ssdp_received_packets_total","Packets read by the responder",m.received);
+  w.counter("lsc_ssdp_filtered_packets_total","Multicast packets from outside every interface network",m.filtered);
+  w.family("lsc_ssdp_classified_packets_total","counter","Packets read by class");
+  w.sample("lsc_ssdp_classified_packets_total","class=\"lsc_search\"",m.lscSearches);
+  w.sample("lsc_ssdp_classified_packets_total","class=\"other_search\"",m.otherSearches);
+  w.sample("lsc_ssdp_classified_packets_total","class=\"response\"",m.responses);
+  w.sample("lsc_ssdp_classified_packets_total","class=\"other\"",m.other);
+  w.family("lsc_ssdp_prefilter_rejects_total","counter","Packets rejected before parsing by reason");
+  w.sample("lsc_ssdp_prefilter_rejects_total","reason=\"start_line\"",m.rejectedOther);
+  w.sample("lsc_ssdp_prefilter_rejects_total","reason=\"no_lsc_header\"",m.rejectedSearches);
+  w.sample("lsc_ssdp_prefilter_rejects_total","reason=\"no_search_active\"",m.rejectedResponses);
+  w.counter("lsc_ssdp_prefilter_skipped_bytes_total","Bytes of rejected packets never read",m.bytesSkipped);
+  w.counter("lsc_ssdp_matched_requests_total","Requests answered",m.matched);
+  w.counter("lsc_ssdp_queued_responses_total","Responses formatted, text responses and binary records",m.queued);
+  w.counter("lsc_ssdp_sent_packets_total","Packets sent",m.sent);
+  w.counter("lsc_ssdp_send_errors_total","Packets that failed to send",m.failed);
+  w.counter("lsc_ssdp_paced_total","Pacing waits between responses",m.paced);
+  w.counter("lsc_ssdp_received_bytes_total","Bytes read",m.bytesIn);
+  w.counter("lsc_ssdp_sent_bytes_total","Bytes sent",m.bytesOut);
+  w.family("lsc_ssdp_stage_seconds","histogram","Responder time per stage");
+  w.histogram("lsc_ssdp_stage_seconds","stage=\"parse\"",m.parse,METRICS_US);
+  w.histogram("lsc_ssdp_stage_seconds","stage=\"match\"",m.match,METRICS_US);
+  w.histogram("lsc_ssdp_stage_seconds","stage=\"render\"",m.render,METRICS_US);
+  w.histogram("lsc_ssdp_stage_seconds","stage=\"send\"",m.send,METRICS_US);
+
+  const SSDPSearchMetrics& s = _searchMetrics;
+  w.counter("lsc_ssdp_search_sessions_total","Search sessions ended",s.sessions);
+  w.counter("lsc_ssdp_search_empty_total","Search sessions without a response",s.empty);
+  w.counter("lsc_ssdp_search_responses_total","Distinct search responses",s.responses);
+  w.counter("lsc_ssdp_search_duplicates_total","Duplicate search responses",s.duplicates);
+  w.counter("lsc_ssdp_search_nonmatching_total","Search responses for another search",s.nonMatching);
+  w.counter("lsc_ssdp_search_missing_total","Search responses announced but not received",s.missing);
+  w.family("lsc_ssdp_search_seconds","histogram","Time from sending a search");
+  w.histogram("lsc_ssdp_search_seconds","event=\"first\"",s.first,METRICS_MS);
+  w.histogram("lsc_ssdp_search_seconds","event=\"last\"",s.last,METRICS_MS);
+  w.histogram("lsc_ssdp_search_seconds","event=\"end\"",s.duration,METRICS_MS);
+  Footprint::formatMetrics(w,"lsc_ssdp_footprint_bytes",[this](FootprintVisitor v){this->footprint(v);});
+}
+
+/**
+ *  Stack parts are the buffers held on the stack by each operation, along the deepest call chain. A request is read
+ *  and answered one after the other, so receive and response buffers are not on the stack together.
+ */
+void SSDP::footprint(FootprintVisitor v) {
+  v(FOOTPRINT_OBJECT,"SSDP",1,sizeof(SSDP));
+  v(FOOTPRINT_STATIC,"SSDP interfaces",SSDP_MAX_INTERFACES,sizeof(SSDPInterface));
+  v(FOOTPRINT_STATIC,"SSDP search metrics",1,sizeof(SSDPSearchMetrics));
+  if( TraceRing::capacity() > 0 ) v(FOOTPRINT_HEAP,"SSDP trace ring",TraceRing::capacity(),sizeof(TraceEvent));
+  v(FOOTPRINT_STACK,"ssdp receive",1,(TXN_BUFFER_SIZE + 1) + ST_LSC_HEADER_SIZE + ST_HEADER_SIZE + UUID_SIZE);
+  v(FOOTPRINT_STACK,"ssdp response",1,TXN_LINE_SIZE + SSDP_LOCATION_SIZE);
+  v(FOOTPRINT_STACK,"searchRequest",1,2*SSDP_BUFFER_SIZE + ST_HEADER_SIZE + 32);
+  v(FOOTPRINT_STACK,"startSearch",1,SSDP_BUFFER_SIZE + TXN_LINE_SIZE + SSDP_TXN_SIZE);
 }
 
-boolean SSDP::isSoftAPIP(IPAddress address) {
-  IPAddress softAP_IP    = WiFi.softAPIP();
-  IPAddress subnet       = WiFi.subnetMask();
-  uint32_t  softAPIPMask = ((uint32_t)softAP_IP) & ((uint32_t)subnet);
-  uint32_t  addr         = (uint32_t) address;
-  return((addr&softAPIPMask)!=0); 
+/**
+ *  An address is on an interface network when it matches the interface address under the interface subnet mask.
+ */
+int SSDP::interfaceIndex(IPAddress address) {
+  const SSDPInterface* table = interfaces();
+  uint32_t addr = (uint32_t) address;
+  for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {
+    if( table[i].up ) {
+      uint32_t mask = (uint32_t) table[i].mask;
+      if( (addr & mask) == (((uint32_t) table[i].addr) & mask) ) return i;
+    }
+  }
+  return -1;
 }
 
+boolean SSDP::isLocalIP(IPAddress address)  {return (interfaceIndex(address) == SSDP_STA);}
+boolean SSDP::isSoftAPIP(IPAddress address) {return (interfaceIndex(address) == SSDP_AP);}
+
 IPAddress SSDP::interfaceAddress(IPAddress address) {
-  IPAddress local_IP     = WiFi.localIP();
-  IPAddress softAP_IP    = WiFi.softAPIP();
-  IPAddress subnet       = WiFi.subnetMask();
-  uint32_t  localIPMask  = ((uint32_t)local_IP)  & ((uint32_t)subnet);
-  uint32_t  softAPIPMask = ((uint32_t)softAP_IP) & ((uint32_t)subnet);
-  uint32_t  addr         = (uint32_t) address;
-  if((addr&localIPMask)!=0) return local_IP;
-  else if((addr&softAPIPMask)!=0) return softAP_IP;
-  else return IPADDR_ANY;
+  int i = interfaceIndex(address);
+  return ((i>=0)?(_interfaces[i].addr):(IPAddress(IPADDR_ANY)));
 }
 
 } // End of namespace lsc
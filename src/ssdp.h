@@ -52,6 +52,12 @@
 
 #include <WiFiUdp.h>
 #include "UPnPDevice.h"
+#include "ResponseTemplate.h"
+#include "SSDPRecord.h"
+#include "Histogram.h"
+#include "SearchTracker.h"
+#include "TraceRing.h"
+#include "SSDPLog.h"
 
 /** Leelanau Software Company namespace 
 *  
@@ -70,29 +76,176 @@ namespace lsc {
 
 #define UDP_PORT   1900                // local UDP port to listen on
 
+#define SSDP_MAX_INTERFACES 2          // Network interfaces SSDP listens on, station and soft AP
+#define SSDP_STA            0          // Interface table index of the station interface (WiFi.localIP())
+#define SSDP_AP             1          // Interface table index of the soft AP interface (WiFi.softAPIP())
+#define SSDP_MAX_SEARCHES   4          // Concurrent search sessions on an SSDP instance
+#define SSDP_TXN_SIZE       12
+#define SSDP_USN_SIZE       (UUID_SIZE + SSDP_TYPE_SIZE + 6)  // USN value, uuid:<uuid>::<type>
+#define SSDP_DESC_SIZE      (NAME_SIZE + UUID_SIZE + 34)      // DESC.LEELANAUSOFTWARE.COM value, :name:<name>:services:<n>:puuid:<uuid>:
+
+/**
+ *  Responder metrics (see SSDPMetrics) are collected unless built with SSDP_METRICS defined as 0
+ */
+#ifndef SSDP_METRICS
+#define SSDP_METRICS        1
+#endif
+
+#if SSDP_METRICS
+#define SSDP_METRIC(x)      x
+#else
+#define SSDP_METRIC(x)
+#endif
+
+/**
+ *  Random 32 bit value from the hardware random number generator, for ids that must differ between devices running
+ *  the same firmware; rand() is never seeded, so it gives every device the same sequence
+ */
+inline uint32_t hardwareRandom() {
+#ifdef ESP32
+  return esp_random();
+#else
+  return ESP.random();
+#endif
+}
+
 typedef enum {
   SSDP_OK = 0,
   SSDP_ERR_UDP = 1,
   SSDP_ERR_SEND = 2,
-  SSDP_ERR_ST = 3
+  SSDP_ERR_ST = 3,
+  SSDP_ERR_BUSY = 4,
+  SSDP_CANCELLED = 5
 } SSDPResult;
 
 typedef std::function<void(UPnPBuffer*)> SSDPHandler;
+typedef std::function<void(SSDPResult)>  SSDPSearchEnd;        // SSDP_OK when a session times out, SSDP_CANCELLED from cancelSearch()
+
+/** SSDPSearch
+ *  An active search session started with SSDP::startSearch(). Responses are matched to the session by transaction,
+ *  or by ST for devices that do not echo the transaction.
+ */
+typedef struct {
+  boolean        active;
+  uint32_t       txn;
+  char           st[ST_HEADER_SIZE];
+  SSDPHandler    handler;
+  SSDPSearchEnd  done;
+  int            timeout;
+  unsigned long  lastResponse;
+#if SSDP_METRICS
+  SearchTracker  tracker;
+#endif
+} SSDPSearch;
+
+/** SSDPBinaryReply
+ *  Binary response packet being filled while answering a request that asked for binary framing (see SSDPRecord.h).
+ *  Records are appended until the packet is full, then the packet is sent and a new one started.
+ */
+typedef struct {
+  boolean        active;
+  IPAddress      addr;
+  int            port;
+  int            ifc;
+  int            len;
+  int            count;
+  int            sent;
+  uint32_t       txn;
+  uint32_t       stHash;
+  uint8_t        data[SSDP_BIN_PACKET_SIZE];
+} SSDPBinaryReply;
+
+/** SSDPClock
+ *  Time source and pacing of an SSDP instance. now() is used in place of millis() and wait() in place of delay(), 
+ *  so responders can be run on a virtual clock, for example on a simulated network.
+ */
+typedef struct {
+  std::function<unsigned long(void)>  now;
+  std::function<void(unsigned long)>  wait;
+} SSDPClock;
+
+/** SSDPTimings
+ *  Responder CPU time split between reading and classifying incoming packets (readChannel) and answering them, in CPU 
+ *  cycles. postCycles includes response pacing, the time spent in SSDPClock::wait().
+ */
+typedef struct {
+  uint32_t       packets;
+  uint32_t       replies;
+  uint64_t       readCycles;
+  uint64_t       postCycles;
+} SSDPTimings;
+
+/** SSDPMetrics
+ *  Responder counters and per stage latency histograms, accumulated since begin() or the last resetMetrics(). Incoming
+ *  packets are classified as LSC searches, other searches, search responses, or other traffic (NOTIFY, malformed). 
+ *  Packets the responder ignores are rejected by a prefilter before they are parsed, and counted both in their class 
+ *  and in rejected*. 
+ *  Stages are timed in CPU cycles and counted in microseconds:
+ *    parse  := Reading a packet and extracting its headers, once per packet
+ *    match  := Deciding which devices and services answer, including the walk of the device hierarchy, once per 
+ *              matched request
+ *    render := Formatting one text response or binary record
+ *    send   := beginPacket() through endPacket() for one packet
+ *  Pacing between responses is counted in paced and is not part of any stage. When built with SSDP_METRICS 0 all
+ *  counts stay 0.
+ */
+typedef struct {
+  uint32_t       received;            // Packets read
+  uint32_t       filtered;            // Multicast packets from outside every interface network, handled on the first interface up
+  uint32_t       lscSearches;         // Searches with an ST.LEELANAUSOFTWARE.COM header
+  uint32_t       otherSearches;       // Third party searches, ignored
+  uint32_t       responses;           // Search responses, handed to search sessions
+  uint32_t       other;               // Anything else, ignored
+  uint32_t       rejectedOther;       // Other packets rejected by the prefilter from their start line
+  uint32_t       rejectedSearches;    // Other searches rejected by the prefilter, without the LSC header token
+  uint32_t       rejectedResponses;   // Search responses rejected by the prefilter while no search is active
+  uint32_t       matched;             // Requests answered
+  uint32_t       queued;              // Responses formatted, text responses and binary records
+  uint32_t       sent;                // Packets sent
+  uint32_t       failed;              // Packets that failed on beginPacket() or endPacket()
+  uint32_t       paced;               // Pacing waits between responses
+  uint64_t       bytesIn;
+  uint64_t       bytesOut;
+  uint64_t       bytesSkipped;        // Bytes of rejected packets never read from the channel
+  Histogram      parse;
+  Histogram      match;
+  Histogram      render;
+  Histogram      send;
+} SSDPMetrics;
+
+/** SSDPInterface
+ *  Entry in the network interface table. The table is refreshed only when WiFi reports a network event (or
+ *  SSDP::networkChanged() is called), so classifying a remote address costs a mask and compare per interface.
+ */
+typedef struct {
+  IPAddress addr;
+  IPAddress mask;
+  boolean   up;
+} SSDPInterface;
 
 class SSDP {
 
   public:
   SSDP();
-  virtual ~SSDP() {_udp.stop();_mUdp.stop();}
+  virtual ~SSDP() {_mUdp.stop(); for( int i=0; i<SSDP_MAX_INTERFACES; i++ ) {_udp[i].stop();}}
   
   void         begin(RootDevice* root);                  // RootDevice to handle search requests
-  void         doSSDP();                                 // Read both Unicast and Multicast UDP channels and respond accordingly
-  int          getUDPPort();                             // Return unicast UDP channel port
+  void         begin(RootDevice* root, UDP* multicast, UDP* unicast, IPAddress addr, IPAddress mask);  // Run on caller supplied channels
+  void         doSSDP();                                 // Read Unicast and Multicast UDP channels on each interface and respond accordingly
+  int          getUDPPort();                             // Return unicast UDP channel port of the first interface
   int          getMulticastPort();                       // Return Multicast UDP channel port
   
   static boolean   isLocalIP(IPAddress addr);            // Return true if addr is on the localIP network
   static boolean   isSoftAPIP(IPAddress addr);           // Return true if addr is on the softAPIP network
   static IPAddress interfaceAddress(IPAddress addr);     // Return the network interface (either local or softAP) of addr
+  static int       interfaceIndex(IPAddress addr);       // Return the interface table index of the network of addr, or -1
+
+/**
+ *  Interface table access. The table is refreshed on WiFi network events; call networkChanged() after changing
+ *  interface configuration in a way WiFi does not report, for example starting a soft AP.
+ */
+  static const SSDPInterface* interfaces();              // Returns the SSDP_MAX_INTERFACES entry interface table
+  static void                 networkChanged()  {_interfacesDirty = true;}
 
 /**
  *  Send an SSDP Search request and parse responses for timeout milliseconds.
@@ -104,7 +257,8 @@ class SSDP {
  *                 urn:domain-name:device:deviceType:ver         For example - urn:LEELANAUSOFTWARE-com:device:SoftwareClock:1
  *                 urn:domain-name:service:serviceType:ver       For example - urn:LEELANAUSOFTWARE-com:service:GetDateTime:1
  *     handler - An SSDPHandler function called on each response to the request
- *     ifc     - The network interface to bind the request to (either WiFi.localIP() or WiFi.softAPIP())
+ *     ifc     - The network interface to bind the request to (either WiFi.localIP() or WiFi.softAPIP()), or IPADDR_ANY
+ *               to send the request on every interface that is up
  *     timeout - Listen for responses for timeout milliseconds and then return to caller. If ST is uuid:Devce-UUID, processing returns
  *               after the specific device responds or timeout expires, otherwise processing returns after timeout milliseconds.
  *     ssdpAll - Applies only to upnp:rootdevice searches, if true, ALL RootDevices, embedded UPnPDevices, 
@@ -113,29 +267,150 @@ class SSDP {
   static SSDPResult      searchRequest(const char* ST, SSDPHandler handler, IPAddress ifc, int timeout=2000, boolean ssdpAll=false);
 
 /**
- *  Set/Get/Check Logging Level. Logging Level can be NONE, INFO, FINE, and FINEST
+ *  Send an SSDP Search request on every interface that is up and parse responses from all of them in a single
+ *  session for timeout milliseconds. Parameters are as above; this is the same as searchRequest() with ifc
+ *  set to IPADDR_ANY.
+ */
+  static SSDPResult      searchRequest(const char* ST, SSDPHandler handler, int timeout=2000, boolean ssdpAll=false);
+
+/**
+ *  Send an SSDP Search request asking for binary responses and hand each response to an SSDPRecordHandler as a decoded
+ *  SSDPRecord. Devices that respond with text are parsed into the same SSDPRecord form, so a mix of devices can be
+ *  searched in one session. Parameters are as for searchRequest().
+ */
+  static SSDPResult      searchRecords(const char* ST, SSDPRecordHandler handler, IPAddress ifc, int timeout=2000, boolean ssdpAll=false);
+  static SSDPResult      searchRecords(const char* ST, SSDPRecordHandler handler, int timeout=2000, boolean ssdpAll=false);
+
+/**
+ *  Search sessions sharing the responder channels opened in begin(). Responses are read in doSSDP(), so a device that is 
+ *  both a hub and a responder runs a single channel pair per interface with no per-search setup cost. Parameters are as
+ *  for searchRequest(), searching every interface that is up.
+ *     startSearch()  - Send the search request and return immediately, handler is called from doSSDP() on each response. 
+ *                      The session ends after timeout milliseconds without a response, at most SSDP_MAX_SEARCHES sessions
+ *                      may be active. If id is not NULL it is set to the session id, and done, if not NULL, is called 
+ *                      when the session ends.
+ *     search()       - Start a search session and call doSSDP() until it ends
+ *     searchActive() - Return true while session id is active
+ *     cancelSearch() - End session id
+ */
+  SSDPResult             startSearch(const char* ST, SSDPHandler handler, int timeout=2000, boolean ssdpAll=false, int* id=NULL, SSDPSearchEnd done=NULL);
+  SSDPResult             search(const char* ST, SSDPHandler handler, int timeout=2000, boolean ssdpAll=false);
+  boolean                searchActive(int id);
+  void                   cancelSearch(int id);
+
+/**
+ *  Clock and response pacing. Text responses, and binary response packets after the first, are followed by a wait of 
+ *  responseDelay milliseconds, 500 by default.
+ */
+  void                   setClock(SSDPClock clock)               {_clock = clock;}
+  void                   setResponseDelay(unsigned long ms)      {_responseDelay = ms;}
+  unsigned long          getResponseDelay()                      {return _responseDelay;}
+
+/**
+ *  Responder timings accumulated since begin() or the last resetTimings()
+ */
+  const SSDPTimings&     timings()                               {return _timings;}
+  void                   resetTimings()                          {memset(&_timings,0,sizeof(_timings));}
+
+/**
+ *  Responder metrics accumulated since begin() or the last resetMetrics() (see SSDPMetrics)
+ */
+  const SSDPMetrics&     metrics()                               {return _metrics;}
+  void                   resetMetrics()                          {_metrics = SSDPMetrics();}
+
+/**
+ *  Search sessions of searchRequest(), searchRecords() and startSearch() aggregated since start up or the last 
+ *  resetSearchMetrics() (see SearchTracker.h)
+ */
+  static const SSDPSearchMetrics& searchMetrics()                {return _searchMetrics;}
+  static void            resetSearchMetrics()                    {_searchMetrics = SSDPSearchMetrics();}
+
+/**
+ *  Write responder and search metrics in the Prometheus text format, for example on the RootDevice /metrics page:
+ *    root.addMetrics([](MetricsWriter& w){ssdp.formatMetrics(w);});
+ */
+  void                   formatMetrics(MetricsWriter& w);
+
+/**
+ *  Report the size of this instance, the static tables of SSDP and the stack buffers of responding and searching to a
+ *  FootprintVisitor (see Footprint.h). The footprint is also written by formatMetrics().
+ */
+  void                   footprint(FootprintVisitor v);
+
+/**
+ *  Write the text search response of a device or service for search target st, located on interface ifc, to out.
+ *  Responses are written a fragment at a time straight into the outgoing packet, with no intermediate buffer.
+ *  txnLine is an additional header line (or an empty string). Returns the number of bytes written.
+ */
+  static int             writeResponse(Print& out, UPnPDevice* d, const char* st, IPAddress ifc, const char* txnLine="");
+  static int             writeResponse(Print& out, UPnPService* s, const char* st, IPAddress ifc, const char* txnLine="");
+
+/**
+ *  Format the text search response into buffer, truncated to size-1 characters. Returns the length of the response.
+ */
+  static int             formatResponse(char buffer[], int size, UPnPDevice* d, const char* st, IPAddress ifc, const char* txnLine="");
+  static int             formatResponse(char buffer[], int size, UPnPService* s, const char* st, IPAddress ifc, const char* txnLine="");
+
+/**
+ *  Set/Get/Check Logging Level. Logging Level can be NONE, WARNING, INFO, FINE, and FINEST. Levels above SSDP_LOG_LEVEL
+ *  are compiled out (see SSDPLog).
  */
-  static void             logging(LoggingLevel level)             {_logging = level;}
-  static LoggingLevel     logging()                               {return _logging;}
-  static boolean          loggingLevel(LoggingLevel level)        {return(logging() >= level);}
+  static void             logging(LoggingLevel level)             {SSDPLog::level(level);}
+  static LoggingLevel     logging()                               {return SSDPLog::level();}
+  static boolean          loggingLevel(LoggingLevel level)        {return SSDPLog::enabled(level);}
 
   private:
-  RootDevice*                _root;                      // RootDevice to expose through SSDP
-  WiFiUDP                    _mUdp;                      // Multicast Discovery
-  WiFiUDP                    _udp;                       // Unicast Discovery and resopnse
-  static LoggingLevel        _logging;
+  RootDevice*                _root;                                // RootDevice to expose through SSDP
+  WiFiUDP                    _mUdp;                                // Multicast Discovery for all interfaces, joined on each interface
+  WiFiUDP                    _udp[SSDP_MAX_INTERFACES];            // Unicast Discovery and response, one per interface
+  IPAddress                  _bound[SSDP_MAX_INTERFACES];          // Interface address each unicast channel and membership was started with
+  boolean                    _listening = false;                   // True once _mUdp is bound
+  UDP*                       _mChannel;                            // Channels in use, _mUdp and _udp unless begin() was given channels
+  UDP*                       _channel[SSDP_MAX_INTERFACES];
+  boolean                    _custom = false;                      // True if running on caller supplied channels
+  SSDPInterface              _customTable[SSDP_MAX_INTERFACES];    // Interface table when running on caller supplied channels
+  SSDPInterface*             _table = _interfaces;                 // Interface table in use
+  SSDPClock                  _clock;
+  unsigned long              _responseDelay = 500;
+  SSDPTimings                _timings = {0,0,0,0};
+  SSDPMetrics                _metrics = SSDPMetrics();
+  uint32_t                   _parsed = 0;                          // Cycle count when the packet being read was parsed
+  uint32_t                   _excluded = 0;                        // Cycles of the current request spent rendering, sending and pacing
+  static SSDPInterface       _interfaces[SSDP_MAX_INTERFACES];
+  static volatile boolean    _interfacesDirty;
+  static SSDPSearchMetrics   _searchMetrics;
   
   std::function<void(void)>  _postHandler = []{};
+  SSDPSearch                 _searches[SSDP_MAX_SEARCHES];
+  uint32_t                   _nextTxn = 0;
+  char                       _txn[SSDP_TXN_SIZE];                  // Transaction of the request being answered, echoed on responses
+  SSDPBinaryReply            _bin;
 
+  static SSDPResult formatSearch(char buffer[], int size, const char* ST, boolean ssdpAll, boolean binary, const char* extra);
+  static SSDPResult runSearch(const char* request, IPAddress ifc, int timeout, boolean all, SearchTracker& tracker, std::function<boolean(char*,int)> onPacket);
 
-  void      doChannel(WiFiUDP& channel);                                                          // Check for incoming search requests and respond
+  static void      refreshInterfaces();                                                           // Re-read interface addresses and masks from WiFi
+  static void      registerNetworkEvents();                                                       // Mark the interface table dirty on WiFi network events
+  void      startInterfaces();                                                                    // (Re)start channels for interfaces whose address changed
+  void      doChannel(UDP& channel, int ifc, boolean multicast);                                  // Check for incoming search requests and respond
   void      setPostHandler(std::function<void(void)> handler) {_postHandler = handler;}           // Set post response handler
-  boolean   readChannel(WiFiUDP& channel);                                                        // Read bytes from channel, returns true if response required
-  void      postAllResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port );      // post search response for all embedded devices and services
-  void      postAllMatching(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port );      // post search response for matching devices and services
-  void      postAllReverse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port );       // post search all response in reverse
-  void      postDeviceResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port );   // post search response for device, returns USN
-  void      postServiceResponse(UPnPService* s, const char* st, IPAddress remoteAddr, int port ); // post search response for service
+  boolean   readChannel(UDP& channel, int ifc);                                                   // Read bytes from channel, returns true if response required
+  void      postAllResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifc );      // post search response for all embedded devices and services
+  void      postAllMatching(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifc );      // post search response for matching devices and services
+  void      postDeviceResponse(UPnPDevice* d, const char* st, IPAddress remoteAddr, int port, int ifc );   // post search response for device
+  void      postServiceResponse(UPnPService* s, const char* st, IPAddress remoteAddr, int port, int ifc ); // post search response for service
+  void      handleSearchResponse(UPnPBuffer& buffer);                                             // Dispatch a search response to active search sessions
+  void      expireSearches();                                                                     // End search sessions that have timed out
+  void      endSearch(int id, SSDPResult result);                                                 // End session id and call its done function
+  boolean   searching();                                                                          // True if any search session is active
+  boolean   prefilter(UDP& channel, char buffer[], int& len, int ifc);                            // Read a packet into buffer unless it can be rejected unparsed
+  void      txnHeader(char buffer[], int size);                                                   // Format the transaction header line for a response
+  void      beginRecords(IPAddress remoteAddr, int port, int ifc, const char* st);                // Start a binary response to remoteAddr:port
+  void      appendRecord(SSDPRecord& record);                                                     // Add a record to the binary response
+  void      flushRecords();                                                                       // Send the binary response packet if it holds records
+  void      pace();                                                                               // Wait responseDelay between responses
+  void      countRender(uint32_t start, uint32_t skip);                                           // Count a response rendered since start
+  void      countSend(boolean ok, int len, uint32_t start);                                       // Count a packet sent since start
 
 };
 